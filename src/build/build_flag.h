@@ -368,6 +368,15 @@
 
 #endif
 
+// Per-function instruction set target, for kernels picked at runtime
+#if COMPILER_GCC || COMPILER_CLANG
+#define TARGET_ISA(isa) __attribute__((target(isa)))
+
+#else
+#define TARGET_ISA(isa)
+
+#endif
+
 // ===============
 // Path Separators
 // ===============
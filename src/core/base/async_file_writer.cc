@@ -0,0 +1,118 @@
+#include "core/base/async_file_writer.h"
+
+#include <cstddef>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "core/base/file_util.h"
+
+namespace core {
+
+std::string_view AsyncFileWriter::Job::content() const {
+  if (!bytes.empty()) {
+    return std::string_view(reinterpret_cast<const char*>(bytes.data()),
+                            bytes.size());
+  }
+  return text;
+}
+
+AsyncFileWriter::AsyncFileWriter(const AsyncFileWriterOptions& options)
+    : options_(options), worker_(&AsyncFileWriter::run, this) {}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  job_ready_.notify_one();
+  worker_.join();
+}
+
+std::future<int> AsyncFileWriter::write(std::string path,
+                                        std::string&& content) {
+  const std::size_t size = content.size();
+  Job job;
+  job.path = std::move(path);
+  job.text = std::move(content);
+  return enqueue(std::move(job), size);
+}
+
+std::future<int> AsyncFileWriter::write(std::string path,
+                                        std::vector<std::byte>&& content) {
+  const std::size_t size = content.size();
+  Job job;
+  job.path = std::move(path);
+  job.bytes = std::move(content);
+  return enqueue(std::move(job), size);
+}
+
+std::future<int> AsyncFileWriter::enqueue(Job&& job, std::size_t size) {
+  std::future<int> result = job.done.get_future();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // backpressure: hold the producer until the writer catches up.
+    space_free_.wait(lock, [&] {
+      return queued_bytes_ == 0 ||
+             queued_bytes_ + size <= options_.max_queued_bytes;
+    });
+    queued_bytes_ += size;
+    ++enqueued_count_;
+    jobs_.push_back(std::move(job));
+  }
+  job_ready_.notify_one();
+  return result;
+}
+
+int AsyncFileWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t target = enqueued_count_;
+  job_done_.wait(lock, [&] { return completed_count_ >= target; });
+  const bool failed = failed_since_flush_;
+  failed_since_flush_ = false;
+  return failed ? -1 : 0;
+}
+
+std::size_t AsyncFileWriter::queued_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queued_bytes_;
+}
+
+void AsyncFileWriter::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_ready_.wait(lock, [&] { return stop_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        // stopping, and everything has been written.
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    // the queued bytes stay accounted until the write is done, so memory
+    // use stays within the bound.
+    const std::string_view content = job.content();
+    const int result =
+        write_file_atomic(job.path.c_str(), content, options_.durability);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_bytes_ -= content.size();
+      ++completed_count_;
+      if (result != 0) {
+        failed_since_flush_ = true;
+      }
+    }
+    space_free_.notify_all();
+    job_done_.notify_all();
+    job.done.set_value(result);
+  }
+}
+
+}  // namespace core
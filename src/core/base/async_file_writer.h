@@ -0,0 +1,84 @@
+#ifndef CORE_BASE_ASYNC_FILE_WRITER_H_
+#define CORE_BASE_ASYNC_FILE_WRITER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "core/base/core_export.h"
+#include "core/base/file_util.h"
+
+namespace core {
+
+struct AsyncFileWriterOptions {
+  // `write` blocks while this many bytes wait to be written. a single larger
+  // buffer is still accepted once the queue is empty.
+  std::size_t max_queued_bytes = 64 * 1024 * 1024;
+  Durability durability = Durability::kNone;
+};
+
+// write-behind for whole files. buffers are moved into a bounded queue and
+// written by a background thread with `write_file_atomic`, so the caller
+// never waits on the disk unless the queue is full.
+class CORE_EXPORT AsyncFileWriter {
+ public:
+  explicit AsyncFileWriter(const AsyncFileWriterOptions& options = {});
+
+  // writes everything still queued before returning.
+  ~AsyncFileWriter();
+
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+  AsyncFileWriter(AsyncFileWriter&&) = delete;
+  AsyncFileWriter& operator=(AsyncFileWriter&&) = delete;
+
+  // queues `content` to replace the file at `path`. the future yields 0 once
+  // the file is written, or -1 on error.
+  std::future<int> write(std::string path, std::string&& content);
+  std::future<int> write(std::string path, std::vector<std::byte>&& content);
+
+  // waits until everything queued so far is written. returns 0 if all writes
+  // since the previous flush succeeded, -1 otherwise.
+  int flush();
+
+  std::size_t queued_bytes() const;
+
+ private:
+  struct Job {
+    std::string path;
+    std::string text;
+    std::vector<std::byte> bytes;
+    std::promise<int> done;
+
+    std::string_view content() const;
+  };
+
+  std::future<int> enqueue(Job&& job, std::size_t size);
+  void run();
+
+  const AsyncFileWriterOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable job_ready_;
+  std::condition_variable space_free_;
+  std::condition_variable job_done_;
+  std::deque<Job> jobs_;
+  std::size_t queued_bytes_ = 0;
+  uint64_t enqueued_count_ = 0;
+  uint64_t completed_count_ = 0;
+  bool failed_since_flush_ = false;
+  bool stop_ = false;
+  std::thread worker_;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_ASYNC_FILE_WRITER_H_
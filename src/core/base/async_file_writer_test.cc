@@ -0,0 +1,73 @@
+#include "core/base/async_file_writer.h"
+
+#include <cstddef>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+TEST(AsyncFileWriterTest, WritesEverythingQueued) {
+  TempDir dir("async_writer_test_");
+  ASSERT_TRUE(dir.valid());
+
+  std::vector<std::string> paths;
+  {
+    // a tiny bound forces the producer to wait on the writer.
+    AsyncFileWriterOptions options;
+    options.max_queued_bytes = 64;
+    AsyncFileWriter writer(options);
+    for (int i = 0; i < 200; ++i) {
+      paths.push_back(join_path(dir.path(), "file" + std::to_string(i)));
+      if (i % 2 == 0) {
+        writer.write(paths.back(), "text " + std::to_string(i));
+      } else {
+        writer.write(paths.back(), std::vector<std::byte>(
+                                       static_cast<std::size_t>(i),
+                                       std::byte{'b'}));
+      }
+      EXPECT_LE(writer.queued_bytes(), 200u);
+    }
+    EXPECT_EQ(writer.flush(), 0);
+    EXPECT_EQ(writer.queued_bytes(), 0u);
+
+    for (int i = 0; i < 200; ++i) {
+      EXPECT_EQ(read_file(paths[i].c_str()),
+                i % 2 == 0 ? "text " + std::to_string(i)
+                           : std::string(static_cast<std::size_t>(i), 'b'));
+    }
+
+    // the destructor drains writes that were never flushed.
+    writer.write(paths[0], std::string("rewritten"));
+  }
+  EXPECT_EQ(read_file(paths[0].c_str()), "rewritten");
+
+  for (const std::string& path : paths) {
+    EXPECT_EQ(remove_file(path.c_str()), 0);
+  }
+}
+
+TEST(AsyncFileWriterTest, ReportsErrors) {
+  TempDir dir("async_writer_test_");
+  ASSERT_TRUE(dir.valid());
+  const std::string good = join_path(dir.path(), "good");
+  const std::string bad = join_path(dir.path(), "missing", "bad");
+
+  AsyncFileWriter writer;
+  std::future<int> ok = writer.write(good, std::string("ok"));
+  std::future<int> failed = writer.write(bad, std::string("no"));
+  EXPECT_EQ(ok.get(), 0);
+  EXPECT_NE(failed.get(), 0);
+  EXPECT_EQ(writer.flush(), -1);
+
+  // the error is reported once; later flushes start clean.
+  writer.write(good, std::string("again"));
+  EXPECT_EQ(writer.flush(), 0);
+  EXPECT_EQ(read_file(good.c_str()), "again");
+  EXPECT_EQ(remove_file(good.c_str()), 0);
+}
+
+}  // namespace core
@@ -0,0 +1,141 @@
+#include "core/base/byte_scan.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/cpu_features.h"
+
+#if ARCH_X64 || ARCH_X86
+#include <immintrin.h>
+#endif  // ARCH_X64 || ARCH_X86
+
+namespace core {
+
+void find_newlines_scalar(const char* data,
+                          std::size_t size,
+                          std::size_t base,
+                          std::vector<std::size_t>* out) {
+  const char* current = data;
+  const char* end = data + size;
+  while (current < end) {
+    const char* newline =
+        static_cast<const char*>(std::memchr(current, '\n', end - current));
+    if (!newline) {
+      break;
+    }
+    out->push_back(base + static_cast<std::size_t>(newline - data));
+    current = newline + 1;
+  }
+}
+
+#if ARCH_X64 || ARCH_X86
+
+TARGET_ISA("sse2")
+void find_newlines_sse2(const char* data,
+                        std::size_t size,
+                        std::size_t base,
+                        std::vector<std::size_t>* out) {
+  const __m128i newline_vec = _mm_set1_epi8('\n');
+  std::size_t pos = 0;
+
+  for (; pos + 16 <= size; pos += 16) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    uint32_t mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline_vec)));
+
+    while (mask) {
+      out->push_back(base + pos + std::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+
+  find_newlines_scalar(data + pos, size - pos, base + pos, out);
+}
+
+TARGET_ISA("avx2")
+void find_newlines_avx2(const char* data,
+                        std::size_t size,
+                        std::size_t base,
+                        std::vector<std::size_t>* out) {
+  const __m256i newline_vec = _mm256_set1_epi8('\n');
+  std::size_t pos = 0;
+
+  for (; pos + 32 <= size; pos += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+    uint32_t mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline_vec)));
+
+    while (mask) {
+      out->push_back(base + pos + std::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+
+  find_newlines_scalar(data + pos, size - pos, base + pos, out);
+}
+
+TARGET_ISA("avx512f,avx512bw")
+void find_newlines_avx512bw(const char* data,
+                            std::size_t size,
+                            std::size_t base,
+                            std::vector<std::size_t>* out) {
+  const __m512i newline_vec = _mm512_set1_epi8('\n');
+  std::size_t pos = 0;
+
+  for (; pos + 64 <= size; pos += 64) {
+    __m512i chunk = _mm512_loadu_si512(data + pos);
+    uint64_t mask = _mm512_cmpeq_epi8_mask(chunk, newline_vec);
+
+    while (mask) {
+      out->push_back(base + pos + std::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+
+  // masked load for the tail, so no scalar loop is needed.
+  if (pos < size) {
+    const __mmask64 load_mask = (uint64_t{1} << (size - pos)) - 1;
+    __m512i chunk = _mm512_maskz_loadu_epi8(load_mask, data + pos);
+    uint64_t mask = _mm512_mask_cmpeq_epi8_mask(load_mask, chunk, newline_vec);
+
+    while (mask) {
+      out->push_back(base + pos + std::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+}
+
+#endif  // ARCH_X64 || ARCH_X86
+
+namespace {
+
+ByteScanKernels select_byte_scan_kernels() {
+#if ARCH_X64 || ARCH_X86
+  const CpuFeatures& features = cpu_features();
+  if (features.avx512bw) {
+    return {find_newlines_avx512bw, "avx512bw"};
+  }
+  if (features.avx2) {
+    return {find_newlines_avx2, "avx2"};
+  }
+  if (features.sse2) {
+    return {find_newlines_sse2, "sse2"};
+  }
+#endif  // ARCH_X64 || ARCH_X86
+  return {find_newlines_scalar, "scalar"};
+}
+
+}  // namespace
+
+const ByteScanKernels& byte_scan_kernels() {
+  static const ByteScanKernels kernels = select_byte_scan_kernels();
+  return kernels;
+}
+
+}  // namespace core
@@ -0,0 +1,49 @@
+#ifndef CORE_BASE_BYTE_SCAN_H_
+#define CORE_BASE_BYTE_SCAN_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/core_export.h"
+
+namespace core {
+
+// appends `base + i` to `out` for every '\n' at `data[i]`, i in [0, size).
+using NewlineScanFn = void (*)(const char* data,
+                               std::size_t size,
+                               std::size_t base,
+                               std::vector<std::size_t>* out);
+
+CORE_EXPORT void find_newlines_scalar(const char* data,
+                                      std::size_t size,
+                                      std::size_t base,
+                                      std::vector<std::size_t>* out);
+
+#if ARCH_X64 || ARCH_X86
+// the simd kernels must only be called if `cpu_features()` reports support.
+CORE_EXPORT void find_newlines_sse2(const char* data,
+                                    std::size_t size,
+                                    std::size_t base,
+                                    std::vector<std::size_t>* out);
+CORE_EXPORT void find_newlines_avx2(const char* data,
+                                    std::size_t size,
+                                    std::size_t base,
+                                    std::vector<std::size_t>* out);
+CORE_EXPORT void find_newlines_avx512bw(const char* data,
+                                        std::size_t size,
+                                        std::size_t base,
+                                        std::vector<std::size_t>* out);
+#endif  // ARCH_X64 || ARCH_X86
+
+struct ByteScanKernels {
+  NewlineScanFn find_newlines;
+  const char* name;
+};
+
+// the fastest kernels for the running cpu, bound once on first use.
+[[nodiscard]] CORE_EXPORT const ByteScanKernels& byte_scan_kernels();
+
+}  // namespace core
+
+#endif  // CORE_BASE_BYTE_SCAN_H_
@@ -0,0 +1,99 @@
+#include "core/base/cpu_features.h"
+
+#include <cstdint>
+
+#include "build/build_flag.h"
+
+#if ARCH_X64 || ARCH_X86
+#if COMPILER_MSVC
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif  // ARCH_X64 || ARCH_X86
+
+namespace core {
+
+namespace {
+
+#if ARCH_X64 || ARCH_X86
+
+struct CpuidRegisters {
+  uint32_t eax = 0;
+  uint32_t ebx = 0;
+  uint32_t ecx = 0;
+  uint32_t edx = 0;
+};
+
+CpuidRegisters cpuid(uint32_t leaf, uint32_t subleaf) {
+  CpuidRegisters regs;
+#if COMPILER_MSVC
+  int info[4];
+  __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+  regs.eax = static_cast<uint32_t>(info[0]);
+  regs.ebx = static_cast<uint32_t>(info[1]);
+  regs.ecx = static_cast<uint32_t>(info[2]);
+  regs.edx = static_cast<uint32_t>(info[3]);
+#else
+  __cpuid_count(leaf, subleaf, regs.eax, regs.ebx, regs.ecx, regs.edx);
+#endif
+  return regs;
+}
+
+uint64_t xgetbv0() {
+#if COMPILER_MSVC
+  return _xgetbv(0);
+#else
+  uint32_t eax;
+  uint32_t edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatures detect_cpu_features() {
+  CpuFeatures features;
+
+  const uint32_t max_leaf = cpuid(0, 0).eax;
+  if (max_leaf < 1) {
+    return features;
+  }
+
+  const CpuidRegisters leaf1 = cpuid(1, 0);
+  features.sse2 = (leaf1.edx >> 26) & 1;
+
+  const bool osxsave = (leaf1.ecx >> 27) & 1;
+  const bool avx = (leaf1.ecx >> 28) & 1;
+  if (!osxsave || !avx || max_leaf < 7) {
+    return features;
+  }
+
+  // xmm / ymm state, then opmask / zmm state, must be enabled by the os.
+  const uint64_t xcr0 = xgetbv0();
+  const bool ymm_enabled = (xcr0 & 0x6) == 0x6;
+  const bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+
+  const CpuidRegisters leaf7 = cpuid(7, 0);
+  features.avx2 = ymm_enabled && ((leaf7.ebx >> 5) & 1);
+  features.avx512f = zmm_enabled && ((leaf7.ebx >> 16) & 1);
+  features.avx512bw = features.avx512f && ((leaf7.ebx >> 30) & 1);
+  return features;
+}
+
+#else
+
+CpuFeatures detect_cpu_features() {
+  return CpuFeatures{};
+}
+
+#endif  // ARCH_X64 || ARCH_X86
+
+}  // namespace
+
+const CpuFeatures& cpu_features() {
+  static const CpuFeatures features = detect_cpu_features();
+  return features;
+}
+
+}  // namespace core
@@ -0,0 +1,22 @@
+#ifndef CORE_BASE_CPU_FEATURES_H_
+#define CORE_BASE_CPU_FEATURES_H_
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+// instruction set extensions usable on the running cpu. a flag is only set
+// when both the cpu and the os (saved register state) support it.
+struct CpuFeatures {
+  bool sse2 : 1 = false;
+  bool avx2 : 1 = false;
+  bool avx512f : 1 = false;
+  bool avx512bw : 1 = false;
+};
+
+// probed with cpuid on first use and cached for the process lifetime.
+[[nodiscard]] CORE_EXPORT const CpuFeatures& cpu_features();
+
+}  // namespace core
+
+#endif  // CORE_BASE_CPU_FEATURES_H_
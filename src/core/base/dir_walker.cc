@@ -0,0 +1,422 @@
+#include "core/base/dir_walker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/logger.h"
+#include "core/base/parallel.h"
+
+#if IS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if IS_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace core {
+
+namespace {
+
+#if IS_LINUX
+// getdents64 fills this with as many records as fit, so big buffers mean
+// few syscalls on huge directories.
+constexpr std::size_t kDirentBufferSize = 256 * 1024;
+#endif
+
+struct PendingDir {
+  std::string relative_path;
+  // depth of the entries inside the directory.
+  std::size_t depth = 0;
+};
+
+// per-worker deques of directories still to be read. owners push and pop at
+// the back (depth first, so paths stay warm in cache); idle workers steal
+// from the front of the others, which holds the largest subtrees. workers
+// with nothing to steal sleep until a push or the end of the walk.
+class DirQueue {
+ public:
+  explicit DirQueue(std::size_t shard_count)
+      : shards_(std::make_unique<Shard[]>(shard_count)),
+        shard_count_(shard_count) {}
+
+  void push(std::size_t worker, PendingDir&& dir) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    Shard& shard = shards_[worker];
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.dirs.push_back(std::move(dir));
+    }
+    wake(false);
+  }
+
+  // read before `pop`, and handed to `wait` if it found nothing.
+  uint32_t version() const { return version_.load(); }
+
+  // blocks until something was pushed, or the walk ended, since `seen`.
+  void wait(uint32_t seen) {
+    idle_.fetch_add(1);
+    if (version_.load() == seen) {
+      version_.wait(seen);
+    }
+    idle_.fetch_sub(1);
+  }
+
+  bool pop(std::size_t worker, PendingDir* dir) {
+    for (std::size_t i = 0; i < shard_count_; ++i) {
+      Shard& shard = shards_[(worker + i) % shard_count_];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.dirs.empty()) {
+        continue;
+      }
+      if (i == 0) {
+        *dir = std::move(shard.dirs.back());
+        shard.dirs.pop_back();
+      } else {
+        *dir = std::move(shard.dirs.front());
+        shard.dirs.pop_front();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  // marks a popped directory as done. children are pushed before this, so
+  // the count only drops to zero once the whole tree is walked.
+  void finish() {
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      wake(true);
+    }
+  }
+
+  bool done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+ private:
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::deque<PendingDir> dirs;
+  };
+
+  // a sleeper registers in `idle_` before it checks `version_`, and a waker
+  // bumps `version_` before it checks `idle_`, so one of them sees the other.
+  void wake(bool all) {
+    version_.fetch_add(1);
+    if (idle_.load() == 0) {
+      return;
+    }
+    if (all) {
+      version_.notify_all();
+    } else {
+      version_.notify_one();
+    }
+  }
+
+  std::unique_ptr<Shard[]> shards_;
+  std::size_t shard_count_;
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<uint32_t> version_{0};
+  std::atomic<std::size_t> idle_{0};
+};
+
+#if IS_LINUX
+
+EntryType entry_type_of(unsigned char d_type) {
+  switch (d_type) {
+    case DT_REG: return EntryType::kFile;
+    case DT_DIR: return EntryType::kDirectory;
+    case DT_LNK: return EntryType::kSymlink;
+    case DT_UNKNOWN: return EntryType::kUnknown;
+    default: return EntryType::kOther;
+  }
+}
+
+#endif  // IS_LINUX
+
+#if !IS_WINDOWS
+
+EntryType entry_type_of_mode(mode_t mode) {
+  if (S_ISREG(mode)) {
+    return EntryType::kFile;
+  }
+  if (S_ISDIR(mode)) {
+    return EntryType::kDirectory;
+  }
+  if (S_ISLNK(mode)) {
+    return EntryType::kSymlink;
+  }
+  return EntryType::kOther;
+}
+
+#endif  // !IS_WINDOWS
+
+class Walker {
+ public:
+  Walker(const std::string& root,
+         const WalkOptions& options,
+         std::size_t thread_count)
+      : root_(root), options_(options), queue_(thread_count) {}
+
+  void start() { queue_.push(0, PendingDir{}); }
+
+  void run(std::size_t worker, WalkResult* result) {
+#if IS_LINUX
+    std::vector<uint64_t> buffer(kDirentBufferSize / sizeof(uint64_t));
+#endif
+    std::string full_path;
+    std::string child_path;
+
+    PendingDir dir;
+    while (true) {
+      const uint32_t seen = queue_.version();
+      if (!queue_.pop(worker, &dir)) {
+        if (queue_.done()) {
+          return;
+        }
+        queue_.wait(seen);
+        continue;
+      }
+
+      full_path = root_;
+      if (!dir.relative_path.empty()) {
+        full_path += DIR_SEPARATOR;
+        full_path += dir.relative_path;
+      }
+
+      auto visit = [&](std::string_view name, EntryType type) {
+        visit_entry(worker, dir, name, type, &child_path, result);
+      };
+#if IS_LINUX
+      const bool ok = read_directory(full_path, &buffer, visit);
+#else
+      const bool ok = read_directory(full_path, visit);
+#endif
+      if (!ok) {
+        result->add_error();
+        if (dir.relative_path.empty()) {
+          glog.error_ref<"cannot read the directory {}\n">(root_);
+          glog.flush();
+        }
+      }
+      queue_.finish();
+    }
+  }
+
+ private:
+  void visit_entry(std::size_t worker,
+                   const PendingDir& dir,
+                   std::string_view name,
+                   EntryType type,
+                   std::string* child_path,
+                   WalkResult* result) {
+    if (name == "." || name == "..") {
+      return;
+    }
+    if (!options_.include_hidden && name.front() == '.') {
+      return;
+    }
+
+    const bool is_directory = type == EntryType::kDirectory;
+    if (!is_directory && !options_.extensions.empty() &&
+        std::none_of(options_.extensions.begin(), options_.extensions.end(),
+                     [name](const std::string& extension) {
+                       return name.ends_with(extension);
+                     })) {
+      return;
+    }
+
+    child_path->assign(dir.relative_path);
+    if (!child_path->empty()) {
+      child_path->push_back(DIR_SEPARATOR);
+    }
+    child_path->append(name);
+
+    if (options_.filter && !options_.filter(*child_path, type, dir.depth)) {
+      return;
+    }
+    if (!is_directory || options_.include_directories) {
+      result->add(*child_path, type);
+    }
+    if (is_directory && dir.depth < options_.max_depth) {
+      queue_.push(worker, PendingDir{*child_path, dir.depth + 1});
+    }
+  }
+
+#if IS_LINUX
+
+  template <typename F>
+  static bool read_directory(const std::string& path,
+                             std::vector<uint64_t>* buffer,
+                             const F& fn) {
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+
+    char* const data = reinterpret_cast<char*>(buffer->data());
+    const std::size_t capacity = buffer->size() * sizeof(uint64_t);
+    bool ok = true;
+    while (true) {
+      const long bytes = syscall(SYS_getdents64, fd, data, capacity);
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+      if (bytes <= 0) {
+        // the entries read before an error are kept.
+        ok = bytes == 0;
+        break;
+      }
+      for (long pos = 0; pos < bytes;) {
+        // glibc's dirent64 has the kernel's linux_dirent64 layout.
+        const auto* entry =
+            reinterpret_cast<const struct dirent64*>(data + pos);
+        pos += entry->d_reclen;
+
+        EntryType type = entry_type_of(entry->d_type);
+        if (type == EntryType::kUnknown) {
+          // some file systems do not fill d_type.
+          struct stat st;
+          if (fstatat(fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            type = entry_type_of_mode(st.st_mode);
+          }
+        }
+        fn(std::string_view(entry->d_name), type);
+      }
+    }
+    close(fd);
+    return ok;
+  }
+
+#elif IS_WINDOWS
+
+  template <typename F>
+  static bool read_directory(const std::string& path, const F& fn) {
+    const std::string search_path = path + "\\*";
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA(search_path.c_str(), &find_data);
+    if (find == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    do {
+      const DWORD attributes = find_data.dwFileAttributes;
+      EntryType type = EntryType::kFile;
+      if (attributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        type = EntryType::kSymlink;
+      } else if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+        type = EntryType::kDirectory;
+      }
+      fn(std::string_view(find_data.cFileName), type);
+    } while (FindNextFileA(find, &find_data) != 0);
+
+    FindClose(find);
+    return true;
+  }
+
+#else
+
+  template <typename F>
+  static bool read_directory(const std::string& path, const F& fn) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+      return false;
+    }
+
+    while (struct dirent* entry = readdir(dir)) {
+      EntryType type = EntryType::kOther;
+      struct stat st;
+      if (entry->d_type == DT_REG) {
+        type = EntryType::kFile;
+      } else if (entry->d_type == DT_DIR) {
+        type = EntryType::kDirectory;
+      } else if (entry->d_type == DT_LNK) {
+        type = EntryType::kSymlink;
+      } else if (fstatat(dirfd(dir), entry->d_name, &st,
+                         AT_SYMLINK_NOFOLLOW) == 0) {
+        type = entry_type_of_mode(st.st_mode);
+      }
+      fn(std::string_view(entry->d_name), type);
+    }
+
+    closedir(dir);
+    return true;
+  }
+
+#endif
+
+  const std::string& root_;
+  const WalkOptions& options_;
+  DirQueue queue_;
+};
+
+}  // namespace
+
+void WalkResult::add(std::string_view path, EntryType type) {
+  arena_.append(path);
+  offsets_.push_back(arena_.size());
+  types_.push_back(type);
+}
+
+void WalkResult::append(WalkResult&& other) {
+  if (empty()) {
+    const std::size_t error_count = error_count_;
+    *this = std::move(other);
+    error_count_ += error_count;
+    return;
+  }
+
+  const std::size_t base = arena_.size();
+  arena_.append(other.arena_);
+  offsets_.reserve(offsets_.size() + other.size());
+  for (std::size_t i = 1; i < other.offsets_.size(); ++i) {
+    offsets_.push_back(base + other.offsets_[i]);
+  }
+  types_.insert(types_.end(), other.types_.begin(), other.types_.end());
+  error_count_ += other.error_count_;
+  other = WalkResult();
+}
+
+std::size_t WalkResult::memory_usage() const {
+  return arena_.capacity() + offsets_.capacity() * sizeof(std::size_t) +
+         types_.capacity() * sizeof(EntryType);
+}
+
+WalkResult walk_directory(const std::string& root,
+                          const WalkOptions& options) {
+  const std::size_t thread_count = std::max<std::size_t>(
+      1, options.thread_count == 0 ? default_thread_count()
+                                   : options.thread_count);
+
+  Walker walker(root, options, thread_count);
+  walker.start();
+
+  std::vector<WalkResult> results(thread_count);
+  parallel_for(thread_count, thread_count, [&](std::size_t worker) {
+    walker.run(worker, &results[worker]);
+  });
+
+  WalkResult merged;
+  for (WalkResult& result : results) {
+    merged.append(std::move(result));
+  }
+  return merged;
+}
+
+}  // namespace core
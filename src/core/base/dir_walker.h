@@ -0,0 +1,104 @@
+#ifndef CORE_BASE_DIR_WALKER_H_
+#define CORE_BASE_DIR_WALKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/base/core_export.h"
+#include "core/check.h"
+
+namespace core {
+
+enum class EntryType : uint8_t {
+  kUnknown = 0,
+  kFile = 1,
+  kDirectory = 2,
+  kSymlink = 3,
+  kOther = 4,
+};
+
+struct WalkOptions {
+  // 0 uses `default_thread_count()`; 1 walks on the calling thread.
+  std::size_t thread_count = 0;
+  // entries of the root are at depth 0. directories at `max_depth` are
+  // reported but not entered.
+  std::size_t max_depth = std::numeric_limits<std::size_t>::max();
+  // entries whose name starts with '.' (and everything below them).
+  bool include_hidden = false;
+  // directories are always descended into; this also reports them.
+  bool include_directories = false;
+  // suffixes such as ".cc"; non-directories must match one. empty keeps all.
+  std::vector<std::string> extensions;
+  // called for every entry that passed the filters above, from any walker
+  // thread. returning false drops the entry and, for a directory, its
+  // subtree.
+  std::function<bool(std::string_view relative_path,
+                     EntryType type,
+                     std::size_t depth)>
+      filter;
+};
+
+// entries found by `walk_directory`, in no particular order. paths are
+// relative to the root and packed into one arena.
+class CORE_EXPORT WalkResult {
+ public:
+  WalkResult() = default;
+
+  ~WalkResult() = default;
+
+  WalkResult(const WalkResult&) = delete;
+  WalkResult& operator=(const WalkResult&) = delete;
+
+  WalkResult(WalkResult&&) noexcept = default;
+  WalkResult& operator=(WalkResult&&) noexcept = default;
+
+  inline std::size_t size() const { return types_.size(); }
+  inline bool empty() const { return types_.empty(); }
+
+  inline std::string_view path(std::size_t i) const {
+    DCHECK_LT(i, size());
+    return std::string_view(arena_.data() + offsets_[i],
+                            offsets_[i + 1] - offsets_[i]);
+  }
+  inline EntryType type(std::size_t i) const {
+    DCHECK_LT(i, size());
+    return types_[i];
+  }
+  // directories that could not be opened or were only read in part; their
+  // missing entries are not in the result.
+  inline std::size_t error_count() const { return error_count_; }
+
+  // appends an entry; used by the walker.
+  void add(std::string_view path, EntryType type);
+  inline void add_error() { ++error_count_; }
+  // moves every entry of `other` to the end of this result.
+  void append(WalkResult&& other);
+
+  // heap bytes held by the result.
+  [[nodiscard]] std::size_t memory_usage() const;
+
+ private:
+  std::string arena_;
+  // `offsets_[i]` to `offsets_[i + 1]` spans entry i in `arena_`.
+  std::vector<std::size_t> offsets_ = {0};
+  std::vector<EntryType> types_;
+  std::size_t error_count_ = 0;
+};
+
+// recursively lists `root` on a pool of threads that share directories
+// through work stealing. on linux directories are read with raw getdents64
+// into large buffers, and `d_type` avoids a stat per entry. symlinks are
+// reported but not followed; unreadable subdirectories are skipped and
+// counted in `error_count()`.
+[[nodiscard]] CORE_EXPORT WalkResult walk_directory(
+    const std::string& root,
+    const WalkOptions& options = {});
+
+}  // namespace core
+
+#endif  // CORE_BASE_DIR_WALKER_H_
@@ -0,0 +1,136 @@
+#include "core/base/dir_walker.h"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+#if !IS_WINDOWS
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+
+std::vector<std::pair<std::string, EntryType>> sorted_entries(
+    const WalkResult& result) {
+  std::vector<std::pair<std::string, EntryType>> entries;
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    entries.emplace_back(std::string(result.path(i)), result.type(i));
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
+std::vector<std::string> sorted_paths(const WalkResult& result) {
+  std::vector<std::string> paths;
+  for (const auto& [path, type] : sorted_entries(result)) {
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+std::string p(std::string_view path) {
+  std::string native(path);
+  std::replace(native.begin(), native.end(), '/', DIR_SEPARATOR);
+  return native;
+}
+
+class DirWalkerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(root_.valid());
+    for (const char* dir : {"a", "a/b", "a/b/c", ".hidden", "empty"}) {
+      make_dir(dir);
+    }
+    for (const char* file : {"top.cc", "a/x.txt", "a/b/y.cc", "a/b/c/z.h",
+                             "a/.dot.cc", ".hidden/h.cc"}) {
+      make_file(file);
+    }
+  }
+
+  void make_dir(std::string_view relative) {
+    ASSERT_EQ(create_directory(full(relative).c_str()), 0);
+  }
+  void make_file(std::string_view relative) {
+    ASSERT_EQ(write_file(full(relative).c_str(), "x"), 0);
+  }
+  std::string full(std::string_view relative) const {
+    return root_.path() + DIR_SEPARATOR + p(relative);
+  }
+
+  TempDir root_{"dir_walker_test_", TempStorage::kMemory, true};
+};
+
+}  // namespace
+
+TEST_F(DirWalkerTest, ListsFilesRecursively) {
+  for (std::size_t thread_count : {1, 4}) {
+    WalkOptions options;
+    options.thread_count = thread_count;
+    WalkResult result = walk_directory(root_.path(), options);
+    EXPECT_EQ(sorted_paths(result),
+              (std::vector<std::string>{p("a/b/c/z.h"), p("a/b/y.cc"),
+                                        p("a/x.txt"), "top.cc"}));
+    for (std::size_t i = 0; i < result.size(); ++i) {
+      EXPECT_EQ(result.type(i), EntryType::kFile);
+    }
+  }
+}
+
+TEST_F(DirWalkerTest, AppliesFilters) {
+  WalkOptions options;
+  options.thread_count = 3;
+  options.extensions = {".cc", ".h"};
+  options.include_hidden = true;
+  EXPECT_EQ(sorted_paths(walk_directory(root_.path(), options)),
+            (std::vector<std::string>{p(".hidden/h.cc"), p("a/.dot.cc"),
+                                      p("a/b/c/z.h"), p("a/b/y.cc"),
+                                      "top.cc"}));
+
+  WalkOptions shallow;
+  shallow.max_depth = 1;
+  shallow.include_directories = true;
+  EXPECT_EQ(sorted_entries(walk_directory(root_.path(), shallow)),
+            (std::vector<std::pair<std::string, EntryType>>{
+                {"a", EntryType::kDirectory},
+                {p("a/b"), EntryType::kDirectory},
+                {p("a/x.txt"), EntryType::kFile},
+                {"empty", EntryType::kDirectory},
+                {"top.cc", EntryType::kFile}}));
+
+  WalkOptions custom;
+  custom.filter = [](std::string_view path, EntryType type,
+                     std::size_t depth) {
+    return !(type == EntryType::kDirectory && path.ends_with("b")) &&
+           depth < 2;
+  };
+  EXPECT_EQ(sorted_paths(walk_directory(root_.path(), custom)),
+            (std::vector<std::string>{p("a/x.txt"), "top.cc"}));
+}
+
+#if !IS_WINDOWS
+TEST_F(DirWalkerTest, ReportsSymlinksWithoutFollowing) {
+  ASSERT_EQ(symlink(full("a").c_str(), full("link").c_str()), 0);
+  WalkOptions options;
+  options.max_depth = 0;
+  EXPECT_EQ(sorted_entries(walk_directory(root_.path(), options)),
+            (std::vector<std::pair<std::string, EntryType>>{
+                {"link", EntryType::kSymlink}, {"top.cc", EntryType::kFile}}));
+}
+#endif
+
+TEST_F(DirWalkerTest, MissingRootIsEmpty) {
+  const WalkResult result = walk_directory("/nonexistent/dir_walker_test");
+  EXPECT_TRUE(result.empty());
+  EXPECT_EQ(result.error_count(), 1u);
+  EXPECT_EQ(walk_directory(root_.path()).error_count(), 0u);
+}
+
+}  // namespace core
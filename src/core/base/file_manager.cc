@@ -1,38 +1,633 @@
 #include "core/base/file_manager.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+#include "build/build_flag.h"
+#include "core/base/file_stat.h"
 #include "core/base/file_util.h"
+#include "core/base/file_watcher.h"
+#include "core/base/hash.h"
+#include "core/base/line_index_cache.h"
+#include "core/base/source_location.h"
 #include "core/check.h"
 
 namespace core {
 
+FileManager::FileManager(const FileManagerOptions& options)
+    : key_shards_(std::make_unique<KeyShard[]>(kShardCount)),
+      content_shards_(std::make_unique<ContentShard[]>(kShardCount)),
+      stripes_(std::make_unique<std::mutex[]>(kShardCount)),
+      options_(options),
+      resident_bytes_(std::make_shared<std::atomic<std::size_t>>(0)) {}
+
+FileManager::~FileManager() {
+  for (std::atomic<Slot*>& segment : segments_) {
+    delete[] segment.load(std::memory_order_relaxed);
+  }
+}
+
+std::size_t FileManager::FileKeyHash::operator()(const FileKey& key) const {
+  const uint64_t words[4] = {key.device, key.inode,
+                             static_cast<uint64_t>(key.mtime_ns), key.size};
+  return static_cast<std::size_t>(hash_bytes(std::string_view(
+      reinterpret_cast<const char*>(words), sizeof(words))));
+}
+
+bool FileManager::key_of(const std::string& path, FileKey* key) {
+#if IS_WINDOWS
+  // inode numbers need an open handle here; not worth it for a cache probe.
+  (void)path;
+  (void)key;
+  return false;
+#else
+  const FileStat stat = stat_path(path.c_str());
+  if (!stat.is_regular()) {
+    return false;
+  }
+  key->device = stat.device;
+  key->inode = stat.inode;
+  key->mtime_ns = stat.mtime_ns;
+  key->size = stat.size;
+  return true;
+#endif
+}
+
+FileManager::Slot& FileManager::slot(FileId id) const {
+  // ids [64 * (2^i - 1), 64 * (2^(i + 1) - 1)) live in segment i.
+  const uint64_t biased = uint64_t{id} / kFirstSegmentSize + 1;
+  const std::size_t index = std::bit_width(biased) - 1;
+  const std::size_t offset =
+      id - kFirstSegmentSize * ((std::size_t{1} << index) - 1);
+  DCHECK_LT(index, kSegmentCount);
+
+  Slot* segment = segments_[index].load(std::memory_order_acquire);
+  if (!segment) {
+    // the first id in a segment races to allocate it; losers free theirs.
+    Slot* fresh = new Slot[kFirstSegmentSize << index];
+    if (segments_[index].compare_exchange_strong(segment, fresh,
+                                                 std::memory_order_acq_rel)) {
+      segment = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  return segment[offset];
+}
+
+std::optional<FileId> FileManager::find_key(const FileKey& key) const {
+  const KeyShard& shard = key_shards_[FileKeyHash()(key) % kShardCount];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (auto it = shard.map.find(key); it != shard.map.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+template <typename Make>
+std::shared_ptr<const FileContent> FileManager::intern(std::string_view source,
+                                                       uint64_t hash,
+                                                       const Make& make) const {
+  ContentShard& shard = content_shards_[hash % kShardCount];
+  auto find =
+      [&](std::string_view bytes) -> std::shared_ptr<const FileContent> {
+    auto [begin, end] = shard.map.equal_range(hash);
+    for (auto it = begin; it != end;) {
+      std::shared_ptr<const FileContent> content = it->second.lock();
+      if (!content) {
+        it = shard.map.erase(it);
+        continue;
+      }
+      // a hash match is only a hint; the bytes decide.
+      if (content->source() == bytes) {
+        return content;
+      }
+      ++it;
+    }
+    return nullptr;
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (auto content = find(source)) {
+      content_hits_.fetch_add(1, std::memory_order_relaxed);
+      return content;
+    }
+  }
+
+  // indexing is the expensive part; keep it out of the lock and settle a race
+  // with an identical load afterwards. `make` may move the bytes `source`
+  // points to, so compare against the built content.
+  std::shared_ptr<const FileContent> built = track(make());
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (auto content = find(built->source())) {
+    content_hits_.fetch_add(1, std::memory_order_relaxed);
+    return content;
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  shard.map.emplace(hash, built);
+  return built;
+}
+
+std::shared_ptr<const FileContent> FileManager::intern_source(
+    std::string&& source,
+    const std::string* file_name) const {
+  const LineIndexCache* cache = options_.line_index_cache.get();
+  return intern(source, hash_bytes(source), [&]() {
+    return cache && file_name
+               ? std::make_unique<FileContent>(std::move(source), *file_name,
+                                               *cache)
+               : std::make_unique<FileContent>(std::move(source));
+  });
+}
+
+std::shared_ptr<const FileContent> FileManager::load_content(
+    const std::string& file_name,
+    bool mapped) const {
+  const LineIndexCache* cache = options_.line_index_cache.get();
+  if (mapped) {
+    MappedFile mapping(file_name.c_str(), options_.access);
+    if (mapping.valid()) {
+      return intern(mapping.view(), hash_bytes(mapping.view()), [&]() {
+        return cache ? std::make_unique<FileContent>(std::move(mapping),
+                                                     file_name, *cache)
+                     : std::make_unique<FileContent>(std::move(mapping));
+      });
+    }
+  }
+  return intern_source(read_file(file_name.c_str(), options_.access),
+                       &file_name);
+}
+
+std::shared_ptr<const FileContent> FileManager::intern_borrowed(
+    std::string_view source,
+    uint64_t hash,
+    LineIndex&& line_index,
+    std::shared_ptr<const void> owner) const {
+  return intern(source, hash, [&]() {
+    return std::make_unique<FileContent>(source, std::move(line_index),
+                                         std::move(owner));
+  });
+}
+
+std::shared_ptr<const FileContent> FileManager::track(
+    std::unique_ptr<FileContent> content) const {
+  const std::size_t charge =
+      content->source().size() + content->line_index().memory_usage();
+  resident_bytes_->fetch_add(charge, std::memory_order_relaxed);
+  return std::shared_ptr<const FileContent>(
+      content.release(),
+      [resident_bytes = resident_bytes_, charge](const FileContent* dead) {
+        resident_bytes->fetch_sub(charge, std::memory_order_relaxed);
+        delete dead;
+      });
+}
+
+FileId FileManager::publish(std::string&& file_name,
+                            std::shared_ptr<const FileContent> content,
+                            const FileKey* key,
+                            bool on_disk,
+                            bool* created) {
+  if (created) {
+    *created = false;
+  }
+  std::unique_lock<std::mutex> lock;
+  KeyShard* shard = nullptr;
+  if (key) {
+    shard = &key_shards_[FileKeyHash()(*key) % kShardCount];
+    lock = std::unique_lock<std::mutex>(shard->mutex);
+    if (auto it = shard->map.find(*key); it != shard->map.end()) {
+      path_hits_.fetch_add(1, std::memory_order_relaxed);
+      return it->second;
+    }
+  }
+
+  const FileId id = next_id_.fetch_add(1, std::memory_order_relaxed);
+  Slot& target = slot(id);
+  target.file =
+      std::make_shared<const File>(std::move(file_name), std::move(content));
+  target.on_disk = on_disk;
+  if (key) {
+    target.key = *key;
+    target.has_key = true;
+    shard->map.emplace(*key, id);
+  }
+  touch(target);
+  target.resident.store(true, std::memory_order_relaxed);
+  target.ready.store(true);
+  if (created) {
+    *created = true;
+  }
+  if (lock.owns_lock()) {
+    lock.unlock();
+  }
+
+  if (on_disk && watching_.load()) {
+    watch_file(id);
+  }
+  enforce_budget(id);
+  return id;
+}
+
 FileId FileManager::add_file(std::string&& source, std::string&& file_name) {
   DCHECK(!file_name.empty())
       << "file name is empty. use `add_virtual_file` for testing purposes.";
 
-  files_.emplace_back(std::move(file_name), std::move(source));
-  return files_.size() - 1;
+  return publish(std::move(file_name), intern_source(std::move(source)),
+                 nullptr, false);
 }
 
-FileId FileManager::add_file(std::string&& file_name) {
-  return add_file(read_file(file_name.c_str()), std::move(file_name));
+FileId FileManager::add_file(std::string&& file_name, FileSourceMode mode) {
+  DCHECK(!file_name.empty());
+
+  FileKey key;
+  const bool has_key = key_of(file_name, &key);
+  if (has_key) {
+    if (std::optional<FileId> id = find_key(key)) {
+      path_hits_.fetch_add(1, std::memory_order_relaxed);
+      return *id;
+    }
+  }
+
+  std::shared_ptr<const FileContent> content =
+      load_content(file_name, mode == FileSourceMode::kMapped);
+  return publish(std::move(file_name), std::move(content),
+                 has_key ? &key : nullptr, true);
+}
+
+std::vector<FileId> FileManager::add_files(std::span<std::string> file_names) {
+  std::vector<FileId> ids(file_names.size());
+  std::vector<FileKey> keys(file_names.size());
+  std::vector<bool> has_key(file_names.size());
+
+  // only the files not loaded yet go to the batched reader.
+  std::vector<std::size_t> misses;
+  std::vector<std::string> miss_names;
+  for (std::size_t i = 0; i < file_names.size(); ++i) {
+    has_key[i] = key_of(file_names[i], &keys[i]);
+    if (has_key[i]) {
+      if (std::optional<FileId> id = find_key(keys[i])) {
+        path_hits_.fetch_add(1, std::memory_order_relaxed);
+        ids[i] = *id;
+        continue;
+      }
+    }
+    misses.push_back(i);
+    miss_names.push_back(std::move(file_names[i]));
+  }
+
+  // a name listed twice in one batch is read twice but published once.
+  std::vector<std::string> sources = read_files(miss_names);
+  for (std::size_t n = 0; n < misses.size(); ++n) {
+    const std::size_t i = misses[n];
+    std::shared_ptr<const FileContent> content =
+        intern_source(std::move(sources[n]), &miss_names[n]);
+    ids[i] = publish(std::move(miss_names[n]), std::move(content),
+                     has_key[i] ? &keys[i] : nullptr, true);
+  }
+  return ids;
+}
+
+void FileManager::watch_file(FileId id) {
+  // `watcher_` is set before `watching_` and never changes afterwards.
+  std::lock_guard<std::mutex> lock(stripe(id));
+  watcher_->add(file_name_of(slot(id)), id);
+}
+
+int FileManager::watch() {
+  std::lock_guard<std::mutex> lock(watch_mutex_);
+  if (watcher_) {
+    return 0;
+  }
+  auto watcher = std::make_unique<FileWatcher>();
+  if (!watcher->valid()) {
+    return -1;
+  }
+  watcher_ = std::move(watcher);
+  // files published from here on watch themselves. one published
+  // concurrently may be added twice, which the watcher ignores.
+  watching_.store(true);
+
+  int result = 0;
+  const FileId count = next_id_.load();
+  for (FileId id = 0; id < count; ++id) {
+    const Slot& file_slot = slot(id);
+    if (!file_slot.ready.load() || !file_slot.on_disk) {
+      continue;
+    }
+    std::lock_guard<std::mutex> stripe_lock(stripe(id));
+    if (watcher_->add(file_name_of(file_slot), id) != 0) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+void FileManager::set_key(FileId id, const FileKey* key) const {
+  Slot& target = slot(id);
+  // the old identity no longer describes this file.
+  if (target.has_key) {
+    KeyShard& shard = key_shards_[FileKeyHash()(target.key) % kShardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (auto it = shard.map.find(target.key);
+        it != shard.map.end() && it->second == id) {
+      shard.map.erase(it);
+    }
+    target.has_key = false;
+  }
+  if (key) {
+    KeyShard& shard = key_shards_[FileKeyHash()(*key) % kShardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.map[*key] = id;
+    target.key = *key;
+    target.has_key = true;
+  }
+}
+
+void FileManager::reload(FileId id) {
+  Slot& target = slot(id);
+  std::lock_guard<std::mutex> lock(stripe(id));
+  FileKey key;
+  const bool has_key = key_of(file_name_of(target), &key);
+  set_key(id, has_key ? &key : nullptr);
+  // an evicted file reads the new content when it is next accessed.
+  if (target.resident.load(std::memory_order_relaxed)) {
+    std::string file_name = target.file->file_name();
+    std::shared_ptr<const FileContent> content =
+        load_content(file_name, target.file->is_mapped());
+    target.file =
+        std::make_shared<const File>(std::move(file_name), std::move(content));
+  }
+  target.generation.fetch_add(1, std::memory_order_release);
+  reloads_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<FileId> FileManager::reload_changed(
+    std::chrono::milliseconds timeout,
+    std::chrono::milliseconds settle) {
+  std::vector<FileId> reloaded;
+  if (!watching()) {
+    return reloaded;
+  }
+  for (uint64_t tag : watcher_->poll(timeout, settle)) {
+    const FileId id = static_cast<FileId>(tag);
+    reload(id);
+    reloaded.push_back(id);
+  }
+  return reloaded;
+}
+
+uint64_t FileManager::generation(FileId id) const {
+  DCHECK_LT(id, size());
+  return slot(id).generation.load(std::memory_order_acquire);
 }
 
 FileId FileManager::add_virtual_file(std::string&& source) {
-  static std::size_t virtual_file_count = 0;
-  std::string virtual_name =
-      std::format("virtual_file_{}", virtual_file_count++);
+  static std::atomic<std::size_t> virtual_file_count{0};
+  std::string virtual_name = std::format(
+      "virtual_file_{}",
+      virtual_file_count.fetch_add(1, std::memory_order_relaxed));
 
   return add_file(std::move(source), std::move(virtual_name));
 }
 
-const File& FileManager::file(FileId id) const {
-  DCHECK_GE(id, 0);
-  DCHECK_LE(id, files_.size());
-  return files_[id];
+std::shared_ptr<const File> FileManager::file(FileId id) const {
+  DCHECK_LT(id, size());
+  Slot& file_slot = slot(id);
+  DCHECK(file_slot.ready.load(std::memory_order_acquire));
+  if (options_.memory_budget == 0) {
+    // nothing but `reload` replaces a published file then, under the stripe
+    // lock and only once watching.
+    if (!watching()) {
+      return file_slot.file;
+    }
+    std::lock_guard<std::mutex> lock(stripe(id));
+    return file_slot.file;
+  }
+
+  touch(file_slot);
+  std::shared_ptr<const File> file;
+  {
+    // eviction resets the slot under this lock; the copy keeps the file
+    // alive past it.
+    std::lock_guard<std::mutex> lock(stripe(id));
+    file = file_slot.file;
+  }
+  if (!file) {
+    file = restore(id);
+    enforce_budget(id);
+  }
+  return file;
+}
+
+void FileManager::pin(FileId id) const {
+  DCHECK_LT(id, size());
+  Slot& file_slot = slot(id);
+  bool resident;
+  {
+    // under the stripe lock, eviction either sees the pin or has finished.
+    std::lock_guard<std::mutex> lock(stripe(id));
+    file_slot.pins.fetch_add(1, std::memory_order_relaxed);
+    resident = file_slot.resident.load(std::memory_order_relaxed);
+  }
+  if (!resident) {
+    (void)file(id);
+  }
+}
+
+void FileManager::unpin(FileId id) const {
+  DCHECK_LT(id, size());
+  const uint32_t pins = slot(id).pins.fetch_sub(1, std::memory_order_relaxed);
+  DCHECK_GT(pins, 0u);
+}
+
+std::mutex& FileManager::stripe(FileId id) const {
+  return stripes_[id % kShardCount];
+}
+
+const std::string& FileManager::file_name_of(const Slot& file_slot) const {
+  return file_slot.file ? file_slot.file->file_name() : file_slot.evicted_name;
+}
+
+void FileManager::touch(Slot& file_slot) const {
+  file_slot.last_use.store(
+      use_clock_.fetch_add(1, std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+}
+
+std::shared_ptr<const File> FileManager::restore(FileId id) const {
+  Slot& target = slot(id);
+  while (true) {
+    std::string file_name;
+    bool mapped = false;
+    uint64_t generation = 0;
+    {
+      std::lock_guard<std::mutex> lock(stripe(id));
+      if (target.file) {
+        return target.file;
+      }
+      file_name = target.evicted_name;
+      mapped = target.evicted_mapped;
+      generation = target.generation.load(std::memory_order_relaxed);
+    }
+
+    // the file may have changed on disk while it was evicted.
+    FileKey key;
+    const bool has_key = key_of(file_name, &key);
+    std::shared_ptr<const FileContent> content =
+        load_content(file_name, mapped);
+
+    std::lock_guard<std::mutex> lock(stripe(id));
+    // another thread restored the file first, or a reload in the meantime
+    // may have seen a newer version than the one read here.
+    if (target.file) {
+      return target.file;
+    }
+    if (target.generation.load(std::memory_order_relaxed) != generation) {
+      continue;
+    }
+    if (has_key != target.has_key || (has_key && !(key == target.key))) {
+      set_key(id, has_key ? &key : nullptr);
+      target.generation.fetch_add(1, std::memory_order_release);
+    }
+    target.file = std::make_shared<const File>(std::move(target.evicted_name),
+                                               std::move(content));
+    target.evicted_name = std::string();
+    touch(target);
+    target.resident.store(true, std::memory_order_release);
+    eviction_reloads_.fetch_add(1, std::memory_order_relaxed);
+    return target.file;
+  }
+}
+
+void FileManager::enforce_budget(FileId keep) const {
+  const std::size_t budget = options_.memory_budget;
+  if (budget == 0 ||
+      resident_bytes_->load(std::memory_order_relaxed) <= budget) {
+    return;
+  }
+  // one thread evicts for everyone.
+  std::unique_lock<std::mutex> lock(evict_mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  // only files loaded from disk can be loaded again.
+  std::vector<std::pair<uint64_t, FileId>> candidates;
+  const FileId count = next_id_.load(std::memory_order_acquire);
+  for (FileId id = 0; id < count; ++id) {
+    const Slot& file_slot = slot(id);
+    if (id != keep && file_slot.ready.load(std::memory_order_acquire) &&
+        file_slot.on_disk &&
+        file_slot.resident.load(std::memory_order_relaxed) &&
+        file_slot.pins.load(std::memory_order_relaxed) == 0) {
+      candidates.emplace_back(
+          file_slot.last_use.load(std::memory_order_relaxed), id);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  // going a little below the budget keeps these scans rare.
+  const std::size_t target = budget - budget / 8;
+  for (const auto& [last_use, id] : candidates) {
+    if (resident_bytes_->load(std::memory_order_relaxed) <= target) {
+      break;
+    }
+    Slot& file_slot = slot(id);
+    std::lock_guard<std::mutex> stripe_lock(stripe(id));
+    if (file_slot.pins.load(std::memory_order_relaxed) != 0 ||
+        !file_slot.resident.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    // content shared with another file, or a `File` a caller still holds,
+    // stays alive through them; evicting it would free nothing.
+    if (file_slot.file.use_count() > 1 ||
+        file_slot.file->content().use_count() > 1) {
+      continue;
+    }
+    file_slot.evicted_mapped = file_slot.file->is_mapped();
+    file_slot.evicted_name = file_slot.file->file_name();
+    file_slot.resident.store(false, std::memory_order_release);
+    file_slot.file.reset();
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+std::size_t FileManager::size() const {
+  return next_id_.load(std::memory_order_acquire);
+}
+
+SourceLocation FileManager::location_of(FileId id, std::size_t offset) const {
+  const LineColumn location = file(id)->location_of(offset);
+  return SourceLocation(location.line, location.column, id);
+}
+
+FileCacheStats FileManager::cache_stats() const {
+  FileCacheStats stats;
+  stats.path_hits = path_hits_.load(std::memory_order_relaxed);
+  stats.content_hits = content_hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.reloads = reloads_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  stats.eviction_reloads = eviction_reloads_.load(std::memory_order_relaxed);
+  stats.snapshot_hits = snapshot_hits_.load(std::memory_order_relaxed);
+  stats.snapshot_refreshes =
+      snapshot_refreshes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::size_t FileManager::resident_bytes() const {
+  return resident_bytes_->load(std::memory_order_relaxed);
+}
+
+std::size_t FileManager::memory_usage() const {
+  std::size_t usage = sizeof(FileManager) +
+                      kShardCount * (sizeof(KeyShard) + sizeof(ContentShard));
+  for (std::size_t i = 0; i < kSegmentCount; ++i) {
+    if (segments_[i].load(std::memory_order_acquire)) {
+      usage += (kFirstSegmentSize << i) * sizeof(Slot);
+    }
+  }
+  for (std::size_t i = 0; i < kShardCount; ++i) {
+    {
+      std::lock_guard<std::mutex> lock(key_shards_[i].mutex);
+      usage += key_shards_[i].map.size() * (sizeof(FileKey) + sizeof(FileId));
+    }
+    std::lock_guard<std::mutex> lock(content_shards_[i].mutex);
+    usage += content_shards_[i].map.size() *
+             (sizeof(uint64_t) + sizeof(std::weak_ptr<const FileContent>));
+  }
+
+  std::unordered_set<const FileContent*> counted;
+  const FileId count = next_id_.load(std::memory_order_acquire);
+  for (FileId id = 0; id < count; ++id) {
+    const Slot& file_slot = slot(id);
+    if (!file_slot.ready.load(std::memory_order_acquire)) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(stripe(id));
+    if (!file_slot.file) {
+      usage += file_slot.evicted_name.capacity();
+      continue;
+    }
+    const File& file = *file_slot.file;
+    usage += file.file_name().capacity();
+    if (counted.insert(file.content().get()).second) {
+      usage += file.content()->memory_usage();
+    }
+  }
+  return usage;
 }
 
 }  // namespace core
@@ -1,8 +1,17 @@
 #ifndef CORE_BASE_FILE_MANAGER_H_
 #define CORE_BASE_FILE_MANAGER_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "core/base/core_export.h"
@@ -12,26 +21,275 @@ namespace core {
 
 using FileId = uint32_t;
 
+class FileWatcher;
+class LineIndexCache;
+class SourceLocation;
+
+struct FileCacheStats {
+  // `add_file` calls answered by a file already loaded from the same path,
+  // unchanged on disk.
+  std::size_t path_hits = 0;
+  // loads whose bytes matched an existing file and now share its content.
+  std::size_t content_hits = 0;
+  // loads that brought new content into the manager.
+  std::size_t misses = 0;
+  // files re-read by `reload_changed`; each also counts as a hit or miss.
+  std::size_t reloads = 0;
+  // contents dropped to stay within the memory budget.
+  std::size_t evictions = 0;
+  // evicted contents loaded again on access; each also counts as a hit or
+  // miss.
+  std::size_t eviction_reloads = 0;
+  // files served straight from a snapshot.
+  std::size_t snapshot_hits = 0;
+  // snapshot entries whose file changed on disk and was loaded again.
+  std::size_t snapshot_refreshes = 0;
+};
+
+struct FileManagerOptions {
+  // bytes of source and line index to keep resident, mapped sources included.
+  // above it, the least recently used files loaded from disk are evicted and
+  // read again on their next access. 0 keeps everything.
+  std::size_t memory_budget = 0;
+  // passed on to the reads and mappings of `add_file`, see `AccessPattern`.
+  AccessPattern access = AccessPattern::kNormal;
+  // if set, files loaded from disk take their line index from it.
+  std::shared_ptr<const LineIndexCache> line_index_cache;
+};
+
+// owns every source file of a run. loads are deduplicated twice: a file on
+// disk that was already loaded and has not changed since (same device, inode,
+// size and mtime) returns its existing id after a single stat, without
+// reading it again, and files with identical bytes share one `FileContent`
+// (source and line index) under separate ids. the identity is the inode, not
+// the path: another path or hard link to a loaded file returns the first
+// path's id, and its `File` keeps the first path's `file_name()`.
+//
+// files can be added from any number of threads while others read. `file(id)`
+// shares out the `File`, which stays valid for as long as the caller holds
+// it, whatever happens to the id in the meantime. without a memory budget
+// and outside of watch mode `file(id)` is wait-free and returns the same
+// `File` for the lifetime of the manager. the reading and indexing of a new
+// file happen outside of any lock.
+//
+// with a memory budget, cold files loaded from disk give up their content
+// and load it again on the next `file(id)`; their ids stay valid. a `File`
+// still held by a caller is only freed once dropped. `file(id)` then takes a
+// short lock and may block on i/o. pin files to keep them resident.
+//
+// in watch mode files loaded from disk are watched for changes, and
+// `reload_changed` re-reads just the files that changed, in place under their
+// existing ids. `file(id)` then takes a short lock as well. call `watch`
+// before other threads start reading.
 class CORE_EXPORT FileManager {
  public:
-  FileManager() = default;
+  explicit FileManager(const FileManagerOptions& options = {});
 
-  ~FileManager() = default;
+  ~FileManager();
 
   FileManager(const FileManager&) = delete;
   FileManager& operator=(const FileManager&) = delete;
 
-  FileManager(FileManager&&) noexcept = default;
-  FileManager& operator=(FileManager&&) noexcept = default;
+  FileManager(FileManager&&) = delete;
+  FileManager& operator=(FileManager&&) = delete;
 
   [[nodiscard]] FileId add_file(std::string&& source, std::string&& file_name);
-  [[nodiscard]] FileId add_file(std::string&& file_name);
+  [[nodiscard]] FileId add_file(
+      std::string&& file_name,
+      FileSourceMode mode = FileSourceMode::kCopy);
   [[nodiscard]] FileId add_virtual_file(std::string&& source);
 
-  const File& file(FileId id) const;
+  // loads every file in `file_names` with batched, overlapped i/o and returns
+  // their ids in input order. the names are moved from.
+  [[nodiscard]] std::vector<FileId> add_files(
+      std::span<std::string> file_names);
+
+  // `id` must come from this manager, and the add that returned it must
+  // happen before this call. loads an evicted file again.
+  [[nodiscard]] std::shared_ptr<const File> file(FileId id) const;
+
+  // keeps the file `id` resident until a matching `unpin`; pins nest.
+  void pin(FileId id) const;
+  void unpin(FileId id) const;
+
+  // number of ids handed out so far. with adds in flight on other threads,
+  // the newest of them may not be readable yet.
+  [[nodiscard]] std::size_t size() const;
+
+  // resolves a byte offset in the file `id` to its line and column.
+  [[nodiscard]] SourceLocation location_of(FileId id, std::size_t offset) const;
+
+  // heap bytes held by the manager and every file in it. content shared by
+  // several files is counted once.
+  [[nodiscard]] std::size_t memory_usage() const;
+
+  [[nodiscard]] FileCacheStats cache_stats() const;
+
+  // bytes counted against the memory budget, for content still alive.
+  [[nodiscard]] std::size_t resident_bytes() const;
+
+  // starts watching every file loaded from disk so far and every one loaded
+  // later. only supported on linux; returns 0 on success and -1 otherwise.
+  int watch();
+  inline bool watching() const {
+    return watching_.load(std::memory_order_acquire);
+  }
+
+  // waits up to `timeout` for watched files to change, lets a burst of writes
+  // settle (see `FileWatcher::poll`), then re-reads and re-indexes each
+  // changed file once. returns the reloaded ids. a reloaded file gets a new
+  // `File`; callers holding the old one keep reading the old source. other
+  // threads may add and read files meanwhile.
+  std::vector<FileId> reload_changed(
+      std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+      std::chrono::milliseconds settle = std::chrono::milliseconds(50));
+
+  // writes every file loaded from disk to a snapshot at `path`: names,
+  // sources and line indexes, plus the size and mtime each file had when it
+  // was read. not supported on windows, where files have no cheap identity;
+  // returns 0 on success and -1 otherwise.
+  int save_snapshot(const char* path) const;
+
+  // maps the snapshot at `path` and adds its files. files whose size and
+  // mtime still match are served from the mapping without reading, hashing
+  // or indexing anything; the others are loaded from disk again. returns -1
+  // if the snapshot cannot be mapped or is malformed, 0 otherwise.
+  int load_snapshot(const char* path);
+
+  // bumped every time the file `id` is reloaded; starts at 0. consumers that
+  // cache anything derived from a file compare this to detect staleness.
+  [[nodiscard]] uint64_t generation(FileId id) const;
 
  private:
-  std::vector<File> files_;
+  // identity of a file on disk; any write changes the mtime or the size.
+  struct FileKey {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+
+    bool operator==(const FileKey&) const = default;
+  };
+  struct FileKeyHash {
+    std::size_t operator()(const FileKey& key) const;
+  };
+
+  // the fields below `ready` change only under the slot's stripe lock.
+  struct Slot {
+    std::shared_ptr<const File> file;
+    FileKey key;
+    bool has_key = false;
+    // loaded from disk by name, so it can be watched and reloaded.
+    bool on_disk = false;
+    std::atomic<uint64_t> generation{0};
+    // set once `file` is constructed; publishes it to other threads.
+    std::atomic<bool> ready{false};
+
+    // false while evicted; `file` is empty then.
+    std::atomic<bool> resident{false};
+    std::atomic<uint32_t> pins{0};
+    // value of the use clock at the last access.
+    std::atomic<uint64_t> last_use{0};
+    std::string evicted_name;
+    bool evicted_mapped = false;
+  };
+
+  // segment i holds `kFirstSegmentSize << i` slots, so a few dozen segments
+  // cover every `FileId` and none is ever reallocated.
+  static constexpr std::size_t kFirstSegmentSize = 64;
+  static constexpr std::size_t kSegmentCount = 27;
+  static constexpr std::size_t kShardCount = 16;
+
+  template <typename Map>
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    Map map;
+  };
+  using KeyShard = Shard<std::unordered_map<FileKey, FileId, FileKeyHash>>;
+  // content hash to every live content with that hash. entries expire with
+  // the last file holding the content.
+  using ContentShard = Shard<
+      std::unordered_multimap<uint64_t, std::weak_ptr<const FileContent>>>;
+
+  // false if `path` cannot be stat'ed or identity is unknown on this
+  // platform; such files always go through the content lookup.
+  static bool key_of(const std::string& path, FileKey* key);
+
+  Slot& slot(FileId id) const;
+  // the existing file with identity `key`, if any.
+  std::optional<FileId> find_key(const FileKey& key) const;
+
+  // the content of an earlier file with the same bytes (whose hash is
+  // `hash`), or a new one built by `make` (outside of any lock) and
+  // registered for later loads.
+  template <typename Make>
+  std::shared_ptr<const FileContent> intern(std::string_view source,
+                                            uint64_t hash,
+                                            const Make& make) const;
+  // indexes through the line index cache if `file_name` is the path the
+  // source was read from.
+  std::shared_ptr<const FileContent> intern_source(
+      std::string&& source,
+      const std::string* file_name = nullptr) const;
+  std::shared_ptr<const FileContent> intern_borrowed(
+      std::string_view source,
+      uint64_t hash,
+      LineIndex&& line_index,
+      std::shared_ptr<const void> owner) const;
+  // reads `file_name` from disk, mapped if asked and possible.
+  std::shared_ptr<const FileContent> load_content(const std::string& file_name,
+                                                  bool mapped) const;
+  // charges `content` to the resident bytes for as long as it lives.
+  std::shared_ptr<const FileContent> track(
+      std::unique_ptr<FileContent> content) const;
+
+  // stores a new file in the next free slot and publishes it. a file with
+  // identity `key` that was published first is returned instead, and
+  // `created`, if given, is set to false.
+  FileId publish(std::string&& file_name,
+                 std::shared_ptr<const FileContent> content,
+                 const FileKey* key,
+                 bool on_disk,
+                 bool* created = nullptr);
+  // moves the identity of `id` to `key`, or drops it for null.
+  void set_key(FileId id, const FileKey* key) const;
+  void watch_file(FileId id);
+  void reload(FileId id);
+
+  std::mutex& stripe(FileId id) const;
+  const std::string& file_name_of(const Slot& file_slot) const;
+  void touch(Slot& file_slot) const;
+  // loads the content of the evicted file `id` again and returns the file.
+  // reads outside of the stripe lock of `id` and publishes under it.
+  std::shared_ptr<const File> restore(FileId id) const;
+  // evicts cold files until the resident bytes are back under the budget,
+  // sparing `keep` and files whose content something else still holds.
+  void enforce_budget(FileId keep) const;
+  mutable std::atomic<Slot*> segments_[kSegmentCount] = {};
+  std::atomic<FileId> next_id_{0};
+
+  std::unique_ptr<KeyShard[]> key_shards_;
+  std::unique_ptr<ContentShard[]> content_shards_;
+  std::unique_ptr<std::mutex[]> stripes_;
+
+  const FileManagerOptions options_;
+  // shared with the deleters of tracked content, which may outlive us.
+  std::shared_ptr<std::atomic<std::size_t>> resident_bytes_;
+  mutable std::atomic<uint64_t> use_clock_{0};
+  mutable std::mutex evict_mutex_;
+
+  std::atomic<std::size_t> path_hits_{0};
+  mutable std::atomic<std::size_t> content_hits_{0};
+  mutable std::atomic<std::size_t> misses_{0};
+  std::atomic<std::size_t> reloads_{0};
+  std::atomic<std::size_t> snapshot_hits_{0};
+  std::atomic<std::size_t> snapshot_refreshes_{0};
+  mutable std::atomic<std::size_t> evictions_{0};
+  mutable std::atomic<std::size_t> eviction_reloads_{0};
+
+  std::mutex watch_mutex_;
+  std::atomic<bool> watching_{false};
+  std::unique_ptr<FileWatcher> watcher_;
 };
 
 }  // namespace core
@@ -0,0 +1,346 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/file_manager.h"
+#include "core/base/file_util.h"
+#include "core/base/hash.h"
+#include "core/base/logger.h"
+#include "core/base/mapped_file.h"
+
+namespace core {
+
+namespace {
+
+// the snapshot is a header, an entry table and 8-byte aligned blobs, all in
+// host byte order. offsets are from the start of the file, so a mapping can
+// be used as is.
+constexpr char kSnapshotMagic[8] = {'C', 'F', 'M', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kSnapshotVersion = 3;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr std::size_t kAlignment = 8;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t entry_count;
+  uint64_t total_size;
+  // hash of the entry table.
+  uint64_t table_hash;
+};
+
+struct SnapshotEntry {
+  uint64_t name_offset;
+  uint64_t name_size;
+  uint64_t source_offset;
+  uint64_t source_size;
+  uint64_t content_hash;
+  // identity of the file when its source was read.
+  int64_t mtime_ns;
+  uint64_t file_size;
+  uint64_t line_count;
+  uint64_t narrow_offset;
+  uint64_t narrow_count;
+  uint64_t checkpoints_offset;
+  uint64_t checkpoints_count;
+  uint64_t wide_offset;
+  uint64_t wide_count;
+  uint8_t encoding;
+  uint8_t reserved[7];
+};
+
+static_assert(sizeof(SnapshotHeader) % kAlignment == 0);
+static_assert(sizeof(SnapshotEntry) % kAlignment == 0);
+
+std::size_t align_up(std::size_t value) {
+  return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// collects the blobs that follow the entry table, as views for one batched
+// write, and hands out their offsets.
+class BlobWriter {
+ public:
+  explicit BlobWriter(std::size_t start) : size_(start) {}
+
+  template <typename T>
+  uint64_t add(std::span<const T> values) {
+    return add(std::string_view(reinterpret_cast<const char*>(values.data()),
+                                values.size_bytes()));
+  }
+
+  uint64_t add(std::string_view bytes) {
+    static constexpr char kZeros[kAlignment] = {};
+    const uint64_t offset = size_;
+    if (!bytes.empty()) {
+      pieces_.push_back(bytes);
+    }
+    size_ += bytes.size();
+    const std::size_t padding = align_up(size_) - size_;
+    if (padding > 0) {
+      pieces_.push_back(std::string_view(kZeros, padding));
+      size_ += padding;
+    }
+    return offset;
+  }
+
+  inline std::size_t size() const { return size_; }
+  inline std::vector<std::string_view>& pieces() { return pieces_; }
+
+ private:
+  std::size_t size_;
+  std::vector<std::string_view> pieces_;
+};
+
+bool in_bounds(uint64_t offset, uint64_t bytes, std::size_t size) {
+  return offset <= size && bytes <= size - offset &&
+         offset % kAlignment == 0;
+}
+
+// every offset and count lies inside the mapping and fits the line count.
+bool valid_layout(const SnapshotEntry& entry, std::size_t size) {
+  const auto encoding = static_cast<LineIndex::Encoding>(entry.encoding);
+  if (encoding != LineIndex::Encoding::kNarrow &&
+      encoding != LineIndex::Encoding::kBlockDelta &&
+      encoding != LineIndex::Encoding::kWide) {
+    return false;
+  }
+  const uint64_t blocks = (entry.line_count + LineIndex::kBlockSize - 1) /
+                          LineIndex::kBlockSize;
+  const bool wide = encoding == LineIndex::Encoding::kWide;
+  return in_bounds(entry.name_offset, entry.name_size, size) &&
+         in_bounds(entry.source_offset, entry.source_size, size) &&
+         entry.checkpoints_count == blocks &&
+         (wide ? entry.wide_count : entry.narrow_count) == entry.line_count &&
+         entry.narrow_count <= size / sizeof(uint32_t) &&
+         entry.checkpoints_count <= size / sizeof(uint64_t) &&
+         entry.wide_count <= size / sizeof(uint64_t) &&
+         in_bounds(entry.narrow_offset,
+                   entry.narrow_count * sizeof(uint32_t), size) &&
+         in_bounds(entry.checkpoints_offset,
+                   entry.checkpoints_count * sizeof(uint64_t), size) &&
+         in_bounds(entry.wide_offset, entry.wide_count * sizeof(uint64_t),
+                   size);
+}
+
+// the checkpoints are sorted and inside the source, and each is the first
+// entry of its block. this reads one line end per block; the ones in between
+// are trusted, as the table hash and total size already reject a snapshot
+// that was not written whole by `save_snapshot`.
+bool valid_checkpoints(const SnapshotEntry& entry, const char* base) {
+  const auto encoding = static_cast<LineIndex::Encoding>(entry.encoding);
+  const auto* narrow =
+      reinterpret_cast<const uint32_t*>(base + entry.narrow_offset);
+  const auto* checkpoints =
+      reinterpret_cast<const uint64_t*>(base + entry.checkpoints_offset);
+  const auto* wide =
+      reinterpret_cast<const uint64_t*>(base + entry.wide_offset);
+  uint64_t previous = 0;
+  for (uint64_t block = 0; block < entry.checkpoints_count; ++block) {
+    const uint64_t checkpoint = checkpoints[block];
+    const uint64_t i = block << LineIndex::kBlockShift;
+    uint64_t value = 0;
+    switch (encoding) {
+      case LineIndex::Encoding::kNarrow: value = narrow[i]; break;
+      case LineIndex::Encoding::kBlockDelta:
+        value = checkpoint + narrow[i];
+        break;
+      case LineIndex::Encoding::kWide: value = wide[i]; break;
+    }
+    if (checkpoint < previous || checkpoint > entry.source_size ||
+        value != checkpoint) {
+      return false;
+    }
+    previous = checkpoint;
+  }
+  return true;
+}
+
+bool valid_entry(const SnapshotEntry& entry,
+                 const char* base,
+                 std::size_t size) {
+  return valid_layout(entry, size) && valid_checkpoints(entry, base);
+}
+
+void log_invalid_snapshot(const char* path, const char* reason) {
+  glog.error_ref<"ignoring the snapshot {}: {}\n">(path, reason);
+  glog.flush();
+}
+
+}  // namespace
+
+int FileManager::save_snapshot(const char* path) const {
+#if IS_WINDOWS
+  // entries are validated by identity, which `key_of` has no inode for here.
+  glog.error_ref<"cannot save the snapshot {}: not supported on windows\n">(
+      path);
+  glog.flush();
+  return -1;
+#else
+  struct Saved {
+    std::string name;
+    FileKey key;
+    std::shared_ptr<const FileContent> content;
+  };
+
+  // the content pointers keep every source alive, even if its file is
+  // evicted or reloaded while the snapshot is written.
+  std::vector<Saved> saved;
+  const FileId count = next_id_.load(std::memory_order_acquire);
+  for (FileId id = 0; id < count; ++id) {
+    Slot& file_slot = slot(id);
+    if (!file_slot.ready.load(std::memory_order_acquire) ||
+        !file_slot.on_disk) {
+      continue;
+    }
+    pin(id);
+    {
+      std::lock_guard<std::mutex> lock(stripe(id));
+      if (file_slot.has_key) {
+        saved.push_back(Saved{file_slot.file->file_name(), file_slot.key,
+                              file_slot.file->content()});
+      }
+    }
+    unpin(id);
+  }
+
+  std::vector<SnapshotEntry> entries(saved.size());
+  BlobWriter blobs(sizeof(SnapshotHeader) +
+                   entries.size() * sizeof(SnapshotEntry));
+  for (std::size_t i = 0; i < saved.size(); ++i) {
+    const FileContent& content = *saved[i].content;
+    const LineIndex& index = content.line_index();
+    SnapshotEntry& entry = entries[i];
+    std::memset(&entry, 0, sizeof(entry));
+    entry.name_offset = blobs.add(saved[i].name);
+    entry.name_size = saved[i].name.size();
+    entry.source_offset = blobs.add(content.source());
+    entry.source_size = content.source().size();
+    entry.content_hash = hash_bytes(content.source());
+    entry.mtime_ns = saved[i].key.mtime_ns;
+    entry.file_size = saved[i].key.size;
+    entry.line_count = index.size();
+    entry.encoding = static_cast<uint8_t>(index.encoding());
+    entry.narrow_offset = blobs.add(index.narrow_entries());
+    entry.narrow_count = index.narrow_entries().size();
+    entry.checkpoints_offset = blobs.add(index.checkpoint_entries());
+    entry.checkpoints_count = index.checkpoint_entries().size();
+    entry.wide_offset = blobs.add(index.wide_entries());
+    entry.wide_count = index.wide_entries().size();
+  }
+
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.byte_order = kByteOrderMark;
+  header.entry_count = entries.size();
+  header.total_size = blobs.size();
+  header.table_hash = hash_bytes(
+      std::string_view(reinterpret_cast<const char*>(entries.data()),
+                       entries.size() * sizeof(SnapshotEntry)));
+
+  std::vector<std::string_view> pieces;
+  pieces.reserve(blobs.pieces().size() + 2);
+  pieces.push_back(
+      std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)));
+  pieces.push_back(
+      std::string_view(reinterpret_cast<const char*>(entries.data()),
+                       entries.size() * sizeof(SnapshotEntry)));
+  pieces.insert(pieces.end(), blobs.pieces().begin(), blobs.pieces().end());
+  return write_file_atomic(path, pieces, Durability::kNone);
+#endif
+}
+
+int FileManager::load_snapshot(const char* path) {
+  auto mapping = std::make_shared<const MappedFile>(path);
+  if (!mapping->valid()) {
+    log_invalid_snapshot(path, "cannot map it");
+    return -1;
+  }
+  const char* const base = mapping->data();
+  const std::size_t size = mapping->size();
+
+  SnapshotHeader header;
+  if (size < sizeof(header)) {
+    log_invalid_snapshot(path, "truncated");
+    return -1;
+  }
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+      header.version != kSnapshotVersion ||
+      header.byte_order != kByteOrderMark) {
+    log_invalid_snapshot(path, "unknown format");
+    return -1;
+  }
+  if (header.total_size != size ||
+      header.entry_count >
+          (size - sizeof(header)) / sizeof(SnapshotEntry)) {
+    log_invalid_snapshot(path, "truncated");
+    return -1;
+  }
+
+  // mappings are page aligned, so the table can be used in place.
+  const std::span<const SnapshotEntry> entries(
+      reinterpret_cast<const SnapshotEntry*>(base + sizeof(header)),
+      header.entry_count);
+  if (hash_bytes(std::string_view(base + sizeof(header),
+                                  entries.size_bytes())) !=
+      header.table_hash) {
+    log_invalid_snapshot(path, "corrupt entry table");
+    return -1;
+  }
+  for (const SnapshotEntry& entry : entries) {
+    if (!valid_entry(entry, base, size)) {
+      log_invalid_snapshot(path, "corrupt entry");
+      return -1;
+    }
+  }
+
+  std::vector<std::string> stale;
+  for (const SnapshotEntry& entry : entries) {
+    std::string name(base + entry.name_offset, entry.name_size);
+    FileKey key;
+    if (!key_of(name, &key) || key.mtime_ns != entry.mtime_ns ||
+        key.size != entry.file_size) {
+      stale.push_back(std::move(name));
+      continue;
+    }
+
+    const std::string_view source(base + entry.source_offset,
+                                  entry.source_size);
+    LineIndex index = LineIndex::borrow(
+        static_cast<LineIndex::Encoding>(entry.encoding), entry.line_count,
+        std::span<const uint32_t>(
+            reinterpret_cast<const uint32_t*>(base + entry.narrow_offset),
+            entry.narrow_count),
+        std::span<const uint64_t>(
+            reinterpret_cast<const uint64_t*>(base + entry.checkpoints_offset),
+            entry.checkpoints_count),
+        std::span<const uint64_t>(
+            reinterpret_cast<const uint64_t*>(base + entry.wide_offset),
+            entry.wide_count));
+    std::shared_ptr<const FileContent> content = intern_borrowed(
+        source, entry.content_hash, std::move(index), mapping);
+    bool created = false;
+    publish(std::move(name), std::move(content), &key, true, &created);
+    if (created) {
+      snapshot_hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (!stale.empty()) {
+    snapshot_refreshes_.fetch_add(stale.size(), std::memory_order_relaxed);
+    (void)add_files(stale);
+  }
+  return 0;
+}
+
+}  // namespace core
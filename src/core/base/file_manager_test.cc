@@ -0,0 +1,620 @@
+#include "core/base/file_manager.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/base/file_util.h"
+#include "core/base/source_location.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+TEST(FileManagerTest, AddFilesKeepsInputOrder) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+
+  constexpr std::size_t kFileCount = 40;
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    std::string path = join_path(dir.path(), "file" + std::to_string(i));
+    ASSERT_EQ(write_file(path.c_str(), "line\n" + std::to_string(i)), 0);
+    paths.push_back(path);
+  }
+  std::string missing = join_path(dir.path(), "missing");
+  std::vector<std::string> names = paths;
+  names.push_back(missing);
+
+  FileManager manager;
+  FileId first = manager.add_virtual_file("virtual");
+  std::vector<FileId> ids = manager.add_files(names);
+  ASSERT_EQ(ids.size(), kFileCount + 1);
+
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    EXPECT_NE(ids[i], first);
+    const std::shared_ptr<const File> file = manager.file(ids[i]);
+    EXPECT_EQ(file->file_name(), paths[i]);
+    ASSERT_EQ(file->line_count(), 2);
+    EXPECT_EQ(file->line(2), std::to_string(i));
+  }
+  EXPECT_TRUE(manager.file(ids.back())->source().empty());
+
+  for (const std::string& path : paths) {
+    EXPECT_EQ(remove_file(path.c_str()), 0);
+  }
+}
+
+TEST(FileManagerTest, SamePathReturnsSameId) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  std::string path = join_path(dir.path(), "header.h");
+  ASSERT_EQ(write_file(path.c_str(), "#pragma once\nint x;\n"), 0);
+
+  FileManager manager;
+  FileId first = manager.add_file(std::string(path));
+  FileId second = manager.add_file(std::string(path));
+  std::vector<std::string> names = {path, path};
+  std::vector<FileId> batch = manager.add_files(names);
+
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(batch[0], first);
+  EXPECT_EQ(batch[1], first);
+  EXPECT_EQ(manager.cache_stats().misses, 1);
+  EXPECT_EQ(manager.cache_stats().path_hits, 3);
+
+  EXPECT_EQ(remove_file(path.c_str()), 0);
+}
+
+TEST(FileManagerTest, IdenticalContentIsShared) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  std::string a = join_path(dir.path(), "a.h");
+  std::string b = join_path(dir.path(), "b.h");
+  ASSERT_EQ(write_file(a.c_str(), "same\ncontent\n"), 0);
+  ASSERT_EQ(write_file(b.c_str(), "same\ncontent\n"), 0);
+
+  FileManager manager;
+  FileId id_a = manager.add_file(std::string(a), FileSourceMode::kMapped);
+  FileId id_b = manager.add_file(std::string(b));
+  FileId id_c = manager.add_virtual_file("other\n");
+
+  EXPECT_NE(id_a, id_b);
+  EXPECT_EQ(manager.file(id_b)->file_name(), b);
+  EXPECT_EQ(manager.file(id_a)->source().data(),
+            manager.file(id_b)->source().data());
+  EXPECT_EQ(&manager.file(id_a)->line_index(),
+            &manager.file(id_b)->line_index());
+  EXPECT_EQ(manager.file(id_b)->line(2), "content");
+  EXPECT_NE(manager.file(id_c)->source().data(),
+            manager.file(id_a)->source().data());
+
+  EXPECT_EQ(manager.cache_stats().content_hits, 1);
+  EXPECT_EQ(manager.cache_stats().misses, 2);
+
+  EXPECT_EQ(remove_file(a.c_str()), 0);
+  EXPECT_EQ(remove_file(b.c_str()), 0);
+}
+
+TEST(FileManagerTest, ModifiedFileIsReloaded) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  std::string path = join_path(dir.path(), "changing.h");
+  ASSERT_EQ(write_file(path.c_str(), "old\n"), 0);
+
+  FileManager manager;
+  FileId first = manager.add_file(std::string(path));
+
+  ASSERT_EQ(write_file(path.c_str(), "new\n"), 0);
+  // same size, so the cache can only tell from the mtime; do not rely on the
+  // file system's timestamp granularity.
+  std::filesystem::last_write_time(
+      path, std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+  FileId second = manager.add_file(std::string(path));
+
+  EXPECT_NE(first, second);
+  EXPECT_EQ(manager.file(first)->source(), "old\n");
+  EXPECT_EQ(manager.file(second)->source(), "new\n");
+  EXPECT_EQ(manager.add_file(std::string(path)), second);
+
+  EXPECT_EQ(remove_file(path.c_str()), 0);
+}
+
+TEST(FileManagerTest, ConcurrentAddsAndReads) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  constexpr std::size_t kFileCount = 32;
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    std::string path = join_path(dir.path(), "file" + std::to_string(i));
+    // pairs of files share their content.
+    ASSERT_EQ(write_file(path.c_str(), "file\n" + std::to_string(i / 2)), 0);
+    paths.push_back(path);
+  }
+
+  constexpr std::size_t kWriterCount = 4;
+  constexpr std::size_t kReaderCount = 2;
+  // enough files to span several segments.
+  constexpr std::size_t kVirtualPerWriter = 600;
+
+  FileManager manager;
+  // ids of files whose add has finished, published for the readers.
+  constexpr FileId kUnset = ~FileId{0};
+  std::vector<std::atomic<FileId>> published(kWriterCount * kVirtualPerWriter);
+  for (std::atomic<FileId>& id : published) {
+    id.store(kUnset);
+  }
+  std::atomic<std::size_t> published_count{0};
+  std::vector<std::vector<FileId>> path_ids(kWriterCount);
+  const File* first_file = nullptr;
+  std::atomic<bool> writers_done{false};
+  std::atomic<std::size_t> failures{0};
+
+  std::vector<std::thread> threads;
+  for (std::size_t w = 0; w < kWriterCount; ++w) {
+    threads.emplace_back([&, w]() {
+      for (std::size_t i = 0; i < kVirtualPerWriter; ++i) {
+        const std::string text = std::to_string(w) + ":" + std::to_string(i);
+        const FileId id = manager.add_virtual_file(std::string(text));
+        if (manager.file(id)->source() != text) {
+          failures.fetch_add(1);
+        }
+        published[published_count.fetch_add(1)].store(
+            id, std::memory_order_release);
+
+        if (i < kFileCount) {
+          // every writer loads every path, in a different order.
+          const std::string& path = paths[(i + w * 7) % kFileCount];
+          const FileId path_id = manager.add_file(
+              std::string(path), w % 2 == 0 ? FileSourceMode::kCopy
+                                            : FileSourceMode::kMapped);
+          if (manager.file(path_id)->file_name() != path) {
+            failures.fetch_add(1);
+          }
+          path_ids[w].push_back(path_id);
+        }
+      }
+    });
+  }
+  for (std::size_t r = 0; r < kReaderCount; ++r) {
+    threads.emplace_back([&]() {
+      while (!writers_done.load()) {
+        const std::size_t count = published_count.load();
+        for (std::size_t i = 0; i < count; ++i) {
+          const FileId id = published[i].load(std::memory_order_acquire);
+          // counted but not stored yet.
+          if (id == kUnset) {
+            continue;
+          }
+          if (manager.file(id)->source().empty()) {
+            failures.fetch_add(1);
+          }
+        }
+      }
+    });
+  }
+
+  for (std::size_t w = 0; w < kWriterCount; ++w) {
+    threads[w].join();
+    if (w == 0) {
+      first_file = manager.file(0).get();
+    }
+  }
+  writers_done.store(true);
+  for (std::size_t r = 0; r < kReaderCount; ++r) {
+    threads[kWriterCount + r].join();
+  }
+
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_EQ(manager.size(), kWriterCount * kVirtualPerWriter + kFileCount);
+  // references stay put while the manager grows.
+  EXPECT_EQ(first_file, manager.file(0).get());
+
+  // each path got exactly one id, whichever writer loaded it first.
+  std::vector<FileId> id_of_path(kFileCount);
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    id_of_path[i] = path_ids[0][i];
+  }
+  for (std::size_t w = 1; w < kWriterCount; ++w) {
+    for (std::size_t i = 0; i < kFileCount; ++i) {
+      EXPECT_EQ(path_ids[w][i], id_of_path[(i + w * 7) % kFileCount]);
+    }
+  }
+  for (std::size_t i = 0; i < kFileCount; i += 2) {
+    EXPECT_EQ(manager.file(id_of_path[i])->source().data(),
+              manager.file(id_of_path[i + 1])->source().data());
+  }
+
+  const FileCacheStats stats = manager.cache_stats();
+  EXPECT_EQ(stats.path_hits, (kWriterCount - 1) * kFileCount);
+  EXPECT_EQ(stats.misses, kWriterCount * kVirtualPerWriter + kFileCount / 2);
+
+  for (const std::string& path : paths) {
+    EXPECT_EQ(remove_file(path.c_str()), 0);
+  }
+}
+
+TEST(FileManagerTest, MemoryBudgetEvictsColdFiles) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  constexpr std::size_t kFileCount = 8;
+  constexpr std::size_t kFileSize = 10000;
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    std::string path = join_path(dir.path(), "file" + std::to_string(i));
+    std::string content(kFileSize, static_cast<char>('a' + i));
+    content.back() = '\n';
+    ASSERT_EQ(write_file(path.c_str(), content), 0);
+    paths.push_back(path);
+  }
+
+  FileManagerOptions options;
+  options.memory_budget = 3 * kFileSize;
+  FileManager manager(options);
+  std::vector<FileId> ids;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    ids.push_back(manager.add_file(
+        std::string(paths[i]),
+        i % 2 == 0 ? FileSourceMode::kCopy : FileSourceMode::kMapped));
+  }
+  EXPECT_LE(manager.resident_bytes(), options.memory_budget);
+  EXPECT_GT(manager.cache_stats().evictions, 0);
+
+  // evicted files come back under the same id.
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    const std::shared_ptr<const File> file = manager.file(ids[i]);
+    EXPECT_EQ(file->file_name(), paths[i]);
+    ASSERT_EQ(file->source().size(), kFileSize);
+    EXPECT_EQ(file->source().front(), static_cast<char>('a' + i));
+  }
+  EXPECT_GT(manager.cache_stats().eviction_reloads, 0);
+  EXPECT_LE(manager.resident_bytes(), options.memory_budget);
+
+  // a pinned file survives any amount of pressure.
+  manager.pin(ids[0]);
+  const char* pinned = manager.file(ids[0])->source().data();
+  for (int round = 0; round < 3; ++round) {
+    for (std::size_t i = 1; i < kFileCount; ++i) {
+      EXPECT_EQ(manager.file(ids[i])->line_count(), 1);
+    }
+  }
+  EXPECT_EQ(manager.file(ids[0])->source().data(), pinned);
+  manager.unpin(ids[0]);
+
+  // a file that changed while evicted is read fresh and marked stale.
+  for (std::size_t i = 1; i < kFileCount; ++i) {
+    EXPECT_EQ(manager.file(ids[i])->line_count(), 1);
+  }
+  ASSERT_EQ(write_file(paths[0].c_str(), "changed\nfile\n"), 0);
+  EXPECT_EQ(manager.generation(ids[0]), 0);
+  EXPECT_EQ(manager.file(ids[0])->line(2), "file");
+  EXPECT_EQ(manager.generation(ids[0]), 1);
+
+  // evicting a file a caller still holds would free nothing, so the cold
+  // file stays resident.
+  std::shared_ptr<const File> held = manager.file(ids[1]);
+  for (std::size_t i = 2; i < kFileCount; ++i) {
+    EXPECT_EQ(manager.file(ids[i])->line_count(), 1);
+  }
+  const std::size_t eviction_reloads =
+      manager.cache_stats().eviction_reloads;
+  held.reset();
+  EXPECT_EQ(manager.file(ids[1])->source().front(), 'b');
+  EXPECT_EQ(manager.cache_stats().eviction_reloads, eviction_reloads);
+
+  for (const std::string& path : paths) {
+    EXPECT_EQ(remove_file(path.c_str()), 0);
+  }
+}
+
+TEST(FileManagerTest, ReadersSurviveConcurrentEviction) {
+  TempDir dir("file_manager_test_", TempStorage::kMemory, true);
+  ASSERT_TRUE(dir.valid());
+  constexpr std::size_t kFileCount = 16;
+  constexpr std::size_t kFileSize = 4096;
+  constexpr std::size_t kReaderCount = 4;
+  constexpr std::size_t kRounds = 200;
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    std::string path = join_path(dir.path(), "file" + std::to_string(i));
+    std::string content(kFileSize, static_cast<char>('a' + i));
+    content.back() = '\n';
+    ASSERT_EQ(write_file(path.c_str(), content), 0);
+    paths.push_back(path);
+  }
+
+  // room for two files, so nearly every access evicts another reader's file.
+  FileManagerOptions options;
+  options.memory_budget = 2 * kFileSize;
+  FileManager manager(options);
+  std::vector<FileId> ids;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    ids.push_back(manager.add_file(
+        std::string(paths[i]),
+        i % 2 == 0 ? FileSourceMode::kCopy : FileSourceMode::kMapped));
+  }
+
+  std::atomic<std::size_t> failures{0};
+  std::vector<std::thread> readers;
+  for (std::size_t r = 0; r < kReaderCount; ++r) {
+    readers.emplace_back([&, r]() {
+      for (std::size_t round = 0; round < kRounds; ++round) {
+        const std::size_t i = (round * 5 + r * 3) % kFileCount;
+        const std::shared_ptr<const File> file = manager.file(ids[i]);
+        // other readers evict the file while it is read here.
+        (void)manager.file(ids[(i + 1) % kFileCount]);
+        const std::string_view source = file->source();
+        if (source.size() != kFileSize ||
+            source.front() != static_cast<char>('a' + i) ||
+            source[kFileSize / 2] != static_cast<char>('a' + i) ||
+            file->line_count() != 1 ||
+            manager.location_of(ids[i], kFileSize / 2).line() != 1) {
+          failures.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_GT(manager.cache_stats().evictions, 0);
+}
+
+TEST(FileManagerTest, SnapshotRoundTrip) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < 3; ++i) {
+    std::string path = join_path(dir.path(), "file" + std::to_string(i));
+    ASSERT_EQ(write_file(path.c_str(), "first\r\nsecond " + std::to_string(i)),
+              0);
+    paths.push_back(path);
+  }
+  const std::string snapshot = join_path(dir.path(), "files.snapshot");
+
+  {
+    FileManager manager;
+    for (const std::string& path : paths) {
+      const FileId id = manager.add_file(std::string(path));
+      EXPECT_EQ(manager.file(id)->line_count(), 2);
+    }
+    EXPECT_EQ(manager.add_virtual_file("not saved"), 3);
+    ASSERT_EQ(manager.save_snapshot(snapshot.c_str()), 0);
+  }
+
+  // a different size marks the entry stale.
+  ASSERT_EQ(write_file(paths[2].c_str(), "changed\n"), 0);
+
+  FileManager manager;
+  ASSERT_EQ(manager.load_snapshot(snapshot.c_str()), 0);
+  EXPECT_EQ(manager.size(), 3);
+  EXPECT_EQ(manager.cache_stats().snapshot_hits, 2);
+  EXPECT_EQ(manager.cache_stats().snapshot_refreshes, 1);
+
+  for (std::size_t i = 0; i < 2; ++i) {
+    const FileId id = manager.add_file(std::string(paths[i]));
+    const std::shared_ptr<const File> file = manager.file(id);
+    EXPECT_TRUE(file->is_mapped());
+    EXPECT_EQ(file->file_name(), paths[i]);
+    ASSERT_EQ(file->line_count(), 2);
+    EXPECT_EQ(file->line(1), "first");
+    EXPECT_EQ(file->line(2), "second " + std::to_string(i));
+    EXPECT_EQ(file->location_of(8), (LineColumn{2, 2}));
+  }
+  EXPECT_EQ(manager.file(manager.add_file(std::string(paths[2])))->source(),
+            "changed\n");
+  EXPECT_EQ(manager.cache_stats().path_hits, 3);
+
+  // files already loaded are not served from the snapshot again.
+  ASSERT_EQ(manager.load_snapshot(snapshot.c_str()), 0);
+  EXPECT_EQ(manager.size(), 3);
+  EXPECT_EQ(manager.cache_stats().snapshot_hits, 2);
+
+  // a line end that is not its block's checkpoint rejects the snapshot. the
+  // first entry follows the 40-byte header, and its narrow array offset is
+  // the ninth field.
+  const std::string saved = read_file(snapshot.c_str());
+  std::string corrupt = saved;
+  uint64_t narrow_offset = 0;
+  std::memcpy(&narrow_offset, corrupt.data() + 40 + 8 * sizeof(uint64_t),
+              sizeof(narrow_offset));
+  corrupt.replace(narrow_offset, 4, "\xff\xff\xff\xff");
+  ASSERT_EQ(write_file(snapshot.c_str(), corrupt), 0);
+  FileManager rejecting;
+  EXPECT_EQ(rejecting.load_snapshot(snapshot.c_str()), -1);
+  EXPECT_EQ(rejecting.size(), 0);
+
+  // so does a changed entry, here the size of the first source.
+  corrupt = saved;
+  corrupt[40 + 3 * sizeof(uint64_t)] ^= 1;
+  ASSERT_EQ(write_file(snapshot.c_str(), corrupt), 0);
+  EXPECT_EQ(rejecting.load_snapshot(snapshot.c_str()), -1);
+  EXPECT_EQ(rejecting.size(), 0);
+
+  ASSERT_EQ(write_file(snapshot.c_str(), "not a snapshot, but long enough"),
+            0);
+  EXPECT_EQ(manager.load_snapshot(snapshot.c_str()), -1);
+
+  EXPECT_EQ(remove_file(snapshot.c_str()), 0);
+  for (const std::string& path : paths) {
+    EXPECT_EQ(remove_file(path.c_str()), 0);
+  }
+}
+
+TEST(FileManagerTest, WatchReloadsChangedFilesOnce) {
+  TempDir dir("file_manager_test_");
+  ASSERT_TRUE(dir.valid());
+  std::string watched = join_path(dir.path(), "watched.h");
+  std::string later = join_path(dir.path(), "later.h");
+  std::string other = join_path(dir.path(), "other.h");
+  ASSERT_EQ(write_file(watched.c_str(), "v0\n"), 0);
+  ASSERT_EQ(write_file(later.c_str(), "later\n"), 0);
+
+  FileManager manager;
+  FileId id = manager.add_file(std::string(watched));
+  if (manager.watch() != 0) {
+    GTEST_SKIP() << "file watching is not supported here";
+  }
+  FileId later_id = manager.add_file(std::string(later));
+  EXPECT_TRUE(manager.reload_changed().empty());
+
+  // a burst of in-place saves and a replacing save, plus a file nobody
+  // loaded.
+  for (int i = 1; i <= 10; ++i) {
+    ASSERT_EQ(write_file(watched.c_str(), "v" + std::to_string(i) + "\n"), 0);
+  }
+  ASSERT_EQ(write_file_atomic(watched.c_str(), "final\nversion\n"), 0);
+  ASSERT_EQ(write_file(other.c_str(), "other\n"), 0);
+
+  std::vector<FileId> reloaded = manager.reload_changed(
+      std::chrono::milliseconds(2000), std::chrono::milliseconds(100));
+  ASSERT_EQ(reloaded.size(), 1);
+  EXPECT_EQ(reloaded[0], id);
+  EXPECT_EQ(manager.generation(id), 1);
+  EXPECT_EQ(manager.generation(later_id), 0);
+  EXPECT_EQ(manager.file(id)->line_count(), 2);
+  EXPECT_EQ(manager.file(id)->line(2), "version");
+  EXPECT_EQ(manager.cache_stats().reloads, 1);
+
+  // the reloaded content is what a fresh load of the path finds.
+  EXPECT_EQ(manager.add_file(std::string(watched)), id);
+
+  ASSERT_EQ(write_file(later.c_str(), "changed\n"), 0);
+  reloaded = manager.reload_changed(std::chrono::milliseconds(2000),
+                                    std::chrono::milliseconds(10));
+  ASSERT_EQ(reloaded.size(), 1);
+  EXPECT_EQ(reloaded[0], later_id);
+  EXPECT_EQ(manager.file(later_id)->source(), "changed\n");
+
+  // reloading one of two files with the same content leaves the other one
+  // shareable.
+  const std::string twin = join_path(dir.path(), "twin.h");
+  const std::string copy = join_path(dir.path(), "copy.h");
+  ASSERT_EQ(write_file(twin.c_str(), "changed\n"), 0);
+  ASSERT_EQ(write_file(copy.c_str(), "changed\n"), 0);
+  const FileId twin_id = manager.add_file(std::string(twin));
+  // the writes above are still queued.
+  (void)manager.reload_changed(std::chrono::milliseconds(0),
+                               std::chrono::milliseconds(10));
+  ASSERT_EQ(write_file(later.c_str(), "again\n"), 0);
+  reloaded = manager.reload_changed(std::chrono::milliseconds(2000),
+                                    std::chrono::milliseconds(10));
+  ASSERT_EQ(reloaded.size(), 1);
+  EXPECT_EQ(reloaded[0], later_id);
+  const std::size_t content_hits = manager.cache_stats().content_hits;
+  const FileId copy_id = manager.add_file(std::string(copy));
+  EXPECT_EQ(manager.cache_stats().content_hits, content_hits + 1);
+  EXPECT_EQ(manager.file(copy_id)->content(), manager.file(twin_id)->content());
+
+  for (const std::string& path : {watched, later, other, twin, copy}) {
+    EXPECT_EQ(remove_file(path.c_str()), 0);
+  }
+}
+
+TEST(FileManagerTest, ReloadSettlesDespiteUnrelatedWrites) {
+  TempDir dir("file_manager_test_", TempStorage::kDisk, true);
+  ASSERT_TRUE(dir.valid());
+  const std::string watched = join_path(dir.path(), "watched.h");
+  const std::string noisy = join_path(dir.path(), "noisy.log");
+  ASSERT_EQ(write_file(watched.c_str(), "v0\n"), 0);
+
+  FileManager manager;
+  const FileId id = manager.add_file(std::string(watched));
+  if (manager.watch() != 0) {
+    GTEST_SKIP() << "file watching is not supported here";
+  }
+
+  // another file in the same directory is written throughout the settle.
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    const auto give_up =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!done.load() && std::chrono::steady_clock::now() < give_up) {
+      (void)write_file(noisy.c_str(), "noise\n");
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  });
+  ASSERT_EQ(write_file(watched.c_str(), "v1\n"), 0);
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<FileId> reloaded = manager.reload_changed(
+      std::chrono::milliseconds(1000), std::chrono::milliseconds(20));
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  done.store(true);
+  writer.join();
+
+  ASSERT_EQ(reloaded.size(), 1);
+  EXPECT_EQ(reloaded[0], id);
+  EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(FileManagerTest, ReadersSurviveConcurrentReloads) {
+  TempDir dir("file_manager_test_", TempStorage::kDisk, true);
+  ASSERT_TRUE(dir.valid());
+  constexpr std::size_t kFileCount = 4;
+  constexpr std::size_t kReaderCount = 4;
+  constexpr int kRounds = 20;
+  std::vector<std::string> paths;
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    paths.push_back(join_path(dir.path(), "file" + std::to_string(i)));
+    ASSERT_EQ(write_file(paths.back().c_str(), "v0\n"), 0);
+  }
+
+  FileManager manager;
+  std::vector<FileId> ids;
+  for (const std::string& path : paths) {
+    ids.push_back(manager.add_file(std::string(path)));
+  }
+  if (manager.watch() != 0) {
+    GTEST_SKIP() << "file watching is not supported here";
+  }
+
+  std::atomic<bool> done{false};
+  std::atomic<std::size_t> failures{0};
+  std::vector<std::thread> readers;
+  for (std::size_t r = 0; r < kReaderCount; ++r) {
+    readers.emplace_back([&, r]() {
+      for (std::size_t i = r; !done.load(std::memory_order_relaxed); ++i) {
+        const std::shared_ptr<const File> file =
+            manager.file(ids[i % kFileCount]);
+        if (file->line_count() != 1 || file->source().front() != 'v' ||
+            file->source().back() != '\n') {
+          failures.fetch_add(1);
+        }
+      }
+    });
+  }
+  std::size_t reloads = 0;
+  for (int round = 1; round <= kRounds; ++round) {
+    for (const std::string& path : paths) {
+      EXPECT_EQ(write_file(path.c_str(), "v" + std::to_string(round) + "\n"),
+                0);
+    }
+    reloads += manager
+                   .reload_changed(std::chrono::milliseconds(1000),
+                                   std::chrono::milliseconds(1))
+                   .size();
+  }
+  done.store(true);
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(failures.load(), 0);
+  EXPECT_GT(reloads, 0);
+  // the last writes may still be queued.
+  (void)manager.reload_changed(std::chrono::milliseconds(0),
+                               std::chrono::milliseconds(10));
+  for (std::size_t i = 0; i < kFileCount; ++i) {
+    EXPECT_EQ(manager.file(ids[i])->source(),
+              "v" + std::to_string(kRounds) + "\n");
+  }
+}
+
+}  // namespace core
@@ -0,0 +1,263 @@
+#include "core/base/file_stat.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/io_uring.h"
+#include "core/base/parallel.h"
+
+#if IS_LINUX
+#include <sys/sysmacros.h>
+#endif
+
+namespace core {
+
+namespace {
+
+// a thread pays for itself from about this many lookups on.
+constexpr std::size_t kPathsPerThread = 256;
+
+#if !IS_WINDOWS
+FileType type_of(uint32_t st_mode) {
+  if (S_ISREG(st_mode)) {
+    return FileType::kRegular;
+  }
+  if (S_ISDIR(st_mode)) {
+    return FileType::kDirectory;
+  }
+  return FileType::kOther;
+}
+
+FileStat from_stat(const struct stat& st) {
+  FileStat result;
+  result.size = static_cast<uint64_t>(st.st_size);
+#if IS_LINUX
+  result.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                    st.st_mtim.tv_nsec;
+#else
+  result.mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#endif
+  result.inode = static_cast<uint64_t>(st.st_ino);
+  result.device = static_cast<uint64_t>(st.st_dev);
+  result.mode = static_cast<uint32_t>(st.st_mode) & 07777;
+  result.type = type_of(static_cast<uint32_t>(st.st_mode));
+  return result;
+}
+
+FileStat stat_with_stat(const char* path) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    return FileStat();
+  }
+  return from_stat(st);
+}
+#endif  // !IS_WINDOWS
+
+#if IS_LINUX && defined(STATX_TYPE)
+
+// everything `FileStat` holds and nothing more; the file system may skip
+// fetching the rest.
+constexpr unsigned int kStatxMask =
+    STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME;
+constexpr unsigned int kRingEntries = 256;
+constexpr std::size_t kMinPathsForRing = 64;
+
+FileStat from_statx(const struct statx& stx) {
+  FileStat result;
+  result.size = stx.stx_size;
+  result.mtime_ns = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000 +
+                    stx.stx_mtime.tv_nsec;
+  result.inode = stx.stx_ino;
+  result.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+  result.mode = stx.stx_mode & 07777;
+  result.type = type_of(stx.stx_mode);
+  return result;
+}
+
+// a kernel or sandbox without statx; -EINVAL also covers an io_uring that
+// does not know the opcode (before linux 5.6).
+bool statx_unsupported(int error) {
+  return error == ENOSYS || error == EINVAL || error == EOPNOTSUPP ||
+         error == EPERM;
+}
+
+// looks `paths` up in batches of statx submissions. entries the ring cannot
+// serve are appended to `fallback`. returns false if no ring could be set
+// up; nothing has been looked up then.
+bool stat_with_io_uring(std::span<const std::string> paths,
+                        std::vector<FileStat>* results,
+                        std::vector<std::size_t>* fallback) {
+  IoUring ring(kRingEntries);
+  if (!ring.valid()) {
+    return false;
+  }
+
+  const std::size_t batch_size = ring.capacity();
+  std::vector<struct statx> buffers(batch_size);
+  for (std::size_t base = 0; base < paths.size(); base += batch_size) {
+    const std::size_t count = std::min(batch_size, paths.size() - base);
+    for (std::size_t i = 0; i < count; ++i) {
+      ring.prepare_statx(paths[base + i].c_str(), AT_STATX_SYNC_AS_STAT,
+                         kStatxMask, &buffers[i], i);
+    }
+    const bool ok = complete_all(&ring, count, [&](const IoCompletion& c) {
+      const std::size_t i = c.user_data;
+      if (c.result == 0) {
+        (*results)[base + i] = from_statx(buffers[i]);
+      } else if (statx_unsupported(-c.result)) {
+        fallback->push_back(base + i);
+      }
+    });
+    if (!ok) {
+      // lookups still in flight write into `buffers`.
+      drain_all(&ring, [](const IoCompletion&) {});
+      // the batch may have completed in part; look all of it up again.
+      std::erase_if(*fallback, [base](std::size_t i) { return i >= base; });
+      for (std::size_t i = base; i < paths.size(); ++i) {
+        fallback->push_back(i);
+      }
+      return true;
+    }
+  }
+  return true;
+}
+
+#endif  // IS_LINUX && defined(STATX_TYPE)
+
+}  // namespace
+
+FileStat stat_path(const char* path) {
+#if IS_WINDOWS
+  struct _stat64 st;
+  if (_stat64(path, &st) != 0) {
+    return FileStat();
+  }
+  FileStat result;
+  result.size = static_cast<uint64_t>(st.st_size);
+  result.mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+  result.device = static_cast<uint64_t>(st.st_dev);
+  result.mode = static_cast<uint32_t>(st.st_mode) & 07777;
+  const unsigned int type = st.st_mode & _S_IFMT;
+  result.type = type == _S_IFREG   ? FileType::kRegular
+                : type == _S_IFDIR ? FileType::kDirectory
+                                   : FileType::kOther;
+  return result;
+#elif IS_LINUX && defined(STATX_TYPE)
+  struct statx stx;
+  if (statx(AT_FDCWD, path, AT_STATX_SYNC_AS_STAT, kStatxMask, &stx) == 0) {
+    return from_statx(stx);
+  }
+  return statx_unsupported(errno) ? stat_with_stat(path) : FileStat();
+#else
+  return stat_with_stat(path);
+#endif
+}
+
+std::vector<FileStat> stat_many(std::span<const std::string> paths) {
+  std::vector<FileStat> results(paths.size());
+  std::vector<std::size_t> fallback;
+
+#if IS_LINUX && defined(STATX_TYPE)
+  const bool used_ring = paths.size() >= kMinPathsForRing &&
+                         stat_with_io_uring(paths, &results, &fallback);
+#else
+  const bool used_ring = false;
+#endif
+
+  if (!used_ring) {
+    fallback.resize(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      fallback[i] = i;
+    }
+  }
+
+  const std::size_t thread_count =
+      std::min(default_thread_count(),
+               std::max<std::size_t>(1, fallback.size() / kPathsPerThread));
+  parallel_for(fallback.size(), thread_count, [&](std::size_t i) {
+    const std::size_t index = fallback[i];
+    results[index] = stat_path(paths[index].c_str());
+  });
+  return results;
+}
+
+FileStat StatCache::stat(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return it->second;
+    }
+  }
+
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  const FileStat result = stat_path(path.c_str());
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.emplace(path, result);
+  return result;
+}
+
+std::vector<FileStat> StatCache::stat_many(
+    std::span<const std::string> paths) {
+  std::vector<FileStat> results(paths.size());
+  std::vector<std::size_t> misses;
+  std::vector<std::string> miss_paths;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      auto it = entries_.find(paths[i]);
+      if (it != entries_.end()) {
+        results[i] = it->second;
+      } else {
+        misses.push_back(i);
+        miss_paths.push_back(paths[i]);
+      }
+    }
+  }
+  hits_.fetch_add(paths.size() - misses.size(), std::memory_order_relaxed);
+  if (misses.empty()) {
+    return results;
+  }
+
+  // looked up outside the lock; a path another thread added meanwhile keeps
+  // its first entry.
+  misses_.fetch_add(misses.size(), std::memory_order_relaxed);
+  const std::vector<FileStat> looked_up = core::stat_many(miss_paths);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t n = 0; n < misses.size(); ++n) {
+    results[misses[n]] = looked_up[n];
+    entries_.emplace(std::move(miss_paths[n]), looked_up[n]);
+  }
+  return results;
+}
+
+void StatCache::invalidate(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(path);
+}
+
+void StatCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+StatCacheStats StatCache::stats() const {
+  StatCacheStats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace core
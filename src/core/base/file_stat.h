@@ -0,0 +1,89 @@
+#ifndef CORE_BASE_FILE_STAT_H_
+#define CORE_BASE_FILE_STAT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+enum class FileType : uint8_t {
+  // missing, or the lookup failed.
+  kNone = 0,
+  kRegular = 1,
+  kDirectory = 2,
+  // fifos, sockets, devices.
+  kOther = 3,
+};
+
+// the metadata of a path that callers usually ask for, symlinks followed.
+struct FileStat {
+  uint64_t size = 0;
+  int64_t mtime_ns = 0;
+  uint64_t inode = 0;
+  uint64_t device = 0;
+  // permission bits (07777).
+  uint32_t mode = 0;
+  FileType type = FileType::kNone;
+
+  inline bool exists() const { return type != FileType::kNone; }
+  inline bool is_regular() const { return type == FileType::kRegular; }
+  inline bool is_directory() const { return type == FileType::kDirectory; }
+
+  bool operator==(const FileStat&) const = default;
+};
+
+// one `statx` (`stat` where unavailable) asking the file system for only
+// the fields of `FileStat`.
+[[nodiscard]] CORE_EXPORT FileStat stat_path(const char* path);
+
+// `stat_path` for every path, in input order. large batches go through
+// io_uring where available and a thread pool otherwise.
+[[nodiscard]] CORE_EXPORT std::vector<FileStat> stat_many(
+    std::span<const std::string> paths);
+
+struct StatCacheStats {
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+};
+
+// remembers the metadata of every path it looked up, so that repeated
+// questions within one run cost a hash lookup. nothing is refreshed on its
+// own: callers that change files, or expect others to, invalidate them.
+// safe to share between threads.
+class CORE_EXPORT StatCache {
+ public:
+  StatCache() = default;
+
+  ~StatCache() = default;
+
+  StatCache(const StatCache&) = delete;
+  StatCache& operator=(const StatCache&) = delete;
+
+  [[nodiscard]] FileStat stat(const std::string& path);
+  // the misses among `paths` are looked up in one `stat_many` batch.
+  [[nodiscard]] std::vector<FileStat> stat_many(
+      std::span<const std::string> paths);
+
+  void invalidate(const std::string& path);
+  void clear();
+
+  [[nodiscard]] StatCacheStats stats() const;
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<std::string, FileStat> entries_;
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> misses_{0};
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_FILE_STAT_H_
@@ -0,0 +1,101 @@
+#include "core/base/file_stat.h"
+
+#include <string>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+TEST(FileStatTest, StatPathReportsTypeAndSize) {
+  TempDir dir("file_stat_test_");
+  ASSERT_TRUE(dir.valid());
+  const std::string file = join_path(dir.path(), "file.txt");
+  ASSERT_EQ(write_file(file.c_str(), "twelve bytes"), 0);
+
+  const FileStat regular = stat_path(file.c_str());
+  EXPECT_TRUE(regular.is_regular());
+  EXPECT_EQ(regular.size, 12u);
+  EXPECT_GT(regular.mtime_ns, 0);
+  EXPECT_NE(regular.mode & 0400, 0u);
+#if !IS_WINDOWS
+  EXPECT_NE(regular.inode, 0u);
+#endif
+
+  EXPECT_TRUE(stat_path(dir.path().c_str()).is_directory());
+  const FileStat missing = stat_path((file + ".missing").c_str());
+  EXPECT_FALSE(missing.exists());
+  EXPECT_EQ(missing, FileStat());
+
+  EXPECT_EQ(remove_file(file.c_str()), 0);
+}
+
+TEST(FileStatTest, StatManyMatchesStatPath) {
+  TempDir dir("file_stat_test_");
+  ASSERT_TRUE(dir.valid());
+  std::vector<std::string> files;
+  std::vector<std::string> paths;
+  // enough for the batched path, mixing files, misses and directories.
+  for (std::size_t i = 0; i < 300; ++i) {
+    std::string path = join_path(dir.path(), "file" + std::to_string(i));
+    if (i % 3 == 0) {
+      ASSERT_EQ(write_file(path.c_str(), std::string(i, 'x')), 0);
+      files.push_back(path);
+    } else if (i % 3 == 1) {
+      path = dir.path();
+    }
+    paths.push_back(path);
+  }
+
+  const std::vector<FileStat> stats = stat_many(paths);
+  ASSERT_EQ(stats.size(), paths.size());
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    EXPECT_EQ(stats[i], stat_path(paths[i].c_str())) << paths[i];
+    EXPECT_EQ(stats[i].exists(), i % 3 != 2) << paths[i];
+  }
+  EXPECT_EQ(stats[3].size, 3u);
+  EXPECT_TRUE(stat_many(std::vector<std::string>()).empty());
+
+  for (const std::string& file : files) {
+    EXPECT_EQ(remove_file(file.c_str()), 0);
+  }
+}
+
+TEST(FileStatTest, CacheServesRepeatsUntilInvalidated) {
+  TempDir dir("file_stat_test_");
+  ASSERT_TRUE(dir.valid());
+  const std::string file = join_path(dir.path(), "file.txt");
+  const std::string other = join_path(dir.path(), "other.txt");
+  ASSERT_EQ(write_file(file.c_str(), "abc"), 0);
+
+  StatCache cache;
+  EXPECT_EQ(cache.stat(file).size, 3u);
+  EXPECT_FALSE(cache.stat(other).exists());
+  ASSERT_EQ(write_file(file.c_str(), "abcdef"), 0);
+  ASSERT_EQ(write_file(other.c_str(), "x"), 0);
+
+  // still the remembered answers.
+  EXPECT_EQ(cache.stat(file).size, 3u);
+  const std::vector<std::string> both = {file, other};
+  std::vector<FileStat> stats = cache.stat_many(both);
+  EXPECT_EQ(stats[0].size, 3u);
+  EXPECT_FALSE(stats[1].exists());
+  EXPECT_EQ(cache.stats().hits, 3u);
+  EXPECT_EQ(cache.stats().misses, 2u);
+
+  cache.invalidate(file);
+  stats = cache.stat_many(both);
+  EXPECT_EQ(stats[0].size, 6u);
+  EXPECT_FALSE(stats[1].exists());
+
+  cache.clear();
+  EXPECT_TRUE(cache.stat(other).is_regular());
+  EXPECT_EQ(cache.stats().misses, 4u);
+
+  EXPECT_EQ(remove_file(file.c_str()), 0);
+  EXPECT_EQ(remove_file(other.c_str()), 0);
+}
+
+}  // namespace core
@@ -1,13 +1,18 @@
 #include "core/base/file_util.h"
 
 #include <limits.h>
-#include <zlib.h>
 
+#include <algorithm>
 #include <chrono>
 #include <utility>
 
 #include "build/build_flag.h"
+#include "core/base/byte_scan.h"
+#include "core/base/file_stat.h"
+#include "core/base/line_index.h"
+#include "core/base/line_index_cache.h"
 #include "core/base/logger.h"
+#include "core/base/parallel.h"
 #include "core/check.h"
 
 #if IS_WINDOWS
@@ -37,33 +42,61 @@
 namespace core {
 
 bool file_exists(const char* file_name) {
+  const FileStat stat = stat_path(file_name);
 #if IS_WINDOWS
-  DWORD attributes = GetFileAttributesA(file_name);
-  return (attributes != INVALID_FILE_ATTRIBUTES &&
-          !(attributes & FILE_ATTRIBUTE_DIRECTORY));
+  return stat.exists() && !stat.is_directory();
 #else
-  struct stat buffer;
-  return (stat(file_name, &buffer) == 0) && S_ISREG(buffer.st_mode);
+  return stat.is_regular();
 #endif
 }
 
 bool dir_exists(const char* dir_name) {
+  return stat_path(dir_name).is_directory();
+}
+
+namespace {
+
 #if IS_WINDOWS
-  DWORD attributes = GetFileAttributesA(dir_name);
-  return (attributes != INVALID_FILE_ATTRIBUTES &&
-          (attributes & FILE_ATTRIBUTE_DIRECTORY));
+int open_flags_for(AccessPattern access) {
+  switch (access) {
+    case AccessPattern::kSequential:
+    case AccessPattern::kDontNeed: return _O_SEQUENTIAL;
+    case AccessPattern::kRandom: return _O_RANDOM;
+    default: return 0;
+  }
+}
+#else
+// only a hint; failures are harmless.
+void advise_file(int fd, AccessPattern access) {
+#if IS_LINUX
+  int advice = POSIX_FADV_NORMAL;
+  switch (access) {
+    case AccessPattern::kNormal: return;
+    case AccessPattern::kSequential:
+    case AccessPattern::kDontNeed: advice = POSIX_FADV_SEQUENTIAL; break;
+    case AccessPattern::kRandom: advice = POSIX_FADV_RANDOM; break;
+    case AccessPattern::kWillNeed: advice = POSIX_FADV_WILLNEED; break;
+  }
+  (void)posix_fadvise(fd, 0, 0, advice);
 #else
-  struct stat buffer;
-  return stat(dir_name, &buffer) == 0 && S_ISDIR(buffer.st_mode);
+  (void)fd;
+  (void)access;
 #endif
 }
 
-namespace {
+void drop_cached_pages(int fd) {
+#if IS_LINUX
+  (void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+  (void)fd;
+#endif
+}
+#endif
 
 template <typename T>
-T read_file_impl(const char* path) {
+T read_file_impl(const char* path, AccessPattern access) {
 #if IS_WINDOWS
-  int fd = _open(path, _O_RDONLY | _O_BINARY);
+  int fd = _open(path, _O_RDONLY | _O_BINARY | open_flags_for(access));
 #else
   int fd = open(path, O_RDONLY);
 #endif
@@ -92,6 +125,10 @@ T read_file_impl(const char* path) {
     return {};
   }
 
+#if !IS_WINDOWS
+  advise_file(fd, access);
+#endif
+
   T result;
   if (st.st_size > 0) {
     result.resize(static_cast<std::size_t>(st.st_size));
@@ -102,6 +139,25 @@ T read_file_impl(const char* path) {
                         static_cast<unsigned int>(st.st_size - total_read));
 #else
       ssize_t bytes = read(fd, &result[total_read], st.st_size - total_read);
+#endif
+      if (bytes <= 0) {
+        break;
+      }
+      total_read += static_cast<std::size_t>(bytes);
+    }
+    result.resize(total_read);
+  } else if ((st.st_mode & S_IFMT) != S_IFREG) {
+    // pipes, fifos and character devices report no size up front, so read
+    // until eof instead.
+    constexpr std::size_t kChunkSize = 64 * 1024;
+    std::size_t total_read = 0;
+    while (true) {
+      result.resize(total_read + kChunkSize);
+#if IS_WINDOWS
+      int bytes = _read(fd, &result[total_read],
+                        static_cast<unsigned int>(kChunkSize));
+#else
+      ssize_t bytes = read(fd, &result[total_read], kChunkSize);
 #endif
       if (bytes <= 0) {
         break;
@@ -114,6 +170,9 @@ T read_file_impl(const char* path) {
 #if IS_WINDOWS
   _close(fd);
 #else
+  if (access == AccessPattern::kDontNeed) {
+    drop_cached_pages(fd);
+  }
   close(fd);
 #endif
   return result;
@@ -121,16 +180,17 @@ T read_file_impl(const char* path) {
 
 }  // namespace
 
-std::vector<std::byte> read_file_bin(const char* path) {
-  return read_file_impl<std::vector<std::byte>>(path);
+std::vector<std::byte> read_file_bin(const char* path, AccessPattern access) {
+  return read_file_impl<std::vector<std::byte>>(path, access);
 }
 
-std::string read_file(const char* path) {
-  return read_file_impl<std::string>(path);
+std::string read_file(const char* path, AccessPattern access) {
+  return read_file_impl<std::string>(path, access);
 }
 
-std::u8string read_file_utf8(const char8_t* path) {
-  return read_file_impl<std::u8string>(reinterpret_cast<const char*>(path));
+std::u8string read_file_utf8(const char8_t* path, AccessPattern access) {
+  return read_file_impl<std::u8string>(reinterpret_cast<const char*>(path),
+                                       access);
 }
 
 const std::string& exe_path() {
@@ -191,15 +251,19 @@ bool is_executable_in_path(const char* path) {
   if (!path_env) {
     return false;
   }
-  std::string path_var = path_env;
-  std::size_t start = 0, end;
-  while ((end = path_var.find(PATH_SEPARATOR, start)) != std::string::npos) {
-    std::string dir = path_var.substr(start, end - start);
-    std::string full_path = dir + DIR_SEPARATOR + path;
+
+  const std::string path_var = path_env;
+  std::size_t start = 0;
+  while (start <= path_var.size()) {
+    std::size_t end = path_var.find(PATH_SEPARATOR, start);
+    if (end == std::string::npos) {
+      end = path_var.size();
+    }
+    const std::string full_path =
+        path_var.substr(start, end - start) + DIR_SEPARATOR + path;
 #if IS_WINDOWS
     for (const auto& ext : exts) {
-      std::string candidate = full_path + ext;
-      if (file_exists(candidate.c_str())) {
+      if (file_exists((full_path + ext).c_str())) {
         return true;
       }
     }
@@ -211,21 +275,6 @@ bool is_executable_in_path(const char* path) {
 #endif
     start = end + 1;
   }
-  // check the last path entry
-  std::string dir = path_var.substr(start);
-  std::string full_path = dir + DIR_SEPARATOR + path;
-#if IS_WINDOWS
-  for (const auto& ext : exts) {
-    std::string candidate = full_path + ext;
-    if (file_exists(candidate.c_str())) {
-      return true;
-    }
-  }
-#else
-  if (file_exists(full_path.c_str()) && access(full_path.c_str(), X_OK) == 0) {
-    return true;
-  }
-#endif
   return false;
 }
 
@@ -291,6 +340,24 @@ std::string base_name(const std::string& path) {
   return path.substr(pos + 1);
 }
 
+std::string canonical_path(const std::string& path) {
+#if IS_WINDOWS
+  char buffer[MAX_PATH];
+  if (!_fullpath(buffer, path.c_str(), MAX_PATH)) {
+    return std::string();
+  }
+  return std::string(buffer);
+#else
+  char* resolved = realpath(path.c_str(), nullptr);
+  if (!resolved) {
+    return std::string();
+  }
+  std::string result(resolved);
+  std::free(resolved);
+  return result;
+#endif
+}
+
 std::string temp_directory() {
 #if IS_WINDOWS
   char buffer[MAX_PATH];
@@ -311,39 +378,23 @@ std::string temp_directory() {
 #endif
 }
 
-bool compress(const char* src_path,
-              const char* dest_path,
-              bool remove_after_compress) {
-  DCHECK(file_exists(src_path));
-  DCHECK(!file_exists(dest_path));
-  FILE* src = std::fopen(src_path, "rb");
-  if (!src) {
-    return false;
-  }
-
-  gzFile dst = gzopen(dest_path, "wb");
-  if (!dst) {
-    std::fclose(src);
-    return false;
+std::string cache_directory() {
+#if IS_WINDOWS
+  const char* local_app_data = std::getenv("LOCALAPPDATA");
+  if (local_app_data && *local_app_data) {
+    return std::string(local_app_data) + DIR_SEPARATOR;
   }
-
-  constexpr std::size_t kBufSize = 8192;
-  char buf[kBufSize];
-  while (std::size_t read = std::fread(buf, 1, kBufSize, src)) {
-    if (gzwrite(dst, buf, static_cast<unsigned int>(read)) == 0) {
-      gzclose(dst);
-      std::fclose(src);
-      return false;
-    }
+#else
+  const char* cache_home = std::getenv("XDG_CACHE_HOME");
+  if (cache_home && *cache_home) {
+    return std::string(cache_home) + DIR_SEPARATOR;
   }
-
-  gzclose(dst);
-  std::fclose(src);
-
-  if (remove_after_compress) {
-    std::remove(src_path);
+  const char* home = std::getenv("HOME");
+  if (home && *home) {
+    return std::string(home) + DIR_SEPARATOR + ".cache" + DIR_SEPARATOR;
   }
-  return true;
+#endif
+  return temp_directory();
 }
 
 int create_directory(const char* path) {
@@ -620,10 +671,14 @@ std::vector<std::size_t> index_newlines_default(std::string_view content) {
   return indexes;
 }
 
-#if ENABLE_AVX2
+namespace {
 
-std::vector<std::string> read_lines_with_avx2(std::string_view content) {
-  std::vector<std::string> lines;
+// `Line` is std::string for copies or std::string_view for views; both see
+// exactly the same line boundaries and crlf handling.
+template <typename Line>
+std::vector<Line> read_lines_with(std::string_view content,
+                                  NewlineScanFn scan) {
+  std::vector<Line> lines;
 
   if (content.empty()) {
     return lines;
@@ -632,36 +687,10 @@ std::vector<std::string> read_lines_with_avx2(std::string_view content) {
   // predicts as 80 chars per line.
   std::vector<std::size_t> newline_positions;
   newline_positions.reserve(content.size() / 80);
+  scan(content.data(), content.size(), 0, &newline_positions);
 
   const char* data = content.data();
   std::size_t size = content.size();
-  std::size_t pos = 0;
-
-  // search line breaks with AVX2 (processes 32 bytes at a time)
-  if (size >= 32) {
-    const __m256i newline_vec = _mm256_set1_epi8('\n');
-
-    for (; pos + 32 <= size; pos += 32) {
-      __m256i chunk =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
-      __m256i cmp = _mm256_cmpeq_epi8(chunk, newline_vec);
-      uint32_t mask = _mm256_movemask_epi8(cmp);
-
-      while (mask) {
-        int offset = __builtin_ctz(mask);
-        newline_positions.push_back(pos + offset);
-        mask &= mask - 1;
-      }
-    }
-  }
-
-  // scalar processing for remaining
-  for (; pos < size; ++pos) {
-    if (data[pos] == '\n') {
-      newline_positions.push_back(pos);
-    }
-  }
-
   lines.reserve(newline_positions.size() + 1);
 
   std::size_t line_start = 0;
@@ -689,38 +718,91 @@ std::vector<std::string> read_lines_with_avx2(std::string_view content) {
   return lines;
 }
 
-std::vector<std::size_t> index_newlines_with_avx2(std::string_view content) {
+std::vector<std::size_t> index_newlines_with(std::string_view content,
+                                             NewlineScanFn scan) {
   std::vector<std::size_t> indexes;
   indexes.reserve(content.size() / 80);
 
-  const char* data = content.data();
-  std::size_t size = content.size();
-  std::size_t pos = 0;
+  scan(content.data(), content.size(), 0, &indexes);
 
-  const __m256i newline_vec = _mm256_set1_epi8('\n');
+  if (indexes.empty() || indexes.back() != content.size() - 1) {
+    indexes.push_back(content.size());
+  }
+
+  return indexes;
+}
 
-  while (pos + 32 <= size) {
-    __m256i chunk =
-        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
-    __m256i cmp = _mm256_cmpeq_epi8(chunk, newline_vec);
-    uint32_t mask = _mm256_movemask_epi8(cmp);
+}  // namespace
 
-    while (mask) {
-      int offset = __builtin_ctz(mask);
-      indexes.push_back(pos + offset);
-      mask &= mask - 1;
-    }
+std::vector<std::string> read_lines_dispatched(std::string_view content) {
+  return read_lines_with<std::string>(content,
+                                      byte_scan_kernels().find_newlines);
+}
+
+std::vector<std::string_view> read_line_views(std::string_view content) {
+  return read_lines_with<std::string_view>(content,
+                                           byte_scan_kernels().find_newlines);
+}
+
+std::vector<std::size_t> index_newlines_dispatched(std::string_view content) {
+  return index_newlines_with(content, byte_scan_kernels().find_newlines);
+}
+
+#if ENABLE_AVX2
+
+std::vector<std::string> read_lines_with_avx2(std::string_view content) {
+  return read_lines_with<std::string>(content, find_newlines_avx2);
+}
+
+std::vector<std::size_t> index_newlines_with_avx2(std::string_view content) {
+  return index_newlines_with(content, find_newlines_avx2);
+}
+
+#endif  // ENABLE_AVX2
+
+std::vector<std::size_t> index_newlines_parallel(std::string_view content,
+                                                 std::size_t thread_count) {
+  constexpr std::size_t kChunkAlignment = 64;
 
-    pos += 32;
+  if (thread_count == 0) {
+    thread_count = default_thread_count();
   }
+  if (thread_count <= 1 || content.size() < thread_count * kChunkAlignment) {
+    return index_newlines<true>(content);
+  }
+
+  std::size_t chunk_size = (content.size() + thread_count - 1) / thread_count;
+  chunk_size = (chunk_size + kChunkAlignment - 1) & ~(kChunkAlignment - 1);
+  const std::size_t chunk_count =
+      (content.size() + chunk_size - 1) / chunk_size;
 
-  // scalar fallback
-  for (; pos < size; ++pos) {
-    if (data[pos] == '\n') {
-      indexes.push_back(pos);
+  std::vector<std::vector<std::size_t>> chunks(chunk_count);
+  parallel_for(chunk_count, thread_count, [&](std::size_t i) {
+    std::string_view chunk = content.substr(i * chunk_size, chunk_size);
+    chunks[i] = index_newlines<true>(chunk);
+    // drop the end-of-content sentinel, it is re-added once for the whole
+    // content below.
+    if (chunks[i].back() == chunk.size()) {
+      chunks[i].pop_back();
     }
+  });
+
+  std::vector<std::size_t> offsets(chunk_count + 1, 0);
+  for (std::size_t i = 0; i < chunk_count; ++i) {
+    offsets[i + 1] = offsets[i] + chunks[i].size();
   }
 
+  std::vector<std::size_t> indexes;
+  indexes.reserve(offsets.back() + 1);
+  indexes.resize(offsets.back());
+  parallel_for(chunk_count, thread_count, [&](std::size_t i) {
+    const std::size_t base = i * chunk_size;
+    std::size_t* out = indexes.data() + offsets[i];
+    for (std::size_t index : chunks[i]) {
+      *out++ = base + index;
+    }
+  });
+
   if (indexes.empty() || indexes.back() != content.size() - 1) {
     indexes.push_back(content.size());
   }
@@ -728,63 +810,179 @@ std::vector<std::size_t> index_newlines_with_avx2(std::string_view content) {
   return indexes;
 }
 
-#endif  // ENABLE_AVX2
+LineIndex build_line_index(std::string_view source) {
+  if (source.size() >= kParallelIndexThreshold) {
+    return LineIndex(index_newlines_parallel(source), source.size());
+  }
+  return LineIndex(index_newlines<true>(source), source.size());
+}
 
-TempFile::TempFile(const std::string& prefix, const std::string& content) {
-  path_ = temp_path(prefix);
-  if (create_file(path_.c_str()) != 0) {
-    glog.error_ref<"failed to create the temp file: {} ({})\n">(
-        path_, std::strerror(errno));
-    glog.flush();
-    valid_ = false;
-    return;
+FileContent::FileContent(std::string&& source)
+    : owned_source_(std::move(source)),
+      source_(owned_source_),
+      line_ends_(build_line_index(source_)) {}
+
+FileContent::FileContent(MappedFile&& mapped)
+    : mapped_(std::move(mapped)),
+      source_(mapped_.view()),
+      line_ends_(build_line_index(source_)) {}
+
+FileContent::FileContent(std::string_view source,
+                         LineIndex&& line_index,
+                         std::shared_ptr<const void> owner)
+    : owner_(std::move(owner)),
+      source_(source),
+      line_ends_(std::move(line_index)) {}
+
+FileContent::FileContent(std::string&& source,
+                         const std::string& path,
+                         const LineIndexCache& cache)
+    : owned_source_(std::move(source)),
+      source_(owned_source_),
+      line_ends_(cache.index(path, source_, &line_ends_owner_)) {}
+
+FileContent::FileContent(MappedFile&& mapped,
+                         const std::string& path,
+                         const LineIndexCache& cache)
+    : mapped_(std::move(mapped)),
+      source_(mapped_.view()),
+      line_ends_(cache.index(path, source_, &line_ends_owner_)) {}
+
+void FileContent::prefetch(std::size_t offset, std::size_t size) const {
+  DCHECK_LE(offset, source_.size());
+  DCHECK_LE(size, source_.size() - offset);
+  if (is_mapped()) {
+    advise_range(source_.data() + offset, size, AccessPattern::kWillNeed);
   }
-  if (!content.empty()) {
-    if (write_file(path_.c_str(), content) != 0) {
-      glog.error_ref<"failed to write to the temp file: {} ({})\n">(
-          path_, std::strerror(errno));
-      glog.flush();
-      valid_ = false;
+}
+
+std::size_t FileContent::memory_usage() const {
+  return sizeof(FileContent) + owned_source_.capacity() +
+         line_ends_.memory_usage();
+}
+
+File::File(std::string&& file_name, std::string&& source)
+    : file_name_(std::move(file_name)),
+      content_(std::make_shared<const FileContent>(std::move(source))) {}
+
+File::File(std::string&& file_name, MappedFile&& mapped)
+    : file_name_(std::move(file_name)),
+      content_(std::make_shared<const FileContent>(std::move(mapped))) {}
+
+File::File(std::string&& file_name, FileSourceMode mode, AccessPattern access)
+    : file_name_(std::move(file_name)) {
+  if (mode == FileSourceMode::kMapped) {
+    MappedFile mapped(file_name_.c_str(), access);
+    if (mapped.valid()) {
+      content_ = std::make_shared<const FileContent>(std::move(mapped));
+      return;
     }
   }
+  content_ = std::make_shared<const FileContent>(
+      read_file(file_name_.c_str(), access));
+}
+
+File::File(std::string&& file_name,
+           FileSourceMode mode,
+           const LineIndexCache& cache,
+           AccessPattern access)
+    : file_name_(std::move(file_name)) {
+  if (mode == FileSourceMode::kMapped) {
+    MappedFile mapped(file_name_.c_str(), access);
+    if (mapped.valid()) {
+      content_ =
+          std::make_shared<const FileContent>(std::move(mapped), file_name_,
+                                              cache);
+      return;
+    }
+  }
+  content_ = std::make_shared<const FileContent>(
+      read_file(file_name_.c_str(), access), file_name_, cache);
 }
 
-TempFile::~TempFile() {
-  if (valid_) {
-    if (remove_file(path_.c_str()) != 0) {
-      glog.error_ref<"failed to remove the temp file: {} ({})\n">(
-          path_, std::strerror(errno));
-      glog.flush();
-    }
+File::File(std::string&& file_name, std::shared_ptr<const FileContent> content)
+    : file_name_(std::move(file_name)), content_(std::move(content)) {
+  DCHECK(content_);
+}
+
+namespace {
+
+std::size_t utf8_column(std::string_view source,
+                        std::size_t line_start,
+                        std::size_t offset) {
+  std::size_t column = 1;
+  for (std::size_t i = line_start; i < offset; ++i) {
+    // count every byte except utf-8 continuation bytes (10xxxxxx).
+    column += (static_cast<unsigned char>(source[i]) & 0xc0) != 0x80;
   }
+  return column;
 }
 
-TempDir::TempDir(const std::string& prefix) {
-  path_ = temp_path(prefix);
-  if (create_directory(path_.c_str()) != 0) {
-    glog.error_ref<"failed to create the temp directory: {} ({})\n">(
-        path_, std::strerror(errno));
-    glog.flush();
-    valid_ = false;
+}  // namespace
+
+void File::prefetch_lines(std::size_t first, std::size_t last) const {
+  DCHECK_GT(first, 0);
+  DCHECK_LE(first, last);
+  DCHECK_LE(last, line_count());
+
+  const LineIndex& line_ends = content_->line_index();
+  const std::size_t begin = first == 1 ? 0 : line_ends[first - 2] + 1;
+  const std::size_t end =
+      std::min(line_ends[last - 1] + 1, content_->source().size());
+  content_->prefetch(begin, end - begin);
+}
+
+LineColumn File::location_of(std::size_t offset) const {
+  const LineIndex& line_ends = content_->line_index();
+  const std::string_view source = content_->source();
+  DCHECK_LE(offset, source.size());
+
+  const std::size_t index = line_ends.lower_bound(offset);
+  if (index == line_ends.size()) {
+    return LineColumn{line_ends.size() + 1, 1};
   }
+  const std::size_t line_start = index == 0 ? 0 : line_ends[index - 1] + 1;
+  return LineColumn{index + 1, utf8_column(source, line_start, offset)};
 }
 
-TempDir::~TempDir() {
-  if (valid_) {
-    if (remove_directory(path_.c_str()) != 0) {
-      glog.error_ref<"failed to remove the temp directory: {} ({})\n">(
-          path_, std::strerror(errno));
-      glog.flush();
+std::vector<LineColumn> File::locations_of(
+    std::span<const std::size_t> offsets) const {
+  // beyond this many lines ahead, a fresh search beats walking the index.
+  constexpr std::size_t kMaxLinearSteps = 8;
+
+  const LineIndex& line_ends = content_->line_index();
+  const std::string_view source = content_->source();
+
+  std::vector<LineColumn> locations;
+  locations.reserve(offsets.size());
+
+  std::size_t index = 0;
+  for (std::size_t offset : offsets) {
+    DCHECK_LE(offset, source.size());
+
+    std::size_t steps = 0;
+    while (index < line_ends.size() && line_ends[index] < offset &&
+           steps < kMaxLinearSteps) {
+      ++index;
+      ++steps;
+    }
+    if (steps == kMaxLinearSteps) {
+      index = line_ends.lower_bound(offset);
+    }
+
+    if (index == line_ends.size()) {
+      locations.push_back(LineColumn{line_ends.size() + 1, 1});
+      continue;
     }
+    const std::size_t line_start = index == 0 ? 0 : line_ends[index - 1] + 1;
+    locations.push_back(
+        LineColumn{index + 1, utf8_column(source, line_start, offset)});
   }
+  return locations;
 }
 
-File::File(std::string&& file_name, std::string&& source)
-    : file_name_(std::move(file_name)),
-      source_(std::move(source)),
-      line_ends_(index_newlines<true>(source_)) {}
-
-File::File(std::string&& file_name)
-    : File(std::move(file_name), read_file(file_name.c_str())) {}
+std::size_t File::memory_usage() const {
+  return sizeof(File) + file_name_.capacity() + content_->memory_usage();
+}
 
 }  // namespace core
@@ -4,28 +4,82 @@
 #include <sys/stat.h>
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "core/base/core_export.h"
+#include "core/base/line_index.h"
+#include "core/base/mapped_file.h"
 #include "core/check.h"
 
-#if ENABLE_AVX2
-#include <immintrin.h>
-#endif  // ENABLE_AVX2
-
 namespace core {
 
+class LineIndexCache;
+
 constexpr const std::size_t kPathMaxLength = 4096;
 constexpr const std::size_t kPredictedFilesNbPerDir = 64;
 using Files = std::vector<std::string>;
 
+struct CompressOptions {
+  // 0 uses `default_thread_count()`; 1 compresses on the calling thread.
+  std::size_t thread_count = 0;
+  // zlib level from 0 (store) to 9 (best); -1 is zlib's default.
+  int level = -1;
+  // uncompressed bytes per block; at least 32 KiB.
+  std::size_t block_size = 128 * 1024;
+};
+
+struct CopyOptions {
+  // copies the source's permission bits instead of using 0644.
+  bool preserve_permissions = false;
+  // replaces an existing destination; otherwise the copy fails.
+  bool overwrite = true;
+  // `copy_tree` workers; 0 uses `default_thread_count()`.
+  std::size_t thread_count = 0;
+};
+
+// how far `write_file_atomic` goes to survive a crash.
+enum class Durability : uint8_t {
+  // no sync: survives a process crash, but not a power loss.
+  kNone = 0,
+  // fdatasync before publishing, so the new name never shows partial data.
+  kData = 1,
+  // fsync the file and then its directory, so the rename itself is durable.
+  kFull = 2,
+};
+
+// where `TempFile`, `TempDir` and `temp_path` put their entries.
+enum class TempStorage : uint8_t {
+  // under `temp_directory()`.
+  kDisk = 0,
+  // under `memory_temp_directory()`. a `TempFile` is an anonymous linux
+  // memfd instead where available.
+  kMemory = 1,
+};
+
 [[nodiscard]] CORE_EXPORT bool file_exists(const char* file_name);
 [[nodiscard]] CORE_EXPORT bool dir_exists(const char* dir_name);
+// `access` is passed on to the kernel as a hint, see `AccessPattern`.
 [[nodiscard]] CORE_EXPORT std::vector<std::byte> read_file_bin(
-    const char* path);
-[[nodiscard]] CORE_EXPORT std::string read_file(const char* path);
-[[nodiscard]] CORE_EXPORT std::u8string read_file_utf8(const char8_t* path);
+    const char* path,
+    AccessPattern access = AccessPattern::kNormal);
+[[nodiscard]] CORE_EXPORT std::string read_file(
+    const char* path,
+    AccessPattern access = AccessPattern::kNormal);
+[[nodiscard]] CORE_EXPORT std::u8string read_file_utf8(
+    const char8_t* path,
+    AccessPattern access = AccessPattern::kNormal);
+// reads many files at once, batching the opens and reads through io_uring
+// where available and a thread pool otherwise. results are in input order;
+// unreadable files yield an empty string, like `read_file`.
+[[nodiscard]] CORE_EXPORT std::vector<std::string> read_files(
+    std::span<const std::string> paths);
 [[nodiscard]] CORE_EXPORT const std::string& exe_path();
 [[nodiscard]] CORE_EXPORT const std::string& exe_dir();
 [[nodiscard]] CORE_EXPORT const std::string& resources_dir();
@@ -33,11 +87,39 @@ using Files = std::vector<std::string>;
 [[nodiscard]] CORE_EXPORT Files list_files(const std::string& path);
 [[nodiscard]] CORE_EXPORT std::string parent_dir(const std::string& path);
 [[nodiscard]] CORE_EXPORT std::string base_name(const std::string& path);
+// the absolute form of `path`, with `.`, `..` and, except on windows,
+// symlinks resolved. empty if it cannot be resolved, e.g. does not exist.
+[[nodiscard]] CORE_EXPORT std::string canonical_path(const std::string& path);
 [[nodiscard]] CORE_EXPORT std::string temp_directory();
-[[nodiscard]] CORE_EXPORT std::string temp_path(const std::string& prefix);
+// the per-user cache directory, with a trailing separator: XDG_CACHE_HOME,
+// then ~/.cache/, or LOCALAPPDATA on windows. falls back to
+// `temp_directory()` when none is set.
+[[nodiscard]] CORE_EXPORT std::string cache_directory();
+// a writable tmpfs directory, with a trailing separator: `temp_directory()`
+// if it is on tmpfs, then /dev/shm, then XDG_RUNTIME_DIR. falls back to
+// `temp_directory()` when none is, and always on windows.
+[[nodiscard]] CORE_EXPORT const std::string& memory_temp_directory();
+[[nodiscard]] CORE_EXPORT std::string temp_path(
+    const std::string& prefix,
+    TempStorage storage = TempStorage::kDisk);
+// gzip compression in the style of pigz: the input is cut into blocks that
+// are deflated concurrently (each primed with the previous 32 KiB as its
+// dictionary) and joined into a single gzip member whose crc is combined
+// with `crc32_combine`. the output is readable by any gzip implementation.
 CORE_EXPORT bool compress(const char* src_path,
                           const char* dest_path,
-                          bool remove_after_compress = true);
+                          bool remove_after_compress = true,
+                          const CompressOptions& options = {});
+// gzip compresses `input` into `output` in memory, in parallel like
+// `compress`. returns 0 on success and -1, leaving `output` empty, if zlib
+// rejects the options.
+CORE_EXPORT int compress_buffer(std::span<const std::byte> input,
+                                std::vector<std::byte>* output,
+                                const CompressOptions& options = {});
+// inflates gzip (including concatenated members) or zlib data into `output`.
+// returns false, leaving `output` empty, for corrupt or truncated input.
+CORE_EXPORT bool decompress_buffer(std::span<const std::byte> input,
+                                   std::vector<std::byte>* output);
 
 CORE_EXPORT int create_directory(const char* path);
 CORE_EXPORT int create_directories(const char* path);
@@ -45,10 +127,38 @@ CORE_EXPORT int create_file(const char* path);
 CORE_EXPORT int remove_file(const char* path);
 CORE_EXPORT int remove_directory(const char* path);
 CORE_EXPORT int rename_file(const char* old_path, const char* new_path);
+// copies a file without moving the data through user space where possible:
+// copy_file_range (which reflinks on file systems that support it), then
+// sendfile, then a read / write loop. returns 0 on success and -1 on error.
+CORE_EXPORT int copy_file(const char* src_path,
+                          const char* dst_path,
+                          const CopyOptions& options = {});
+// copies a directory tree, hidden entries included, with `copy_file` on a
+// pool of threads. symlinks and fifos are recreated, not followed or read;
+// sockets and device nodes are skipped. a directory that cannot be read
+// fails the copy.
+CORE_EXPORT int copy_tree(const std::string& src_dir,
+                          const std::string& dst_dir,
+                          const CopyOptions& options = {});
+// removes a directory and everything below it, hidden entries included.
+// symlinks are removed, not followed. returns 0 on success and -1 if
+// anything was left behind.
+CORE_EXPORT int remove_tree(const std::string& dir);
 CORE_EXPORT int write_file(const char* path, const std::string& content);
 CORE_EXPORT int write_binary_to_file(const void* binary_data,
                                      std::size_t binary_size,
                                      const std::string& output_path);
+// replaces `path` with the concatenation of `buffers` such that readers see
+// either the old or the new content, never a torn file. the data goes to an
+// unnamed O_TMPFILE (or a sibling temp file) with gathered writes and is then
+// linked or renamed into place. an existing file keeps its permission bits,
+// except on windows. returns 0 on success and -1 on error.
+CORE_EXPORT int write_file_atomic(const char* path,
+                                  std::span<const std::string_view> buffers,
+                                  Durability durability = Durability::kData);
+CORE_EXPORT int write_file_atomic(const char* path,
+                                  std::string_view content,
+                                  Durability durability = Durability::kData);
 
 [[nodiscard]] CORE_EXPORT std::string file_extension(const std::string& path);
 [[nodiscard]] CORE_EXPORT std::string file_name_without_extension(
@@ -101,6 +211,11 @@ template <typename... Parts>
 [[nodiscard]] CORE_EXPORT std::vector<std::string> read_lines_default(
     std::string_view content);
 
+// scans with the fastest kernel the running cpu supports (sse2 / avx2 /
+// avx-512bw, see `cpu_features()`), independent of the build flags.
+[[nodiscard]] CORE_EXPORT std::vector<std::string> read_lines_dispatched(
+    std::string_view content);
+
 #if ENABLE_AVX2
 [[nodiscard]] CORE_EXPORT std::vector<std::string> read_lines_with_avx2(
     std::string_view content);
@@ -109,17 +224,100 @@ template <typename... Parts>
 template <bool use_avx2_if_available = true>
 [[nodiscard]] inline std::vector<std::string> read_lines(
     std::string_view content) {
-#if ENABLE_AVX2
   if constexpr (use_avx2_if_available) {
-    return read_lines_with_avx2(content);
+    return read_lines_dispatched(content);
   }
-#endif
   return read_lines_default(content);
 }
 
+// same lines as `read_lines`, but as views into `content` instead of copies,
+// so only the result vector itself is allocated.
+[[nodiscard]] CORE_EXPORT std::vector<std::string_view> read_line_views(
+    std::string_view content);
+
+// lazily splits `content` into the same lines as `read_lines` without
+// allocating. the views point into `content`, which must outlive the range.
+class LineViewRange {
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    Iterator() = default;
+
+    inline reference operator*() const { return line_; }
+    inline pointer operator->() const { return &line_; }
+
+    inline Iterator& operator++() {
+      current_ = next_;
+      load();
+      return *this;
+    }
+
+    inline Iterator operator++(int) {
+      Iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    inline bool operator==(const Iterator& other) const {
+      return current_ == other.current_;
+    }
+
+   private:
+    friend class LineViewRange;
+
+    inline Iterator(const char* current, const char* end)
+        : current_(current), end_(end) {
+      load();
+    }
+
+    inline void load() {
+      if (current_ == end_) {
+        return;
+      }
+      const char* newline = static_cast<const char*>(
+          std::memchr(current_, '\n', end_ - current_));
+      const char* line_end = newline ? newline : end_;
+      next_ = newline ? newline + 1 : end_;
+
+      // crlf
+      if (line_end > current_ && line_end[-1] == '\r') {
+        --line_end;
+      }
+      line_ = std::string_view(current_, line_end - current_);
+    }
+
+    const char* current_ = nullptr;
+    const char* next_ = nullptr;
+    const char* end_ = nullptr;
+    std::string_view line_;
+  };
+
+  explicit LineViewRange(std::string_view content) : content_(content) {}
+
+  inline Iterator begin() const {
+    return Iterator(content_.data(), content_.data() + content_.size());
+  }
+  inline Iterator end() const {
+    const char* content_end = content_.data() + content_.size();
+    return Iterator(content_end, content_end);
+  }
+
+ private:
+  std::string_view content_;
+};
+
 [[nodiscard]] CORE_EXPORT std::vector<std::size_t> index_newlines_default(
     std::string_view content);
 
+[[nodiscard]] CORE_EXPORT std::vector<std::size_t> index_newlines_dispatched(
+    std::string_view content);
+
 #if ENABLE_AVX2
 [[nodiscard]] CORE_EXPORT std::vector<std::size_t> index_newlines_with_avx2(
     std::string_view content);
@@ -128,81 +326,219 @@ template <bool use_avx2_if_available = true>
 template <bool use_avx2_if_available = true>
 [[nodiscard]] inline std::vector<std::size_t> index_newlines(
     std::string_view content) {
-#if ENABLE_AVX2
   if constexpr (use_avx2_if_available) {
-    return index_newlines_with_avx2(content);
+    return index_newlines_dispatched(content);
   }
-#endif
   return index_newlines_default(content);
 }
 
+// sources at least this large are indexed with `index_newlines_parallel`.
+constexpr const std::size_t kParallelIndexThreshold = 32 * 1024 * 1024;
+
+// same result as `index_newlines`, computed by splitting `content` into one
+// chunk per thread. `thread_count` of 0 uses every hardware thread.
+[[nodiscard]] CORE_EXPORT std::vector<std::size_t> index_newlines_parallel(
+    std::string_view content,
+    std::size_t thread_count = 0);
+
+// the line index of `source`, scanned in parallel from
+// `kParallelIndexThreshold` bytes on.
+[[nodiscard]] CORE_EXPORT LineIndex build_line_index(std::string_view source);
+
+// a temporary file holding `content`, removed on destruction. with
+// `TempStorage::kMemory` on linux it is a memfd whose path,
+// /proc/self/fd/<n>, can be opened, mapped and rewritten by this process
+// only, and not renamed or removed.
 class CORE_EXPORT TempFile {
  public:
   explicit TempFile(const std::string& prefix = "tmp_",
-                    const std::string& content = "");
+                    const std::string& content = "",
+                    TempStorage storage = TempStorage::kDisk);
 
   ~TempFile();
 
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+
   inline constexpr const std::string& path() const { return path_; }
   inline constexpr bool valid() const { return valid_; }
 
  private:
   std::string path_;
+  // the memfd behind `path_`, or -1 for a file on disk.
+  int fd_ = -1;
   bool valid_ : 1 = true;
 };
 
+// a temporary directory, removed on destruction. it must be empty by then
+// unless `remove_contents` is set, which removes everything left in it
+// with `remove_tree`.
 class CORE_EXPORT TempDir {
  public:
-  explicit TempDir(const std::string& prefix = "tmp_dir_");
+  explicit TempDir(const std::string& prefix = "tmp_dir_",
+                   TempStorage storage = TempStorage::kDisk,
+                   bool remove_contents = false);
 
   ~TempDir();
 
+  TempDir(const TempDir&) = delete;
+  TempDir& operator=(const TempDir&) = delete;
+
   inline constexpr const std::string& path() const { return path_; }
   inline constexpr bool valid() const { return valid_; }
 
  private:
   std::string path_;
   bool valid_ : 1 = true;
+  bool remove_contents_ : 1 = false;
+};
+
+enum class FileSourceMode : uint8_t {
+  // reads the whole file into a heap buffer owned by the `File`.
+  kCopy = 0,
+  // maps regular files read-only and serves the source straight from the
+  // mapping. pipes and other non-regular files fall back to `kCopy`.
+  kMapped = 1,
+};
+
+// 1 indexed; the column counts utf-8 code points, not bytes.
+struct LineColumn {
+  std::size_t line = 0;
+  std::size_t column = 0;
+
+  bool operator==(const LineColumn&) const = default;
+};
+
+// the bytes of a file and their line index. immutable once built, so one
+// instance can back every `File` with the same content.
+class CORE_EXPORT FileContent {
+ public:
+  explicit FileContent(std::string&& source);
+  explicit FileContent(MappedFile&& mapped);
+  // borrows a source and index that live in memory kept alive by `owner`,
+  // such as a mapped snapshot.
+  FileContent(std::string_view source,
+              LineIndex&& line_index,
+              std::shared_ptr<const void> owner);
+  // take the line index of the file at `path` from `cache`.
+  FileContent(std::string&& source,
+              const std::string& path,
+              const LineIndexCache& cache);
+  FileContent(MappedFile&& mapped,
+              const std::string& path,
+              const LineIndexCache& cache);
+
+  ~FileContent() = default;
+
+  FileContent(const FileContent&) = delete;
+  FileContent& operator=(const FileContent&) = delete;
+
+  FileContent(FileContent&&) = delete;
+  FileContent& operator=(FileContent&&) = delete;
+
+  inline std::string_view source() const { return source_; }
+  // the source is backed by a file mapping rather than the heap.
+  inline bool is_mapped() const { return mapped_.valid() || owner_; }
+  inline const LineIndex& line_index() const { return line_ends_; }
+
+  // starts reading the bytes [offset, offset + size) of a mapped source in
+  // the background. a no-op for sources on the heap.
+  void prefetch(std::size_t offset, std::size_t size) const;
+
+  // heap bytes held by the owned source and the line index. a mapped source
+  // is backed by the page cache and not counted.
+  [[nodiscard]] std::size_t memory_usage() const;
+
+ private:
+  // backing storage; `source_` views into exactly one of them.
+  std::string owned_source_;
+  MappedFile mapped_;
+  std::shared_ptr<const void> owner_;
+  std::string_view source_;
+  // keeps a line index borrowed from a sidecar alive.
+  std::shared_ptr<const void> line_ends_owner_;
+  LineIndex line_ends_;
 };
 
 class CORE_EXPORT File {
  public:
   File(std::string&& file_name, std::string&& source);
-  explicit File(std::string&& file_name);
+  File(std::string&& file_name, MappedFile&& mapped);
+  // `access` is passed on to the read or the mapping, see `AccessPattern`.
+  explicit File(std::string&& file_name,
+                FileSourceMode mode = FileSourceMode::kCopy,
+                AccessPattern access = AccessPattern::kNormal);
+  // reuses the line index persisted by `cache` if the file has not changed.
+  File(std::string&& file_name,
+       FileSourceMode mode,
+       const LineIndexCache& cache,
+       AccessPattern access = AccessPattern::kNormal);
+  // shares the content of another file.
+  File(std::string&& file_name, std::shared_ptr<const FileContent> content);
 
   ~File() = default;
 
   File(const File&) = delete;
   File& operator=(const File&) = delete;
 
-  File(File&&) noexcept = default;
-  File& operator=(File&&) noexcept = default;
+  // the content lives on the heap, so views into it survive moves.
+  File(File&& other) noexcept = default;
+  File& operator=(File&& other) noexcept = default;
 
   inline const std::string& file_name() const { return file_name_; }
-  inline const std::string& source() const { return source_; }
+  inline std::string_view source() const { return content_->source(); }
+  inline bool is_mapped() const { return content_->is_mapped(); }
+  inline const std::shared_ptr<const FileContent>& content() const {
+    return content_;
+  }
 
   // 1 indexed
   inline std::string_view line(std::size_t line_no) const {
     DCHECK_GT(line_no, 0);
     DCHECK_LE(line_no, line_count());
 
-    std::size_t line_start = (line_no == 1) ? 0 : line_ends_[line_no - 2] + 1;
-    std::size_t line_end = line_ends_[line_no - 1];
+    const LineIndex& line_ends = content_->line_index();
+    const std::string_view source = content_->source();
+    std::size_t line_start = (line_no == 1) ? 0 : line_ends[line_no - 2] + 1;
+    std::size_t line_end = line_ends[line_no - 1];
 
     // crlf
-    if (line_end > line_start && source_[line_end - 1] == '\r') {
+    if (line_end > line_start && source[line_end - 1] == '\r') {
       --line_end;
     }
 
-    return std::string_view(&source_[line_start], line_end - line_start);
+    return std::string_view(source.data() + line_start,
+                            line_end - line_start);
+  }
+
+  inline std::size_t line_count() const {
+    return content_->line_index().size();
+  }
+  inline const LineIndex& line_index() const {
+    return content_->line_index();
   }
 
-  inline std::size_t line_count() const { return line_ends_.size(); }
+  // starts reading the lines [first, last] (1 indexed) of a mapped source in
+  // the background, to warm them up ahead of a scan.
+  void prefetch_lines(std::size_t first, std::size_t last) const;
+
+  // line and column of the byte at `offset`, 0 <= offset <= source size. the
+  // end of a source that ends in a newline maps to column 1 of the line after
+  // the last one.
+  [[nodiscard]] LineColumn location_of(std::size_t offset) const;
+
+  // `location_of` for offsets sorted in ascending order, resolved in a single
+  // forward pass over the line index.
+  [[nodiscard]] std::vector<LineColumn> locations_of(
+      std::span<const std::size_t> offsets) const;
+
+  // heap bytes held by this file: name, owned source and line index. shared
+  // content is counted in full by every file that holds it.
+  [[nodiscard]] std::size_t memory_usage() const;
 
  private:
   std::string file_name_;
-  std::string source_;
-  std::vector<std::size_t> line_ends_;
+  std::shared_ptr<const FileContent> content_;
 };
 
 }  // namespace core
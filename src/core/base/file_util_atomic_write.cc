@@ -0,0 +1,332 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "build/build_flag.h"
+#include "core/base/file_stat.h"
+#include "core/base/file_util.h"
+#include "core/base/logger.h"
+
+#if IS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#undef APIENTRY
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+
+#if IS_WINDOWS
+using ProcessId = DWORD;
+#else
+using ProcessId = pid_t;
+#endif
+
+ProcessId current_process_id() {
+#if IS_WINDOWS
+  return GetCurrentProcessId();
+#else
+  return getpid();
+#endif
+}
+
+// a name next to `path` (same directory, hence same file system) that no
+// other writer in this or another process picks at the same time.
+std::string sibling_temp_path(const char* path) {
+  static std::atomic<uint64_t> counter{0};
+  return std::string(path) + ".tmp." + std::to_string(current_process_id()) +
+         "." + std::to_string(counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+void close_fd(int fd) {
+#if IS_WINDOWS
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+void log_failure(const char* what, const char* path) {
+  glog.error_ref<"failed to {} {} ({})\n">(what, path, std::strerror(errno));
+  glog.flush();
+}
+
+// writes every buffer in order, batching them into as few syscalls as the
+// platform allows and resuming after short writes.
+bool write_buffers(int fd, std::span<const std::string_view> buffers) {
+#if IS_WINDOWS
+  for (std::string_view buffer : buffers) {
+    std::size_t total_written = 0;
+    while (total_written < buffer.size()) {
+      int bytes = _write(fd, buffer.data() + total_written,
+                         static_cast<unsigned int>(std::min<std::size_t>(
+                             buffer.size() - total_written, INT_MAX)));
+      if (bytes <= 0) {
+        return false;
+      }
+      total_written += static_cast<std::size_t>(bytes);
+    }
+  }
+  return true;
+#else
+  constexpr std::size_t kMaxIovecs = IOV_MAX < 1024 ? IOV_MAX : 1024;
+  struct iovec iovecs[kMaxIovecs];
+
+  std::size_t next = 0;
+  // bytes of `buffers[next]` already written.
+  std::size_t skip = 0;
+  while (next < buffers.size()) {
+    std::size_t count = 0;
+    for (std::size_t i = next; i < buffers.size() && count < kMaxIovecs; ++i) {
+      const std::size_t offset = i == next ? skip : 0;
+      iovecs[count].iov_base = const_cast<char*>(buffers[i].data() + offset);
+      iovecs[count].iov_len = buffers[i].size() - offset;
+      ++count;
+    }
+
+    ssize_t bytes = writev(fd, iovecs, static_cast<int>(count));
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0) {
+      return false;
+    }
+
+    // advance past what the kernel took, which may end mid-buffer.
+    std::size_t written = static_cast<std::size_t>(bytes);
+    while (next < buffers.size() && written >= buffers[next].size() - skip) {
+      written -= buffers[next].size() - skip;
+      skip = 0;
+      ++next;
+    }
+    skip += written;
+  }
+  return true;
+#endif
+}
+
+bool sync_fd(int fd, Durability durability) {
+  if (durability == Durability::kNone) {
+    return true;
+  }
+#if IS_WINDOWS
+  return _commit(fd) == 0;
+#elif IS_LINUX
+  return (durability == Durability::kData ? fdatasync(fd) : fsync(fd)) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
+
+#if !IS_WINDOWS
+
+std::string directory_of(const char* path) {
+  std::string directory = parent_dir(path);
+  return directory.empty() ? std::string(".") : directory;
+}
+
+// makes a rename or link in `directory` durable.
+bool sync_directory(const std::string& directory) {
+  const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const bool ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+#endif  // !IS_WINDOWS
+
+#if IS_LINUX
+
+// publishes the unnamed O_TMPFILE `fd` as `path`. linkat cannot replace an
+// existing file, so an existing target goes through a linked temp name and a
+// rename instead.
+bool link_tmpfile(int fd, const char* path) {
+  const std::string proc_path = "/proc/self/fd/" + std::to_string(fd);
+  if (linkat(AT_FDCWD, proc_path.c_str(), AT_FDCWD, path,
+             AT_SYMLINK_FOLLOW) == 0) {
+    return true;
+  }
+  if (errno != EEXIST) {
+    return false;
+  }
+
+  const std::string temp = sibling_temp_path(path);
+  if (linkat(AT_FDCWD, proc_path.c_str(), AT_FDCWD, temp.c_str(),
+             AT_SYMLINK_FOLLOW) != 0) {
+    return false;
+  }
+  if (rename(temp.c_str(), path) != 0) {
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// the fast path: an unnamed file that disappears by itself if we crash.
+// returns 1 on success, 0 if O_TMPFILE is unsupported here and -1 on error.
+int write_with_tmpfile(const char* path,
+                       std::span<const std::string_view> buffers,
+                       Durability durability,
+                       int mode) {
+  const std::string directory = directory_of(path);
+  const int fd =
+      open(directory.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    // older kernels and some file systems (nfs, overlay setups) lack it.
+    if (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL) {
+      return 0;
+    }
+    log_failure("create a temp file for", path);
+    return -1;
+  }
+  if (mode >= 0 && fchmod(fd, static_cast<mode_t>(mode)) != 0) {
+    log_failure("set the permissions of", path);
+    close(fd);
+    return -1;
+  }
+
+  if (!write_buffers(fd, buffers)) {
+    log_failure("write to", path);
+    close(fd);
+    return -1;
+  }
+  if (!sync_fd(fd, durability)) {
+    log_failure("sync", path);
+    close(fd);
+    return -1;
+  }
+  const bool linked = link_tmpfile(fd, path);
+  const int link_error = errno;
+  close(fd);
+  if (!linked) {
+    // without /proc the file cannot be named; take the slow path.
+    if (link_error == ENOENT) {
+      return 0;
+    }
+    errno = link_error;
+    log_failure("link", path);
+    return -1;
+  }
+
+  if (durability == Durability::kFull && !sync_directory(directory)) {
+    log_failure("sync the directory of", path);
+    return -1;
+  }
+  return 1;
+}
+
+#endif  // IS_LINUX
+
+int write_with_temp_file(const char* path,
+                         std::span<const std::string_view> buffers,
+                         Durability durability,
+                         int mode) {
+  const std::string temp = sibling_temp_path(path);
+#if IS_WINDOWS
+  const int fd =
+      _open(temp.c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+            _S_IREAD | _S_IWRITE);
+#else
+  const int fd =
+      open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+#endif
+  if (fd < 0) {
+    log_failure("create", temp.c_str());
+    return -1;
+  }
+#if IS_WINDOWS
+  (void)mode;
+#else
+  if (mode >= 0 && fchmod(fd, static_cast<mode_t>(mode)) != 0) {
+    log_failure("set the permissions of", temp.c_str());
+    close_fd(fd);
+    remove_file(temp.c_str());
+    return -1;
+  }
+#endif
+
+  bool ok = write_buffers(fd, buffers);
+  if (!ok) {
+    log_failure("write to", temp.c_str());
+  } else if (!(ok = sync_fd(fd, durability))) {
+    log_failure("sync", temp.c_str());
+  }
+  close_fd(fd);
+
+  if (ok) {
+#if IS_WINDOWS
+    const DWORD flags = MOVEFILE_REPLACE_EXISTING |
+                        (durability == Durability::kFull
+                             ? MOVEFILE_WRITE_THROUGH
+                             : 0);
+    ok = MoveFileExA(temp.c_str(), path, flags) != 0;
+#else
+    ok = rename(temp.c_str(), path) == 0;
+#endif
+    if (!ok) {
+      log_failure("rename into", path);
+    }
+  }
+  if (!ok) {
+    remove_file(temp.c_str());
+    return -1;
+  }
+
+#if !IS_WINDOWS
+  if (durability == Durability::kFull &&
+      !sync_directory(directory_of(path))) {
+    log_failure("sync the directory of", path);
+    return -1;
+  }
+#endif
+  return 0;
+}
+
+}  // namespace
+
+int write_file_atomic(const char* path,
+                      std::span<const std::string_view> buffers,
+                      Durability durability) {
+  // a replaced file keeps its permission bits; a new one gets 0644, less
+  // the umask.
+  int mode = -1;
+#if !IS_WINDOWS
+  const FileStat existing = stat_path(path);
+  if (existing.is_regular()) {
+    mode = static_cast<int>(existing.mode);
+  }
+#endif
+#if IS_LINUX
+  const int result = write_with_tmpfile(path, buffers, durability, mode);
+  if (result != 0) {
+    return result > 0 ? 0 : -1;
+  }
+#endif
+  return write_with_temp_file(path, buffers, durability, mode);
+}
+
+int write_file_atomic(const char* path,
+                      std::string_view content,
+                      Durability durability) {
+  return write_file_atomic(path, std::span<const std::string_view>(&content, 1),
+                           durability);
+}
+
+}  // namespace core
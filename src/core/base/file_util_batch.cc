@@ -0,0 +1,271 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/file_util.h"
+#include "core/base/io_uring.h"
+#include "core/base/parallel.h"
+
+#if !IS_WINDOWS
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+
+#if IS_LINUX && defined(STATX_TYPE)
+
+constexpr unsigned int kRingEntries = 256;
+constexpr std::size_t kMinFilesForRing = 16;
+constexpr std::size_t kMaxSingleRead = std::size_t{1} << 30;
+
+// finishes a short read synchronously.
+bool read_remaining(int fd, std::string* content, std::size_t offset) {
+  while (offset < content->size()) {
+    ssize_t bytes =
+        pread(fd, content->data() + offset, content->size() - offset,
+              static_cast<off_t>(offset));
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      content->resize(offset);
+      return bytes == 0;
+    }
+    offset += static_cast<std::size_t>(bytes);
+  }
+  return true;
+}
+
+// the steps of one file, tagged in the low bits of its user data.
+enum Step : uint64_t {
+  kOpen = 0,
+  kStat = 1,
+  kRead = 2,
+  kClose = 3,
+};
+constexpr uint64_t kStepBits = 2;
+
+Step step_of(uint64_t user_data) {
+  return static_cast<Step>(user_data & ((uint64_t{1} << kStepBits) - 1));
+}
+
+// a file in flight. the open and the statx of its path run side by side;
+// once both are in, the read follows, then the close.
+struct RingFile {
+  std::size_t index = 0;
+  int fd = -1;
+  int stat_result = 0;
+  uint8_t pending_lookups = 0;
+  struct statx stx;
+};
+
+// reads `paths` through a ring kept full across files: as soon as one file
+// is closed, the next one is opened, so the opens, lookups and reads of
+// different files overlap. entries that the ring cannot serve (non-regular
+// files, unsupported opcodes, errors) are appended to `fallback` so that
+// `read_file` can handle and report them. returns false if no ring could be
+// set up; nothing has been read then.
+bool read_files_with_io_uring(std::span<const std::string> paths,
+                              std::vector<std::string>* contents,
+                              std::vector<std::size_t>* fallback) {
+  IoUring ring(kRingEntries);
+  if (!ring.valid()) {
+    return false;
+  }
+
+  // each file has at most two operations queued at a time.
+  std::vector<RingFile> files(ring.capacity() / 2);
+  std::vector<std::size_t> free_slots;
+  free_slots.reserve(files.size());
+  for (std::size_t slot = files.size(); slot-- > 0;) {
+    free_slots.push_back(slot);
+  }
+
+  auto tag = [](std::size_t slot, Step step) {
+    return (static_cast<uint64_t>(slot) << kStepBits) | step;
+  };
+  auto close_file = [&](std::size_t slot) {
+    ring.prepare_close(files[slot].fd, tag(slot, kClose));
+  };
+  auto give_up = [&](std::size_t slot) {
+    (*contents)[files[slot].index].clear();
+    fallback->push_back(files[slot].index);
+    if (files[slot].fd >= 0) {
+      close_file(slot);
+    } else {
+      free_slots.push_back(slot);
+    }
+  };
+  // both the open and the lookup are in.
+  auto start_read = [&](std::size_t slot) {
+    RingFile& file = files[slot];
+    uint64_t size = 0;
+    uint32_t mode = 0;
+    if (file.stat_result == 0) {
+      size = file.stx.stx_size;
+      mode = file.stx.stx_mode;
+    } else if (file.fd >= 0) {
+      // -EINVAL: an io_uring without statx, before linux 5.6.
+      struct stat st;
+      if (fstat(file.fd, &st) == 0) {
+        size = static_cast<uint64_t>(st.st_size);
+        mode = st.st_mode;
+      }
+    }
+    if (file.fd < 0 || !S_ISREG(mode) || size == 0) {
+      give_up(slot);
+      return;
+    }
+    std::string& content = (*contents)[file.index];
+    content.resize(static_cast<std::size_t>(size));
+    ring.prepare_read(
+        file.fd, content.data(),
+        static_cast<uint32_t>(std::min(content.size(), kMaxSingleRead)), 0,
+        tag(slot, kRead));
+  };
+  auto on_completion = [&](const IoCompletion& c) {
+    const std::size_t slot = c.user_data >> kStepBits;
+    RingFile& file = files[slot];
+    switch (step_of(c.user_data)) {
+      case kOpen:
+        file.fd = c.result;
+        if (--file.pending_lookups == 0) {
+          start_read(slot);
+        }
+        break;
+      case kStat:
+        file.stat_result = c.result;
+        if (--file.pending_lookups == 0) {
+          start_read(slot);
+        }
+        break;
+      case kRead: {
+        std::string& content = (*contents)[file.index];
+        if (c.result < 0 ||
+            !read_remaining(file.fd, &content,
+                            static_cast<std::size_t>(c.result))) {
+          content.clear();
+          fallback->push_back(file.index);
+        }
+        close_file(slot);
+        break;
+      }
+      case kClose:
+        if (c.result < 0) {
+          // IORING_OP_CLOSE is unavailable before linux 5.6.
+          close(file.fd);
+        }
+        file.fd = -1;
+        free_slots.push_back(slot);
+        break;
+    }
+  };
+
+  IoCompletion completions[kReapBatch];
+  std::size_t next = 0;
+  while (next < paths.size() || free_slots.size() < files.size()) {
+    while (next < paths.size() && !free_slots.empty()) {
+      const std::size_t slot = free_slots.back();
+      free_slots.pop_back();
+      RingFile& file = files[slot];
+      file.index = next;
+      file.fd = -1;
+      file.pending_lookups = 2;
+      ring.prepare_openat(paths[next].c_str(), O_RDONLY | O_CLOEXEC,
+                          tag(slot, kOpen));
+      ring.prepare_statx(paths[next].c_str(), AT_STATX_SYNC_AS_STAT,
+                         STATX_TYPE | STATX_SIZE, &file.stx,
+                         tag(slot, kStat));
+      ++next;
+    }
+    if (ring.submit(1) < 0) {
+      // reads still in flight write into `contents`, and opens still in
+      // flight return descriptors to close.
+      drain_all(&ring, [&](const IoCompletion& c) {
+        RingFile& file = files[c.user_data >> kStepBits];
+        const Step step = step_of(c.user_data);
+        if (step == kOpen) {
+          file.fd = c.result;
+        } else if (step == kClose && c.result >= 0) {
+          file.fd = -1;
+        }
+      });
+      // every file not yet done goes to the fallback, including the ones
+      // that were already sent there.
+      std::vector<bool> unfinished(paths.size(), false);
+      for (std::size_t i = next; i < paths.size(); ++i) {
+        unfinished[i] = true;
+      }
+      std::vector<bool> idle(files.size(), false);
+      for (std::size_t slot : free_slots) {
+        idle[slot] = true;
+      }
+      for (std::size_t slot = 0; slot < files.size(); ++slot) {
+        if (!idle[slot]) {
+          unfinished[files[slot].index] = true;
+          if (files[slot].fd >= 0) {
+            close(files[slot].fd);
+          }
+        }
+      }
+      std::erase_if(*fallback,
+                    [&unfinished](std::size_t i) { return unfinished[i]; });
+      for (std::size_t i = 0; i < paths.size(); ++i) {
+        if (unfinished[i]) {
+          (*contents)[i].clear();
+          fallback->push_back(i);
+        }
+      }
+      return true;
+    }
+    for (std::size_t reaped = ring.reap(completions, kReapBatch); reaped > 0;
+         reaped = ring.reap(completions, kReapBatch)) {
+      for (std::size_t i = 0; i < reaped; ++i) {
+        on_completion(completions[i]);
+      }
+    }
+  }
+  return true;
+}
+
+#endif  // IS_LINUX && defined(STATX_TYPE)
+
+}  // namespace
+
+std::vector<std::string> read_files(std::span<const std::string> paths) {
+  std::vector<std::string> contents(paths.size());
+  std::vector<std::size_t> fallback;
+
+#if IS_LINUX && defined(STATX_TYPE)
+  bool used_ring = paths.size() >= kMinFilesForRing &&
+                   read_files_with_io_uring(paths, &contents, &fallback);
+#else
+  bool used_ring = false;
+#endif
+
+  if (!used_ring) {
+    fallback.resize(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      fallback[i] = i;
+    }
+  }
+
+  ThreadPool::shared().parallel_for(
+      fallback.size(), default_thread_count(), [&](std::size_t i) {
+        const std::size_t index = fallback[i];
+        contents[index] = read_file(paths[index].c_str());
+      });
+  return contents;
+}
+
+}  // namespace core
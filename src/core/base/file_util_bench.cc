@@ -1,9 +1,24 @@
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <optional>
 #include <random>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "benchmark/benchmark.h"
+#include "core/base/async_file_writer.h"
+#include "core/base/dir_walker.h"
+#include "core/base/file_manager.h"
+#include "core/base/file_stat.h"
 #include "core/base/file_util.h"
+#include "core/base/hash.h"
+#include "core/base/line_index_cache.h"
+#include "core/base/line_reader.h"
+#include "core/base/parallel.h"
+#include "core/base/path_resolver.h"
 
 namespace core {
 
@@ -77,6 +92,48 @@ void file_util_list_files(benchmark::State& state) {
 }
 BENCHMARK(file_util_list_files);
 
+void file_util_walk_directory(benchmark::State& state) {
+  constexpr int kDirs = 50;
+  constexpr int kFilesPerDir = 200;
+  with_temp_dir([&](const std::string& dir) {
+    for (int d = 0; d < kDirs; ++d) {
+      const std::string sub = join_path(dir, "dir" + std::to_string(d));
+      create_directory(sub.c_str());
+      for (int i = 0; i < kFilesPerDir; ++i) {
+        const std::string path = join_path(sub, "f" + std::to_string(i));
+        create_file(path.c_str());
+      }
+    }
+
+    WalkOptions options;
+    options.thread_count = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(walk_directory(dir, options));
+    }
+    state.SetItemsProcessed(state.iterations() * kDirs * kFilesPerDir);
+
+    options.include_directories = true;
+    WalkResult result = walk_directory(dir, options);
+    // files first; the directories are empty afterwards.
+    for (bool directories : {false, true}) {
+      for (std::size_t i = 0; i < result.size(); ++i) {
+        if ((result.type(i) == EntryType::kDirectory) != directories) {
+          continue;
+        }
+        const std::string path = join_path(dir, std::string(result.path(i)));
+        if (directories) {
+          remove_directory(path.c_str());
+        } else {
+          remove_file(path.c_str());
+        }
+      }
+    }
+  });
+}
+BENCHMARK(file_util_walk_directory)
+    ->DenseRange(1, static_cast<int64_t>(default_thread_count()))
+    ->Unit(benchmark::kMillisecond);
+
 void file_util_write_binary_to_file(benchmark::State& state) {
   with_temp_file("", [&](const std::string& path) {
     std::vector<char> data(4096, 'A');
@@ -150,6 +207,26 @@ std::string generate_large_content(std::size_t num_lines,
   return content;
 }
 
+// heap blocks held by the lines a call returns: the vector buffer plus every
+// string too long for its inline buffer. read off the result, so that no
+// global allocation hook is needed.
+template <typename Line>
+void set_heap_blocks(benchmark::State& state,
+                     const std::vector<Line>& lines) {
+  std::size_t blocks = lines.capacity() > 0 ? 1 : 0;
+  if constexpr (std::is_same_v<Line, std::string>) {
+    const std::less<const char*> before;
+    for (const std::string& line : lines) {
+      const auto* object = reinterpret_cast<const char*>(&line);
+      if (before(line.data(), object) ||
+          !before(line.data(), object + sizeof(line))) {
+        ++blocks;
+      }
+    }
+  }
+  state.counters["heap_blocks"] = static_cast<double>(blocks);
+}
+
 template <bool use_avx>
 void file_util_read_lines_internal(benchmark::State& state) {
   const std::size_t num_lines = 1000;
@@ -161,6 +238,7 @@ void file_util_read_lines_internal(benchmark::State& state) {
     std::vector<std::string> lines = read_lines<use_avx>(large_content);
     benchmark::DoNotOptimize(lines);
   }
+  set_heap_blocks(state, read_lines<use_avx>(large_content));
   state.SetBytesProcessed(state.iterations() * large_content.size());
 }
 
@@ -174,6 +252,487 @@ void file_util_read_lines_with_avx2(benchmark::State& state) {
 }
 BENCHMARK(file_util_read_lines_with_avx2);
 
+void file_util_read_line_views(benchmark::State& state) {
+  const std::string large_content = generate_large_content(1000, 80);
+
+  for (auto _ : state) {
+    std::vector<std::string_view> lines = read_line_views(large_content);
+    benchmark::DoNotOptimize(lines);
+  }
+  set_heap_blocks(state, read_line_views(large_content));
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_read_line_views);
+
+void file_util_line_view_range(benchmark::State& state) {
+  const std::string large_content = generate_large_content(1000, 80);
+
+  // holds nothing but the content it is given.
+  for (auto _ : state) {
+    std::size_t total_length = 0;
+    for (std::string_view line : LineViewRange(large_content)) {
+      total_length += line.size();
+    }
+    benchmark::DoNotOptimize(total_length);
+  }
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_line_view_range);
+
+void file_util_line_reader(benchmark::State& state) {
+  const std::string large_content = generate_large_content(800000, 80);
+  with_temp_file(large_content, [&](const std::string& path) {
+    for (auto _ : state) {
+      LineReader reader(path.c_str());
+      std::string_view line;
+      std::size_t total_length = 0;
+      while (reader.next(&line)) {
+        total_length += line.size();
+      }
+      benchmark::DoNotOptimize(total_length);
+    }
+  });
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_line_reader)->Unit(benchmark::kMillisecond);
+
+void file_util_read_file_then_split(benchmark::State& state) {
+  const std::string large_content = generate_large_content(800000, 80);
+  with_temp_file(large_content, [&](const std::string& path) {
+    for (auto _ : state) {
+      const std::string content = read_file(path.c_str());
+      std::size_t total_length = 0;
+      for (std::string_view line : LineViewRange(content)) {
+        total_length += line.size();
+      }
+      benchmark::DoNotOptimize(total_length);
+    }
+  });
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_read_file_then_split)->Unit(benchmark::kMillisecond);
+
+// a 64 MB mapped source evicted from the page cache before every load, with
+// the `AccessPattern` given by the argument. on tmpfs nothing is evicted.
+void file_util_file_cold_load(benchmark::State& state) {
+  const std::string large_content = generate_large_content(800000, 80);
+  const auto access = static_cast<AccessPattern>(state.range(0));
+  with_temp_file(large_content, [&](const std::string& path) {
+    for (auto _ : state) {
+      state.PauseTiming();
+      (void)read_file(path.c_str(), AccessPattern::kDontNeed);
+      state.ResumeTiming();
+      File file(std::string(path), FileSourceMode::kMapped, access);
+      benchmark::DoNotOptimize(file.line_count());
+    }
+  });
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_file_cold_load)
+    ->DenseRange(0, 4)
+    ->Unit(benchmark::kMillisecond);
+
+// a 64 MB mapped source, indexed from scratch (0) or through a warm sidecar,
+// verified by content hash (1) or by file identity only (2, the default).
+void file_util_file_line_index(benchmark::State& state) {
+  const std::string large_content = generate_large_content(800000, 80);
+  const bool cached = state.range(0) != 0;
+  with_temp_file(large_content, [&](const std::string& path) {
+    TempDir sidecars("line_index_bench_");
+    LineIndexCacheOptions options;
+    options.directory = sidecars.path();
+    options.verify_content = state.range(0) != 2;
+    const LineIndexCache cache(options);
+    if (cached) {
+      File warm(std::string(path), FileSourceMode::kMapped, cache);
+    }
+    for (auto _ : state) {
+      std::optional<File> file;
+      if (cached) {
+        file.emplace(std::string(path), FileSourceMode::kMapped, cache);
+      } else {
+        file.emplace(std::string(path), FileSourceMode::kMapped);
+      }
+      benchmark::DoNotOptimize(file->line_count());
+    }
+    (void)remove_file(cache.sidecar_path(path).c_str());
+  });
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_file_line_index)
+    ->DenseRange(0, 2)
+    ->Unit(benchmark::kMillisecond);
+
+void file_util_hash_bytes(benchmark::State& state) {
+  const std::string content =
+      generate_large_content(static_cast<std::size_t>(state.range(0)) / 81 + 1,
+                             80)
+          .substr(0, static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(hash_bytes(content));
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(file_util_hash_bytes)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(4 << 10)
+    ->Arg(4 << 20);
+
+// baseline for `file_util_hash_bytes`.
+void file_util_hash_std_hash(benchmark::State& state) {
+  const std::string content =
+      generate_large_content(static_cast<std::size_t>(state.range(0)) / 81 + 1,
+                             80)
+          .substr(0, static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(std::hash<std::string_view>()(content));
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(file_util_hash_std_hash)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(4 << 10)
+    ->Arg(4 << 20);
+
+void file_util_hash_streaming(benchmark::State& state) {
+  const std::string content = generate_large_content(50000, 80);
+  const std::size_t chunk = static_cast<std::size_t>(state.range(0));
+  for (auto _ : state) {
+    Hasher hasher;
+    for (std::size_t pos = 0; pos < content.size(); pos += chunk) {
+      hasher.update(std::string_view(content).substr(pos, chunk));
+    }
+    benchmark::DoNotOptimize(hasher.digest());
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(file_util_hash_streaming)->Arg(100)->Arg(64 << 10);
+
+void file_util_hash_file(benchmark::State& state) {
+  const std::string large_content = generate_large_content(800000, 80);
+  with_temp_file(large_content, [&](const std::string& path) {
+    for (auto _ : state) {
+      Hash128 hash;
+      benchmark::DoNotOptimize(hash_file(
+          path.c_str(), &hash, static_cast<std::size_t>(state.range(0))));
+      benchmark::DoNotOptimize(hash);
+    }
+  });
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_hash_file)
+    ->DenseRange(1, 4)
+    ->Unit(benchmark::kMillisecond);
+
+constexpr std::size_t kBatchFileCount = 10000;
+
+std::vector<std::string> create_batch_files(const std::string& dir) {
+  const std::string content = generate_large_content(20, 40);
+  std::vector<std::string> paths;
+  paths.reserve(kBatchFileCount);
+  for (std::size_t i = 0; i < kBatchFileCount; ++i) {
+    paths.push_back(join_path(dir, "file" + std::to_string(i)));
+    write_file(paths.back().c_str(), content);
+  }
+  return paths;
+}
+
+void remove_batch_files(const std::vector<std::string>& paths) {
+  for (const std::string& path : paths) {
+    remove_file(path.c_str());
+  }
+}
+
+// 10k existing files and 10k misses, one stat at a time (0), batched (1) or
+// answered by a warm `StatCache` (2).
+void file_util_stat_many(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::vector<std::string> files = create_batch_files(dir);
+    std::vector<std::string> paths = files;
+    for (const std::string& file : files) {
+      paths.push_back(file + ".missing");
+    }
+    StatCache cache;
+    (void)cache.stat_many(paths);
+    for (auto _ : state) {
+      switch (state.range(0)) {
+        case 0:
+          for (const std::string& path : paths) {
+            benchmark::DoNotOptimize(stat_path(path.c_str()));
+          }
+          break;
+        case 1: benchmark::DoNotOptimize(stat_many(paths)); break;
+        case 2: benchmark::DoNotOptimize(cache.stat_many(paths)); break;
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    remove_batch_files(files);
+  });
+}
+BENCHMARK(file_util_stat_many)
+    ->DenseRange(0, 2)
+    ->Unit(benchmark::kMillisecond);
+
+// 200 `which`-style lookups, half of them misses, through
+// `is_executable_in_path` (0) or a warm `PathResolver` (1).
+void file_util_resolve_executables(benchmark::State& state) {
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < 100; ++i) {
+    names.push_back(i % 2 == 0 ? "sh" : "ls");
+    names.push_back("no_such_tool_" + std::to_string(i));
+  }
+  PathResolver resolver;
+  for (const std::string& name : names) {
+    (void)resolver.resolve(name);
+  }
+  for (auto _ : state) {
+    for (const std::string& name : names) {
+      if (state.range(0) == 0) {
+        benchmark::DoNotOptimize(is_executable_in_path(name.c_str()));
+      } else {
+        benchmark::DoNotOptimize(resolver.resolve(name));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(file_util_resolve_executables)->DenseRange(0, 1);
+
+// what a temp-heavy test does: 100 `TempFile`s and a `TempDir` filled with
+// 100 files and removed recursively, on disk (0) or in memory (1).
+void file_util_temp_entries(benchmark::State& state) {
+  const TempStorage storage =
+      state.range(0) == 0 ? TempStorage::kDisk : TempStorage::kMemory;
+  const std::string content(4096, 'x');
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < 100; ++i) {
+      TempFile file("bench_temp_", content, storage);
+      benchmark::DoNotOptimize(file.valid());
+    }
+    TempDir dir("bench_temp_dir_", storage, true);
+    for (std::size_t i = 0; i < 100; ++i) {
+      const std::string path = join_path(dir.path(), std::to_string(i));
+      benchmark::DoNotOptimize(write_file(path.c_str(), content));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 200);
+}
+BENCHMARK(file_util_temp_entries)->DenseRange(0, 1);
+
+void file_util_write_file_sync(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::string path = join_path(dir, "artifact");
+    const std::string content(16 * 1024, 'x');
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(write_file(path.c_str(), content));
+    }
+    state.SetBytesProcessed(state.iterations() * content.size());
+    remove_file(path.c_str());
+  });
+}
+BENCHMARK(file_util_write_file_sync);
+
+// time spent on the calling thread only; the writes finish in the background.
+void file_util_write_file_async(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::string path = join_path(dir, "artifact");
+    const std::string content(16 * 1024, 'x');
+    {
+      AsyncFileWriter writer;
+      for (auto _ : state) {
+        writer.write(path, std::string(content));
+      }
+      state.SetBytesProcessed(state.iterations() * content.size());
+    }
+    remove_file(path.c_str());
+  });
+}
+BENCHMARK(file_util_write_file_async);
+
+void file_util_copy_with_read_write(benchmark::State& state) {
+  const std::string content = generate_large_content(400000, 80);
+  with_temp_file(content, [&](const std::string& src) {
+    const std::string dst = src + ".copy";
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(
+          write_file(dst.c_str(), read_file(src.c_str())));
+    }
+    state.SetBytesProcessed(state.iterations() * content.size());
+    remove_file(dst.c_str());
+  });
+}
+BENCHMARK(file_util_copy_with_read_write)->Unit(benchmark::kMillisecond);
+
+void file_util_copy_file(benchmark::State& state) {
+  const std::string content = generate_large_content(400000, 80);
+  with_temp_file(content, [&](const std::string& src) {
+    const std::string dst = src + ".copy";
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(copy_file(src.c_str(), dst.c_str()));
+    }
+    state.SetBytesProcessed(state.iterations() * content.size());
+    remove_file(dst.c_str());
+  });
+}
+BENCHMARK(file_util_copy_file)->Unit(benchmark::kMillisecond);
+
+// 10k small files, read one at a time (0) or batched (1).
+void file_util_read_files(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::vector<std::string> paths = create_batch_files(dir);
+    for (auto _ : state) {
+      if (state.range(0) == 0) {
+        for (const std::string& path : paths) {
+          benchmark::DoNotOptimize(read_file(path.c_str()));
+        }
+      } else {
+        benchmark::DoNotOptimize(read_files(paths));
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    remove_batch_files(paths);
+  });
+}
+BENCHMARK(file_util_read_files)
+    ->DenseRange(0, 1)
+    ->Unit(benchmark::kMillisecond);
+
+void file_util_file_manager_add_file_serial(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::vector<std::string> paths = create_batch_files(dir);
+    for (auto _ : state) {
+      FileManager manager;
+      for (const std::string& path : paths) {
+        benchmark::DoNotOptimize(manager.add_file(std::string(path)));
+      }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    remove_batch_files(paths);
+  });
+}
+BENCHMARK(file_util_file_manager_add_file_serial)
+    ->Unit(benchmark::kMillisecond);
+
+void file_util_file_manager_add_files_batched(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::vector<std::string> paths = create_batch_files(dir);
+    for (auto _ : state) {
+      FileManager manager;
+      std::vector<std::string> names = paths;
+      benchmark::DoNotOptimize(manager.add_files(names));
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    remove_batch_files(paths);
+  });
+}
+BENCHMARK(file_util_file_manager_add_files_batched)
+    ->Unit(benchmark::kMillisecond);
+
+// the same header included over and over: every add after the first is a
+// path hit and costs a stat instead of a read and an index build.
+void file_util_file_manager_add_file_repeated(benchmark::State& state) {
+  const std::string content = generate_large_content(2000, 80);
+  with_temp_file(content, [&](const std::string& path) {
+    FileManager manager;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(manager.add_file(std::string(path)));
+    }
+    state.SetItemsProcessed(state.iterations());
+  });
+}
+BENCHMARK(file_util_file_manager_add_file_repeated);
+
+// many threads loading the same set of headers (mostly path hits) and new
+// virtual files, then reading them back; measures contention in the manager.
+void file_util_file_manager_concurrent_add(benchmark::State& state) {
+  const std::size_t thread_count = static_cast<std::size_t>(state.range(0));
+  constexpr std::size_t kAddsPerFile = 8;
+  with_temp_dir([&](const std::string& dir) {
+    const std::vector<std::string> paths = create_batch_files(dir);
+    const std::size_t adds = paths.size() * kAddsPerFile;
+    for (auto _ : state) {
+      FileManager manager;
+      parallel_for(adds, thread_count, [&](std::size_t i) {
+        const FileId id = i % kAddsPerFile == 0
+                              ? manager.add_virtual_file(std::to_string(i))
+                              : manager.add_file(std::string(
+                                    paths[i % paths.size()]));
+        benchmark::DoNotOptimize(manager.file(id)->line_count());
+      });
+    }
+    state.SetItemsProcessed(state.iterations() * adds);
+    remove_batch_files(paths);
+  });
+}
+BENCHMARK(file_util_file_manager_concurrent_add)
+    ->DenseRange(1, static_cast<int64_t>(default_thread_count()))
+    ->Unit(benchmark::kMillisecond);
+
+// warm startup: the batch served from a snapshot instead of read and indexed.
+void file_util_file_manager_load_snapshot(benchmark::State& state) {
+  with_temp_dir([&](const std::string& dir) {
+    const std::vector<std::string> paths = create_batch_files(dir);
+    const std::string snapshot = join_path(dir, "files.snapshot");
+    {
+      FileManager manager;
+      std::vector<std::string> names = paths;
+      benchmark::DoNotOptimize(manager.add_files(names));
+      manager.save_snapshot(snapshot.c_str());
+    }
+    for (auto _ : state) {
+      FileManager manager;
+      benchmark::DoNotOptimize(manager.load_snapshot(snapshot.c_str()));
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+    remove_file(snapshot.c_str());
+    remove_batch_files(paths);
+  });
+}
+BENCHMARK(file_util_file_manager_load_snapshot)->Unit(benchmark::kMillisecond);
+
+void file_util_index_newlines_parallel(benchmark::State& state) {
+  const std::size_t thread_count = static_cast<std::size_t>(state.range(0));
+  const std::string large_content = generate_large_content(1000000, 80);
+
+  for (auto _ : state) {
+    std::vector<std::size_t> indexes =
+        index_newlines_parallel(large_content, thread_count);
+    benchmark::DoNotOptimize(indexes);
+  }
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+}
+BENCHMARK(file_util_index_newlines_parallel)
+    ->DenseRange(1, static_cast<int64_t>(default_thread_count()))
+    ->Unit(benchmark::kMillisecond);
+
+void file_util_compress(benchmark::State& state) {
+  const std::size_t thread_count = static_cast<std::size_t>(state.range(0));
+  const std::string large_content = generate_large_content(400000, 80);
+  const std::string src = temp_path("compress_bench_");
+  const std::string dst = src + ".gz";
+  if (write_file(src.c_str(), large_content) != 0) {
+    state.SkipWithError("failed to write the input file");
+    return;
+  }
+
+  CompressOptions options;
+  options.thread_count = thread_count;
+  for (auto _ : state) {
+    bool ok = compress(src.c_str(), dst.c_str(), false, options);
+    benchmark::DoNotOptimize(ok);
+    state.PauseTiming();
+    remove_file(dst.c_str());
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() * large_content.size());
+  remove_file(src.c_str());
+}
+BENCHMARK(file_util_compress)
+    ->DenseRange(1, static_cast<int64_t>(default_thread_count()))
+    ->Unit(benchmark::kMillisecond);
+
 void file_util_file_constructor(benchmark::State& state) {
   const std::size_t num_lines = 1000;
   const std::size_t line_length = 80;
@@ -254,6 +813,74 @@ void file_util_file_name_access(benchmark::State& state) {
 }
 BENCHMARK(file_util_file_name_access);
 
+std::vector<std::size_t> random_offsets(std::size_t size, std::size_t count) {
+  std::mt19937_64 gen(42);  // NOLINT
+  std::uniform_int_distribution<std::size_t> distrib(0, size);
+  std::vector<std::size_t> offsets(count);
+  for (std::size_t& offset : offsets) {
+    offset = distrib(gen);
+  }
+  return offsets;
+}
+
+void file_util_offset_to_line_std_lower_bound(benchmark::State& state) {
+  const std::string large_content = generate_large_content(1000000, 80);
+  const std::vector<std::size_t> line_ends =
+      index_newlines_default(large_content);
+  const std::vector<std::size_t> offsets =
+      random_offsets(large_content.size(), 4096);
+
+  std::size_t i = 0;
+  for (auto _ : state) {
+    // the line holding an offset is the first one ending at or after it.
+    auto it = std::lower_bound(line_ends.begin(), line_ends.end(),
+                               offsets[i++ & 4095]);
+    benchmark::DoNotOptimize(it);
+  }
+}
+BENCHMARK(file_util_offset_to_line_std_lower_bound);
+
+void file_util_offset_to_line_index(benchmark::State& state) {
+  const std::string large_content = generate_large_content(1000000, 80);
+  File f("test_file.txt", std::string(large_content));
+  const std::vector<std::size_t> offsets =
+      random_offsets(large_content.size(), 4096);
+
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f.line_index().lower_bound(offsets[i++ & 4095]));
+  }
+}
+BENCHMARK(file_util_offset_to_line_index);
+
+void file_util_file_location_of(benchmark::State& state) {
+  const std::string large_content = generate_large_content(1000000, 80);
+  File f("test_file.txt", std::string(large_content));
+  const std::vector<std::size_t> offsets =
+      random_offsets(large_content.size(), 4096);
+
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f.location_of(offsets[i++ & 4095]));
+  }
+}
+BENCHMARK(file_util_file_location_of);
+
+void file_util_file_locations_of_sorted(benchmark::State& state) {
+  const std::string large_content = generate_large_content(1000000, 80);
+  File f("test_file.txt", std::string(large_content));
+  std::vector<std::size_t> offsets =
+      random_offsets(large_content.size(), 1 << 16);
+  std::sort(offsets.begin(), offsets.end());
+
+  for (auto _ : state) {
+    std::vector<LineColumn> locations = f.locations_of(offsets);
+    benchmark::DoNotOptimize(locations);
+  }
+  state.SetItemsProcessed(state.iterations() * offsets.size());
+}
+BENCHMARK(file_util_file_locations_of_sorted);
+
 }  // namespace
 
 }  // namespace core
@@ -8,8 +8,9 @@
 
 namespace core {
 
-std::string temp_path(const std::string& prefix) {
-  std::string dir = temp_directory();
+std::string temp_path(const std::string& prefix, TempStorage storage) {
+  std::string dir = storage == TempStorage::kMemory ? memory_temp_directory()
+                                                    : temp_directory();
 
   static constexpr char charset[] =
       "0123456789"
@@ -0,0 +1,359 @@
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "core/base/file_util.h"
+#include "core/base/logger.h"
+#include "core/base/parallel.h"
+#include "core/check.h"
+
+namespace core {
+
+namespace {
+
+// deflate looks back at most this far, so it is all a block needs to know
+// about the data before it.
+constexpr std::size_t kWindowSize = 32 * 1024;
+constexpr std::size_t kMaxBlockSize = 64 * 1024 * 1024;
+// blocks handed to each thread per round; bounds memory to
+// `thread_count * kBlocksPerThread * block_size`.
+constexpr std::size_t kBlocksPerThread = 8;
+// deflate cannot expand its input by more than this.
+constexpr std::size_t kMaxDeflateRatio = 1032;
+
+// deflate stream in a gzip container, see rfc 1952.
+constexpr int kRawDeflateWindowBits = -MAX_WBITS;
+constexpr int kDefaultMemLevel = 8;
+constexpr unsigned char kOsUnix = 3;
+
+struct DeflateBlock {
+  const unsigned char* data = nullptr;
+  std::size_t size = 0;
+  const unsigned char* dictionary = nullptr;
+  std::size_t dictionary_size = 0;
+  bool last = false;
+
+  std::string output;
+  uLong crc = 0;
+  bool ok = false;
+};
+
+// deflates `block` into a raw deflate fragment. all blocks but the last end
+// on a byte boundary (Z_SYNC_FLUSH), so the fragments concatenate into one
+// valid deflate stream.
+void deflate_block(DeflateBlock* block, int level) {
+  z_stream stream{};
+  if (deflateInit2(&stream, level, Z_DEFLATED, kRawDeflateWindowBits,
+                   kDefaultMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return;
+  }
+  if (block->dictionary_size > 0) {
+    deflateSetDictionary(&stream, block->dictionary,
+                         static_cast<uInt>(block->dictionary_size));
+  }
+
+  // the bound does not cover the sync flush marker.
+  block->output.resize(deflateBound(&stream, block->size) + 16);
+  stream.next_in = const_cast<Bytef*>(block->data);
+  stream.avail_in = static_cast<uInt>(block->size);
+
+  const int flush = block->last ? Z_FINISH : Z_SYNC_FLUSH;
+  std::size_t written = 0;
+  while (true) {
+    stream.next_out = reinterpret_cast<Bytef*>(block->output.data() + written);
+    stream.avail_out = static_cast<uInt>(block->output.size() - written);
+    const int result = deflate(&stream, flush);
+    written = block->output.size() - stream.avail_out;
+
+    if (result == Z_STREAM_END || (!block->last && stream.avail_out > 0 &&
+                                   (result == Z_OK || result == Z_BUF_ERROR))) {
+      break;
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      deflateEnd(&stream);
+      return;
+    }
+    block->output.resize(block->output.size() * 2);
+  }
+  deflateEnd(&stream);
+
+  block->output.resize(written);
+  block->crc = crc32(0, block->data, static_cast<uInt>(block->size));
+  block->ok = true;
+}
+
+void put_le32(unsigned char* out, uint32_t value) {
+  out[0] = static_cast<unsigned char>(value);
+  out[1] = static_cast<unsigned char>(value >> 8);
+  out[2] = static_cast<unsigned char>(value >> 16);
+  out[3] = static_cast<unsigned char>(value >> 24);
+}
+
+uint32_t get_le32(const unsigned char* in) {
+  return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+         static_cast<uint32_t>(in[2]) << 16 |
+         static_cast<uint32_t>(in[3]) << 24;
+}
+
+bool write_all(std::FILE* file, const void* data, std::size_t size) {
+  return std::fwrite(data, 1, size, file) == size;
+}
+
+// resolved `CompressOptions`, shared by the file and buffer paths.
+struct Deflater {
+  explicit Deflater(const CompressOptions& options)
+      : thread_count(options.thread_count == 0 ? default_thread_count()
+                                               : options.thread_count),
+        block_size(std::clamp(options.block_size, kWindowSize, kMaxBlockSize)),
+        level(options.level) {
+    DCHECK(level >= Z_DEFAULT_COMPRESSION && level <= Z_BEST_COMPRESSION);
+  }
+
+  void header(unsigned char out[10]) const {
+    // xfl tells readers how hard the data was compressed.
+    const unsigned char extra_flags =
+        level == Z_BEST_COMPRESSION ? 2 : (level == Z_BEST_SPEED ? 4 : 0);
+    const unsigned char bytes[10] = {
+        0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, extra_flags, kOsUnix,
+    };
+    std::copy(bytes, bytes + 10, out);
+  }
+
+  // deflates `size` bytes at `data` in parallel into `blocks`. the
+  // `dictionary_size` bytes before `data` must be readable. `last` finishes
+  // the stream; a final call may have no data.
+  void deflate(const unsigned char* data,
+               std::size_t size,
+               std::size_t dictionary_size,
+               bool last,
+               std::vector<DeflateBlock>* blocks) const {
+    const std::size_t block_count =
+        std::max<std::size_t>(1, (size + block_size - 1) / block_size);
+    blocks->assign(block_count, DeflateBlock{});
+    for (std::size_t i = 0; i < block_count; ++i) {
+      DeflateBlock& block = (*blocks)[i];
+      block.data = data + i * block_size;
+      block.size = std::min(block_size, size - std::min(size, i * block_size));
+      block.dictionary_size =
+          i == 0 ? std::min(dictionary_size, kWindowSize) : kWindowSize;
+      block.dictionary = block.data - block.dictionary_size;
+      block.last = last && i + 1 == block_count;
+    }
+
+    parallel_for(block_count, thread_count, [&](std::size_t i) {
+      deflate_block(&(*blocks)[i], level);
+    });
+  }
+
+  const std::size_t thread_count;
+  const std::size_t block_size;
+  const int level;
+};
+
+bool compress_stream(std::FILE* src,
+                     std::FILE* dst,
+                     const CompressOptions& options) {
+  const Deflater deflater(options);
+
+  unsigned char header[10];
+  deflater.header(header);
+  if (!write_all(dst, header, sizeof(header))) {
+    return false;
+  }
+
+  // the tail of the previous round primes the first block of the next.
+  std::vector<unsigned char> input(
+      kWindowSize +
+      deflater.thread_count * kBlocksPerThread * deflater.block_size);
+  unsigned char* const round_data = input.data() + kWindowSize;
+  const std::size_t round_capacity = input.size() - kWindowSize;
+  std::size_t dictionary_size = 0;
+
+  std::vector<DeflateBlock> blocks;
+  uLong crc = crc32(0, nullptr, 0);
+  uint64_t total_size = 0;
+  bool last = false;
+  while (!last) {
+    const std::size_t read = std::fread(round_data, 1, round_capacity, src);
+    if (read < round_capacity) {
+      if (std::ferror(src)) {
+        return false;
+      }
+      last = true;
+    }
+
+    // a round that ends exactly at eof still needs a final (empty) block
+    // from the next round.
+    deflater.deflate(round_data, read, dictionary_size, last, &blocks);
+    for (const DeflateBlock& block : blocks) {
+      if (!block.ok ||
+          !write_all(dst, block.output.data(), block.output.size())) {
+        return false;
+      }
+      crc = crc32_combine(crc, block.crc, static_cast<z_off_t>(block.size));
+      total_size += block.size;
+    }
+
+    if (!last) {
+      dictionary_size = std::min(kWindowSize, read);
+      std::copy(round_data + read - dictionary_size, round_data + read,
+                round_data - dictionary_size);
+    }
+  }
+
+  unsigned char trailer[8];
+  put_le32(trailer, static_cast<uint32_t>(crc));
+  // isize is the input size modulo 2^32.
+  put_le32(trailer + 4, static_cast<uint32_t>(total_size));
+  return write_all(dst, trailer, sizeof(trailer));
+}
+
+}  // namespace
+
+bool compress(const char* src_path,
+              const char* dest_path,
+              bool remove_after_compress,
+              const CompressOptions& options) {
+  DCHECK(file_exists(src_path));
+  DCHECK(!file_exists(dest_path));
+  std::FILE* src = std::fopen(src_path, "rb");
+  if (!src) {
+    return false;
+  }
+
+  std::FILE* dst = std::fopen(dest_path, "wb");
+  if (!dst) {
+    std::fclose(src);
+    return false;
+  }
+
+  bool ok = compress_stream(src, dst, options);
+  ok = std::fclose(dst) == 0 && ok;
+  std::fclose(src);
+
+  if (!ok) {
+    // a truncated gzip file is worse than none.
+    std::remove(dest_path);
+    return false;
+  }
+
+  if (remove_after_compress) {
+    std::remove(src_path);
+  }
+  return true;
+}
+
+int compress_buffer(std::span<const std::byte> input,
+                    std::vector<std::byte>* output,
+                    const CompressOptions& options) {
+  output->clear();
+  const Deflater deflater(options);
+  const auto* data = reinterpret_cast<const unsigned char*>(input.data());
+
+  // the whole input is in memory, so every block reads its dictionary in
+  // place and a single round covers everything.
+  std::vector<DeflateBlock> blocks;
+  deflater.deflate(data, input.size(), 0, true, &blocks);
+
+  std::size_t output_size = 10 + 8;
+  for (const DeflateBlock& block : blocks) {
+    if (!block.ok) {
+      glog.error_ref<"failed to compress the buffer (level {})\n">(
+          options.level);
+      glog.flush();
+      return -1;
+    }
+    output_size += block.output.size();
+  }
+  output->resize(output_size);
+  auto* out = reinterpret_cast<unsigned char*>(output->data());
+
+  deflater.header(out);
+  out += 10;
+  uLong crc = crc32(0, nullptr, 0);
+  for (const DeflateBlock& block : blocks) {
+    out = std::copy(block.output.begin(), block.output.end(), out);
+    crc = crc32_combine(crc, block.crc, static_cast<z_off_t>(block.size));
+  }
+  put_le32(out, static_cast<uint32_t>(crc));
+  put_le32(out + 4, static_cast<uint32_t>(input.size()));
+  return 0;
+}
+
+bool decompress_buffer(std::span<const std::byte> input,
+                       std::vector<std::byte>* output) {
+  output->clear();
+  if (input.empty()) {
+    return false;
+  }
+
+  const auto* data = reinterpret_cast<const unsigned char*>(input.data());
+  // the gzip trailer holds the input size modulo 2^32; a good first guess,
+  // but it is untrusted, so no more than deflate can expand the input to.
+  if (input.size() >= 18 && data[0] == 0x1f && data[1] == 0x8b) {
+    output->reserve(std::min<std::size_t>(get_le32(data + input.size() - 4),
+                                          input.size() * kMaxDeflateRatio));
+  }
+
+  z_stream stream{};
+  // +32 detects gzip and zlib headers automatically.
+  if (inflateInit2(&stream, MAX_WBITS + 32) != Z_OK) {
+    return false;
+  }
+
+  constexpr std::size_t kMaxChunk = std::size_t{1} << 30;
+  std::size_t consumed = 0;
+  std::size_t written = 0;
+  int result = Z_OK;
+  while (true) {
+    if (written == output->size()) {
+      output->resize(std::max(
+          {output->size() * 2, output->capacity(), std::size_t{64 * 1024}}));
+    }
+    const std::size_t in_chunk = std::min(input.size() - consumed, kMaxChunk);
+    const std::size_t out_chunk =
+        std::min(output->size() - written, kMaxChunk);
+    stream.next_in = const_cast<Bytef*>(data + consumed);
+    stream.avail_in = static_cast<uInt>(in_chunk);
+    stream.next_out = reinterpret_cast<Bytef*>(output->data() + written);
+    stream.avail_out = static_cast<uInt>(out_chunk);
+
+    result = inflate(&stream, Z_NO_FLUSH);
+    consumed += in_chunk - stream.avail_in;
+    written += out_chunk - stream.avail_out;
+
+    if (result == Z_STREAM_END) {
+      // concatenated gzip members form one file, like `gunzip` reads them.
+      if (consumed == input.size()) {
+        break;
+      }
+      if (inflateReset(&stream) != Z_OK) {
+        break;
+      }
+      continue;
+    }
+    if (result == Z_BUF_ERROR && consumed == input.size()) {
+      // truncated input.
+      break;
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      break;
+    }
+  }
+  inflateEnd(&stream);
+
+  output->resize(written);
+  if (result != Z_STREAM_END) {
+    output->clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace core
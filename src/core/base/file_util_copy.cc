@@ -0,0 +1,321 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/dir_walker.h"
+#include "core/base/file_util.h"
+#include "core/base/logger.h"
+#include "core/base/parallel.h"
+
+#if IS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if IS_LINUX
+#include <sys/sendfile.h>
+#endif
+
+namespace core {
+
+namespace {
+
+#if !IS_WINDOWS
+
+constexpr std::size_t kCopyBufferSize = 1024 * 1024;
+
+// the last resort: every byte passes through user space.
+bool copy_with_read_write(int in, int out) {
+  std::vector<char> buffer(kCopyBufferSize);
+  while (true) {
+    ssize_t bytes = read(in, buffer.data(), buffer.size());
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      return bytes == 0;
+    }
+
+    std::size_t written = 0;
+    while (written < static_cast<std::size_t>(bytes)) {
+      ssize_t result = write(out, buffer.data() + written,
+                             static_cast<std::size_t>(bytes) - written);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        return false;
+      }
+      written += static_cast<std::size_t>(result);
+    }
+  }
+}
+
+#endif  // !IS_WINDOWS
+
+#if IS_LINUX
+
+enum class KernelCopy {
+  kDone,
+  // the call is not supported for these files; nothing was copied.
+  kUnsupported,
+  kFailed,
+};
+
+bool is_unsupported(int error) {
+  return error == ENOSYS || error == EXDEV || error == EINVAL ||
+         error == EOPNOTSUPP || error == EBADF || error == EPERM;
+}
+
+// copies `size` bytes in the kernel; file systems that support it share the
+// extents (reflink) instead of copying data at all.
+KernelCopy copy_with_copy_file_range(int in, int out, std::size_t size) {
+  std::size_t copied = 0;
+  while (copied < size) {
+    ssize_t bytes =
+        copy_file_range(in, nullptr, out, nullptr, size - copied, 0);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0) {
+      return copied == 0 && is_unsupported(errno) ? KernelCopy::kUnsupported
+                                                  : KernelCopy::kFailed;
+    }
+    if (bytes == 0) {
+      // the source shrank.
+      break;
+    }
+    copied += static_cast<std::size_t>(bytes);
+  }
+  return KernelCopy::kDone;
+}
+
+KernelCopy copy_with_sendfile(int in, int out, std::size_t size) {
+  std::size_t copied = 0;
+  while (copied < size) {
+    ssize_t bytes = sendfile(out, in, nullptr, size - copied);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0) {
+      return copied == 0 && is_unsupported(errno) ? KernelCopy::kUnsupported
+                                                  : KernelCopy::kFailed;
+    }
+    if (bytes == 0) {
+      break;
+    }
+    copied += static_cast<std::size_t>(bytes);
+  }
+  return KernelCopy::kDone;
+}
+
+#endif  // IS_LINUX
+
+void log_copy_failure(const char* src, const char* dst) {
+  glog.error_ref<"failed to copy {} to {} ({})\n">(src, dst,
+                                                    std::strerror(errno));
+  glog.flush();
+}
+
+}  // namespace
+
+int copy_file(const char* src_path,
+              const char* dst_path,
+              const CopyOptions& options) {
+#if IS_WINDOWS
+  // CopyFile already copies in the kernel and keeps the attributes.
+  if (!CopyFileA(src_path, dst_path, options.overwrite ? FALSE : TRUE)) {
+    log_copy_failure(src_path, dst_path);
+    return -1;
+  }
+  return 0;
+#else
+  const int in = open(src_path, O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    log_copy_failure(src_path, dst_path);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(in, &st) != 0) {
+    log_copy_failure(src_path, dst_path);
+    close(in);
+    return -1;
+  }
+
+  const mode_t mode = options.preserve_permissions ? st.st_mode & 07777 : 0644;
+  // truncated only once it is known not to be the source itself, under
+  // another name or through a hard link.
+  const int out = open(dst_path,
+                       O_WRONLY | O_CREAT | O_CLOEXEC |
+                           (options.overwrite ? 0 : O_EXCL),
+                       mode);
+  if (out < 0) {
+    log_copy_failure(src_path, dst_path);
+    close(in);
+    return -1;
+  }
+  struct stat out_st;
+  bool distinct = fstat(out, &out_st) == 0;
+  if (distinct && out_st.st_dev == st.st_dev && out_st.st_ino == st.st_ino) {
+    errno = EINVAL;
+    distinct = false;
+  }
+  if (!distinct) {
+    log_copy_failure(src_path, dst_path);
+    close(in);
+    close(out);
+    return -1;
+  }
+  if (ftruncate(out, 0) != 0) {
+    log_copy_failure(src_path, dst_path);
+    close(in);
+    close(out);
+    unlink(dst_path);
+    return -1;
+  }
+
+  bool ok = false;
+  bool copied = false;
+#if IS_LINUX
+  // files such as those in /proc report a size of 0 but still have data;
+  // only the read loop copies them correctly.
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  if (S_ISREG(st.st_mode) && size > 0) {
+    KernelCopy result = copy_with_copy_file_range(in, out, size);
+    if (result == KernelCopy::kUnsupported) {
+      result = copy_with_sendfile(in, out, size);
+    }
+    copied = result != KernelCopy::kUnsupported;
+    ok = result == KernelCopy::kDone;
+  }
+#endif
+  if (!copied) {
+    ok = copy_with_read_write(in, out);
+  }
+
+  // the mode passed to open is filtered by the umask; restore it exactly.
+  if (ok && options.preserve_permissions) {
+    ok = fchmod(out, st.st_mode & 07777) == 0;
+  }
+  if (!ok) {
+    log_copy_failure(src_path, dst_path);
+  }
+  close(in);
+  if (close(out) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    unlink(dst_path);
+    return -1;
+  }
+  return 0;
+#endif
+}
+
+int copy_tree(const std::string& src_dir,
+              const std::string& dst_dir,
+              const CopyOptions& options) {
+  if (!dir_exists(src_dir.c_str())) {
+    glog.error_ref<"cannot open the directory {}\n">(src_dir);
+    glog.flush();
+    return -1;
+  }
+
+  WalkOptions walk_options;
+  walk_options.thread_count = options.thread_count;
+  walk_options.include_hidden = true;
+  walk_options.include_directories = true;
+  const WalkResult entries = walk_directory(src_dir, walk_options);
+  int failures = 0;
+  if (entries.error_count() > 0) {
+    glog.error_ref<"cannot read {} directories under {}\n">(
+        entries.error_count(), src_dir);
+    glog.flush();
+    ++failures;
+  }
+
+  // parents sort before their children, so every directory exists before
+  // anything is created inside it.
+  std::vector<std::size_t> directories;
+  std::vector<std::size_t> others;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    (entries.type(i) == EntryType::kDirectory ? directories : others)
+        .push_back(i);
+  }
+  std::sort(directories.begin(), directories.end(),
+            [&](std::size_t a, std::size_t b) {
+              return entries.path(a) < entries.path(b);
+            });
+
+  if (create_directory(dst_dir.c_str()) != 0) {
+    return -1;
+  }
+  for (std::size_t i : directories) {
+    const std::string path =
+        dst_dir + DIR_SEPARATOR + std::string(entries.path(i));
+    if (create_directory(path.c_str()) != 0) {
+      ++failures;
+    }
+  }
+
+  std::atomic<int> copy_failures{0};
+  const std::size_t thread_count = options.thread_count == 0
+                                       ? default_thread_count()
+                                       : options.thread_count;
+  parallel_for(others.size(), thread_count, [&](std::size_t n) {
+    const std::size_t i = others[n];
+    const std::string relative(entries.path(i));
+    const std::string src = src_dir + DIR_SEPARATOR + relative;
+    const std::string dst = dst_dir + DIR_SEPARATOR + relative;
+
+#if !IS_WINDOWS
+    if (entries.type(i) == EntryType::kSymlink) {
+      // recreate the link itself rather than copying its target.
+      std::vector<char> target(kPathMaxLength);
+      ssize_t length = readlink(src.c_str(), target.data(), target.size());
+      if (length == static_cast<ssize_t>(target.size())) {
+        // possibly truncated; a shortened target would point elsewhere.
+        errno = ENAMETOOLONG;
+        length = -1;
+      }
+      if (length < 0 ||
+          symlink(std::string(target.data(), static_cast<std::size_t>(length))
+                      .c_str(),
+                  dst.c_str()) != 0) {
+        log_copy_failure(src.c_str(), dst.c_str());
+        copy_failures.fetch_add(1, std::memory_order_relaxed);
+      }
+      return;
+    }
+    if (entries.type(i) == EntryType::kOther) {
+      // opening a fifo blocks and a device reads without end. fifos are
+      // recreated; sockets and devices are skipped.
+      struct stat st;
+      if (lstat(src.c_str(), &st) == 0 && S_ISFIFO(st.st_mode) &&
+          mkfifo(dst.c_str(), st.st_mode & 07777) != 0) {
+        log_copy_failure(src.c_str(), dst.c_str());
+        copy_failures.fetch_add(1, std::memory_order_relaxed);
+      }
+      return;
+    }
+#endif
+    if (copy_file(src.c_str(), dst.c_str(), options) != 0) {
+      copy_failures.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  return failures + copy_failures.load() == 0 ? 0 : -1;
+}
+
+}  // namespace core
@@ -0,0 +1,247 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/dir_walker.h"
+#include "core/base/file_util.h"
+#include "core/base/logger.h"
+#include "core/base/parallel.h"
+
+#if IS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if IS_LINUX
+#include <linux/magic.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#endif
+
+namespace core {
+
+namespace {
+
+#if IS_LINUX
+
+bool is_writable_tmpfs(const std::string& dir) {
+  struct statfs fs;
+  return statfs(dir.c_str(), &fs) == 0 &&
+         static_cast<unsigned long>(fs.f_type) == TMPFS_MAGIC &&
+         access(dir.c_str(), W_OK | X_OK) == 0;
+}
+
+std::string find_memory_temp_directory() {
+  std::vector<std::string> candidates = {temp_directory(), "/dev/shm/"};
+  const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir && *runtime_dir) {
+    candidates.push_back(std::string(runtime_dir) + DIR_SEPARATOR);
+  }
+  for (const std::string& candidate : candidates) {
+    if (is_writable_tmpfs(candidate)) {
+      return candidate;
+    }
+  }
+  return temp_directory();
+}
+
+#ifdef MFD_CLOEXEC
+// an anonymous file holding `content`, or -1 if memfds, or the /proc paths
+// that reach them, are not available.
+int create_memfd(const std::string& name, const std::string& content) {
+  const int fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  std::size_t written = 0;
+  while (written < content.size()) {
+    const ssize_t n =
+        write(fd, content.data() + written, content.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      close(fd);
+      return -1;
+    }
+    written += static_cast<std::size_t>(n);
+  }
+  const std::string path = "/proc/self/fd/" + std::to_string(fd);
+  if (access(path.c_str(), R_OK | W_OK) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+#endif  // MFD_CLOEXEC
+
+#endif  // IS_LINUX
+
+}  // namespace
+
+const std::string& memory_temp_directory() {
+#if IS_LINUX
+  static const std::string cached_directory = find_memory_temp_directory();
+#else
+  static const std::string cached_directory = temp_directory();
+#endif
+  return cached_directory;
+}
+
+int remove_tree(const std::string& dir) {
+#if !IS_WINDOWS
+  // walking a symlink would empty its target; remove the link instead.
+  struct stat st;
+  if (lstat(dir.c_str(), &st) == 0 && S_ISLNK(st.st_mode)) {
+    if (unlink(dir.c_str()) != 0) {
+      glog.error_ref<"failed to remove the directory tree: {} ({})\n">(
+          dir, std::strerror(errno));
+      glog.flush();
+      return -1;
+    }
+    return 0;
+  }
+#endif
+
+  WalkOptions walk_options;
+  walk_options.include_hidden = true;
+  walk_options.include_directories = true;
+  const WalkResult entries = walk_directory(dir, walk_options);
+
+  std::vector<std::size_t> directories;
+  std::vector<std::size_t> others;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    (entries.type(i) == EntryType::kDirectory ? directories : others)
+        .push_back(i);
+  }
+
+  // errno is per thread; keep the first failure's for the report.
+  std::atomic<int> first_error{0};
+  auto record_failure = [&first_error]() {
+    int expected = 0;
+    first_error.compare_exchange_strong(expected, errno != 0 ? errno : EIO,
+                                        std::memory_order_relaxed);
+  };
+  parallel_for(others.size(), default_thread_count(), [&](std::size_t n) {
+    const std::string path =
+        dir + DIR_SEPARATOR + std::string(entries.path(others[n]));
+    if (remove_file(path.c_str()) != 0) {
+      record_failure();
+    }
+  });
+
+  // children sort after their parents, so they are removed first.
+  std::sort(directories.begin(), directories.end(),
+            [&](std::size_t a, std::size_t b) {
+              return entries.path(a) > entries.path(b);
+            });
+  for (std::size_t i : directories) {
+    const std::string path = dir + DIR_SEPARATOR + std::string(entries.path(i));
+    if (remove_directory(path.c_str()) != 0) {
+      record_failure();
+    }
+  }
+  if (remove_directory(dir.c_str()) != 0) {
+    record_failure();
+  }
+
+  const int error = first_error.load(std::memory_order_relaxed);
+  if (error != 0) {
+    glog.error_ref<"failed to remove the directory tree: {} ({})\n">(
+        dir, std::strerror(error));
+    glog.flush();
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+TempFile::TempFile(const std::string& prefix,
+                   const std::string& content,
+                   TempStorage storage) {
+#if IS_LINUX && defined(MFD_CLOEXEC)
+  if (storage == TempStorage::kMemory) {
+    fd_ = create_memfd(prefix, content);
+    if (fd_ >= 0) {
+      path_ = "/proc/self/fd/" + std::to_string(fd_);
+      return;
+    }
+  }
+#endif
+
+  path_ = temp_path(prefix, storage);
+  if (create_file(path_.c_str()) != 0) {
+    glog.error_ref<"failed to create the temp file: {} ({})\n">(
+        path_, std::strerror(errno));
+    glog.flush();
+    valid_ = false;
+    return;
+  }
+  if (!content.empty()) {
+    if (write_file(path_.c_str(), content) != 0) {
+      glog.error_ref<"failed to write to the temp file: {} ({})\n">(
+          path_, std::strerror(errno));
+      glog.flush();
+      valid_ = false;
+    }
+  }
+}
+
+TempFile::~TempFile() {
+  if (fd_ >= 0) {
+#if !IS_WINDOWS
+    close(fd_);
+#endif
+    return;
+  }
+  if (valid_) {
+    if (remove_file(path_.c_str()) != 0) {
+      glog.error_ref<"failed to remove the temp file: {} ({})\n">(
+          path_, std::strerror(errno));
+      glog.flush();
+    }
+  }
+}
+
+TempDir::TempDir(const std::string& prefix,
+                 TempStorage storage,
+                 bool remove_contents)
+    : remove_contents_(remove_contents) {
+  path_ = temp_path(prefix, storage);
+  if (create_directory(path_.c_str()) != 0) {
+    glog.error_ref<"failed to create the temp directory: {} ({})\n">(
+        path_, std::strerror(errno));
+    glog.flush();
+    valid_ = false;
+  }
+}
+
+TempDir::~TempDir() {
+  if (!valid_) {
+    return;
+  }
+  if (remove_contents_) {
+    // `remove_tree` reports its own failures.
+    (void)remove_tree(path_);
+    return;
+  }
+  if (remove_directory(path_.c_str()) != 0) {
+    glog.error_ref<"failed to remove the temp directory: {} ({})\n">(
+        path_, std::strerror(errno));
+    glog.flush();
+  }
+}
+
+}  // namespace core
@@ -1,13 +1,27 @@
 #include "core/base/file_util.h"
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "build/build_flag.h"
+#include "core/base/byte_scan.h"
+#include "core/base/cpu_features.h"
 #include "gtest/gtest.h"
 
+#if !IS_WINDOWS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace core {
 
 TEST(FileUtilTest, TempFileLifecycle) {
@@ -25,6 +39,61 @@ TEST(FileUtilTest, TempDirLifecycle) {
   EXPECT_TRUE(dir_exists(dir.path().c_str()));
 }
 
+TEST(FileUtilTest, MemoryTempFile) {
+  std::string path;
+  {
+    TempFile file("memory_temp_", "content", TempStorage::kMemory);
+    ASSERT_TRUE(file.valid());
+    path = file.path();
+    EXPECT_TRUE(file_exists(path.c_str()));
+    EXPECT_EQ(read_file(path.c_str()), "content");
+
+    // rewritable and mappable through its path like a file on disk.
+    ASSERT_EQ(write_file(path.c_str(), "rewritten"), 0);
+    const File mapped(std::string(path), FileSourceMode::kMapped);
+    EXPECT_EQ(mapped.source(), "rewritten");
+  }
+  EXPECT_FALSE(file_exists(path.c_str()));
+}
+
+TEST(FileUtilTest, TempDirRemovesContents) {
+  std::string path;
+  {
+    TempDir dir("remove_contents_", TempStorage::kMemory, true);
+    ASSERT_TRUE(dir.valid());
+    path = dir.path();
+    EXPECT_EQ(path.rfind(memory_temp_directory(), 0), 0u);
+    const std::string nested = join_path(path, "a");
+    ASSERT_EQ(create_directories(join_path(nested, "b").c_str()), 0);
+    ASSERT_EQ(write_file(join_path(path, ".hidden").c_str(), "x"), 0);
+    ASSERT_EQ(write_file(join_path(nested, "file").c_str(), "x"), 0);
+    ASSERT_EQ(
+        write_file(join_path(join_path(nested, "b"), "file").c_str(), "x"), 0);
+#if !IS_WINDOWS
+    // removed, not followed.
+    ASSERT_EQ(symlink(nested.c_str(), join_path(path, "link").c_str()), 0);
+#endif
+  }
+  EXPECT_FALSE(dir_exists(path.c_str()));
+
+  TempDir parent("remove_tree_");
+  ASSERT_TRUE(parent.valid());
+  EXPECT_EQ(remove_tree(join_path(parent.path(), "missing")), -1);
+
+#if !IS_WINDOWS
+  // a symlinked root is removed without emptying its target.
+  const std::string target = join_path(parent.path(), "target");
+  const std::string link = join_path(parent.path(), "link");
+  ASSERT_EQ(create_directory(target.c_str()), 0);
+  ASSERT_EQ(write_file(join_path(target, "file").c_str(), "x"), 0);
+  ASSERT_EQ(symlink(target.c_str(), link.c_str()), 0);
+  EXPECT_EQ(remove_tree(link), 0);
+  EXPECT_FALSE(dir_exists(link.c_str()));
+  EXPECT_TRUE(file_exists(join_path(target, "file").c_str()));
+  EXPECT_EQ(remove_tree(target), 0);
+#endif
+}
+
 TEST(FileUtilTest, WriteAndReadFile) {
   std::string temp = temp_path("fileutil_test_");
   std::string content = "Hello, World!";
@@ -34,6 +103,28 @@ TEST(FileUtilTest, WriteAndReadFile) {
   EXPECT_EQ(remove_file(temp.c_str()), 0);
 }
 
+TEST(FileUtilTest, ReadFilesMatchesReadFile) {
+  TempDir dir("fileutil_test_", TempStorage::kDisk, true);
+  ASSERT_TRUE(dir.valid());
+  // enough files to go through io_uring where it is available, plus ones it
+  // hands back: empty, missing and a directory.
+  std::vector<std::string> paths;
+  std::vector<std::string> expected;
+  for (std::size_t i = 0; i < 600; ++i) {
+    paths.push_back(join_path(dir.path(), "file" + std::to_string(i)));
+    expected.push_back(
+        std::string(i * 37 % 5000, static_cast<char>('a' + i % 26)));
+    ASSERT_EQ(write_file(paths.back().c_str(), expected.back()), 0);
+  }
+  paths.push_back(join_path(dir.path(), "missing"));
+  expected.push_back("");
+  paths.push_back(dir.path());
+  expected.push_back("");
+
+  EXPECT_EQ(read_files(paths), expected);
+  EXPECT_TRUE(read_files({}).empty());
+}
+
 TEST(FileUtilTest, WriteBinaryToFile) {
   std::string temp = temp_path("bin_test_");
   std::vector<uint8_t> data = {1, 2, 3, 4, 5};
@@ -55,6 +146,233 @@ TEST(FileUtilTest, WriteBinaryToFile) {
   EXPECT_EQ(remove_result, 0);
 }
 
+namespace {
+
+std::string gunzip_file(const std::string& path) {
+  gzFile file = gzopen(path.c_str(), "rb");
+  std::string content;
+  if (!file) {
+    return content;
+  }
+  char buffer[8192];
+  int bytes;
+  while ((bytes = gzread(file, buffer, sizeof(buffer))) > 0) {
+    content.append(buffer, static_cast<std::size_t>(bytes));
+  }
+  gzclose(file);
+  return content;
+}
+
+}  // namespace
+
+TEST(FileUtilTest, CompressParallelRoundTrip) {
+  // 4 threads * 8 blocks * 32 KiB is exactly one round, which ends in an
+  // empty final block; the others end mid-round or are empty.
+  constexpr std::size_t kRoundSize = 4 * 8 * 32 * 1024;
+  std::string text;
+  while (text.size() < kRoundSize) {
+    text += "line " + std::to_string(text.size() % 977) + " of the log\n";
+  }
+  text.resize(kRoundSize);
+
+  for (const std::string& content :
+       {std::string(), std::string("x"), text, text + text.substr(0, 1234)}) {
+    for (int level : {1, 6, 9}) {
+      std::string src = temp_path("compress_src_");
+      std::string dst = src + ".gz";
+      ASSERT_EQ(write_file(src.c_str(), content), 0);
+
+      CompressOptions options;
+      options.thread_count = 4;
+      options.level = level;
+      options.block_size = 32 * 1024;
+      ASSERT_TRUE(compress(src.c_str(), dst.c_str(), true, options));
+      EXPECT_FALSE(file_exists(src.c_str()));
+
+      EXPECT_EQ(gunzip_file(dst), content);
+      if (content.size() == kRoundSize) {
+        EXPECT_LT(read_file(dst.c_str()).size(), content.size() / 4);
+      }
+      EXPECT_EQ(remove_file(dst.c_str()), 0);
+    }
+  }
+}
+
+TEST(FileUtilTest, CompressBufferRoundTrip) {
+  std::string text;
+  for (std::size_t i = 0; text.size() < 300000; ++i) {
+    text += "entry " + std::to_string(i % 1013) + "\n";
+  }
+
+  for (const std::string& content : {std::string(), text}) {
+    const auto input =
+        std::as_bytes(std::span<const char>(content.data(), content.size()));
+    CompressOptions options;
+    options.thread_count = 3;
+    options.block_size = 32 * 1024;
+    std::vector<std::byte> compressed;
+    ASSERT_EQ(compress_buffer(input, &compressed, options), 0);
+
+    std::vector<std::byte> output;
+    ASSERT_TRUE(decompress_buffer(compressed, &output));
+    EXPECT_TRUE(std::equal(output.begin(), output.end(), input.begin(),
+                           input.end()));
+
+    // the file path and the buffer path agree byte for byte.
+    TempFile src("compress_buffer_", content);
+    std::string dst = src.path() + ".gz";
+    ASSERT_TRUE(compress(src.path().c_str(), dst.c_str(), false, options));
+    const std::vector<std::byte> from_file = read_file_bin(dst.c_str());
+    EXPECT_EQ(from_file, compressed);
+    EXPECT_EQ(remove_file(dst.c_str()), 0);
+
+    // truncated data is rejected.
+    std::vector<std::byte> truncated(compressed.begin(),
+                                     compressed.end() - 4);
+    EXPECT_FALSE(decompress_buffer(truncated, &output));
+    EXPECT_TRUE(output.empty());
+  }
+
+  // a corrupt stream whose trailer claims 4 GiB is not taken at its word.
+  std::vector<std::byte> corrupt(18, std::byte{0xff});
+  corrupt[0] = std::byte{0x1f};
+  corrupt[1] = std::byte{0x8b};
+  corrupt[2] = std::byte{Z_DEFLATED};
+  corrupt[3] = std::byte{0};
+  std::vector<std::byte> output;
+  EXPECT_FALSE(decompress_buffer(corrupt, &output));
+  EXPECT_LT(output.capacity(), std::size_t{1} << 20);
+}
+
+TEST(FileUtilTest, WriteFileAtomic) {
+  TempDir dir("atomic_write_test_");
+  ASSERT_TRUE(dir.valid());
+  const std::string path = join_path(dir.path(), "artifact.txt");
+
+  // more buffers than one writev call takes, with empty ones mixed in.
+  std::vector<std::string> parts;
+  std::string expected;
+  for (int i = 0; i < 3000; ++i) {
+    parts.push_back(i % 7 == 0 ? "" : std::to_string(i) + ",");
+    expected += parts.back();
+  }
+  std::vector<std::string_view> buffers(parts.begin(), parts.end());
+
+  for (Durability durability :
+       {Durability::kNone, Durability::kData, Durability::kFull}) {
+    ASSERT_EQ(write_file_atomic(path.c_str(), "old content", durability), 0);
+    EXPECT_EQ(read_file(path.c_str()), "old content");
+
+    // replaces the existing file.
+    ASSERT_EQ(write_file_atomic(path.c_str(), buffers, durability), 0);
+    EXPECT_EQ(read_file(path.c_str()), expected);
+
+    // no temp file is left behind.
+    EXPECT_EQ(list_files(dir.path()), Files{"artifact.txt"});
+  }
+
+#if !IS_WINDOWS
+  // a replaced file keeps its permissions.
+  ASSERT_EQ(chmod(path.c_str(), 0750), 0);
+  ASSERT_EQ(write_file_atomic(path.c_str(), "new content"), 0);
+  struct stat st;
+  ASSERT_EQ(stat(path.c_str(), &st), 0);
+  EXPECT_EQ(st.st_mode & 07777, 0750u);
+  EXPECT_EQ(read_file(path.c_str()), "new content");
+#endif
+
+  EXPECT_NE(write_file_atomic(
+                join_path(dir.path(), "missing", "file.txt").c_str(), "x"),
+            0);
+  EXPECT_EQ(remove_file(path.c_str()), 0);
+}
+
+TEST(FileUtilTest, CopyFile) {
+  std::string content;
+  for (int i = 0; content.size() < 3 * 1024 * 1024; ++i) {
+    content += std::to_string(i * 7919) + ";";
+  }
+  TempFile src("copy_src_", content);
+  ASSERT_TRUE(src.valid());
+  const std::string dst = src.path() + ".copy";
+
+  ASSERT_EQ(copy_file(src.path().c_str(), dst.c_str()), 0);
+  EXPECT_EQ(read_file(dst.c_str()), content);
+
+  CopyOptions no_overwrite;
+  no_overwrite.overwrite = false;
+  EXPECT_NE(copy_file(src.path().c_str(), dst.c_str(), no_overwrite), 0);
+  EXPECT_EQ(read_file(dst.c_str()), content);
+
+#if !IS_WINDOWS
+  ASSERT_EQ(chmod(src.path().c_str(), 0751), 0);
+  CopyOptions preserve;
+  preserve.preserve_permissions = true;
+  ASSERT_EQ(copy_file(src.path().c_str(), dst.c_str(), preserve), 0);
+  struct stat st;
+  ASSERT_EQ(stat(dst.c_str(), &st), 0);
+  EXPECT_EQ(st.st_mode & 07777, 0751u);
+
+  // files that report a size of 0 but have content.
+  if (file_exists("/proc/self/status")) {
+    ASSERT_EQ(copy_file("/proc/self/status", dst.c_str()), 0);
+    EXPECT_FALSE(read_file(dst.c_str()).empty());
+  }
+#endif
+
+  EXPECT_EQ(remove_file(dst.c_str()), 0);
+  EXPECT_NE(copy_file("/nonexistent/copy_src", dst.c_str()), 0);
+
+  // a copy onto the source itself fails and leaves it intact.
+  EXPECT_NE(copy_file(src.path().c_str(), src.path().c_str()), 0);
+  EXPECT_EQ(read_file(src.path().c_str()), content);
+#if !IS_WINDOWS
+  const std::string hard_link = src.path() + ".link";
+  ASSERT_EQ(link(src.path().c_str(), hard_link.c_str()), 0);
+  EXPECT_NE(copy_file(src.path().c_str(), hard_link.c_str()), 0);
+  EXPECT_EQ(read_file(src.path().c_str()), content);
+  EXPECT_EQ(remove_file(hard_link.c_str()), 0);
+#endif
+}
+
+TEST(FileUtilTest, CopyTree) {
+  TempDir src("copy_tree_src_", TempStorage::kDisk, true);
+  TempDir parent("copy_tree_dst_", TempStorage::kDisk, true);
+  ASSERT_TRUE(src.valid());
+  ASSERT_TRUE(parent.valid());
+  const std::string dst = join_path(parent.path(), "copy");
+
+  ASSERT_EQ(create_directories(join_path(src.path(), "a", "b").c_str()), 0);
+  ASSERT_EQ(create_directory(join_path(src.path(), ".hidden").c_str()), 0);
+  const std::vector<std::string> files = {
+      join_path("top.txt"), join_path("a", "one.txt"),
+      join_path("a", "b", "two.txt"), join_path(".hidden", "three.txt")};
+  for (const std::string& file : files) {
+    ASSERT_EQ(write_file(join_path(src.path(), file).c_str(), file), 0);
+  }
+#if !IS_WINDOWS
+  ASSERT_EQ(symlink("top.txt", join_path(src.path(), "link").c_str()), 0);
+  // opening a fifo to copy it would block forever.
+  ASSERT_EQ(mkfifo(join_path(src.path(), "a", "fifo").c_str(), 0600), 0);
+#endif
+
+  CopyOptions options;
+  options.thread_count = 3;
+  ASSERT_EQ(copy_tree(src.path(), dst, options), 0);
+  for (const std::string& file : files) {
+    EXPECT_EQ(read_file(join_path(dst, file).c_str()), file);
+  }
+#if !IS_WINDOWS
+  char target[16] = {};
+  EXPECT_EQ(readlink(join_path(dst, "link").c_str(), target, sizeof(target)),
+            7);
+  EXPECT_STREQ(target, "top.txt");
+  struct stat st;
+  ASSERT_EQ(lstat(join_path(dst, "a", "fifo").c_str(), &st), 0);
+  EXPECT_TRUE(S_ISFIFO(st.st_mode));
+#endif
+}
+
 TEST(FileUtilTest, JoinPathBasic) {
   std::string result = join_path("folder", "sub", "file.txt");
 #ifdef _WIN32
@@ -81,10 +399,300 @@ TEST(FileUtilTest, ReadLines) {
   EXPECT_EQ(lines[2], "line3");
 }
 
+TEST(FileUtilTest, IndexNewlinesParallelMatchesDefault) {
+  std::string mixed;
+  for (std::size_t i = 0; i < 3000; ++i) {
+    mixed.append(i % 7, 'x');
+    mixed.append(i % 5 == 0 ? "\r\n" : "\n");
+  }
+  const std::string contents[] = {
+      std::string(1000, 'a'),
+      std::string(1000, '\n'),
+      mixed,
+      mixed + "tail",
+      std::string(127, 'b') + "\n" + std::string(128, 'c'),
+  };
+
+  for (const std::string& content : contents) {
+    const std::vector<std::size_t> expected = index_newlines_default(content);
+    for (std::size_t threads = 1; threads <= 8; ++threads) {
+      EXPECT_EQ(index_newlines_parallel(content, threads), expected)
+          << "threads: " << threads << ", size: " << content.size();
+    }
+  }
+}
+
+TEST(FileUtilTest, NewlineKernelsMatchDefault) {
+  std::string content;
+  for (std::size_t i = 0; i < 500; ++i) {
+    content.append(i % 67, 'y');
+    content.push_back('\n');
+  }
+
+  std::vector<NewlineScanFn> kernels = {find_newlines_scalar};
+#if ARCH_X64 || ARCH_X86
+  const CpuFeatures& features = cpu_features();
+  if (features.sse2) {
+    kernels.push_back(find_newlines_sse2);
+  }
+  if (features.avx2) {
+    kernels.push_back(find_newlines_avx2);
+  }
+  if (features.avx512bw) {
+    kernels.push_back(find_newlines_avx512bw);
+  }
+#endif  // ARCH_X64 || ARCH_X86
+
+  // every prefix length exercises each kernel's tail handling.
+  for (std::size_t size = 0; size <= 200; ++size) {
+    std::string_view prefix(content.data(), size);
+    std::vector<std::size_t> expected = index_newlines_default(prefix);
+    // drop the end-of-content sentinel.
+    if (!expected.empty() && expected.back() == size) {
+      expected.pop_back();
+    }
+
+    for (NewlineScanFn kernel : kernels) {
+      std::vector<std::size_t> found;
+      kernel(prefix.data(), prefix.size(), 0, &found);
+      EXPECT_EQ(found, expected) << "size: " << size;
+    }
+  }
+
+  EXPECT_EQ(index_newlines<true>(content), index_newlines<false>(content));
+  EXPECT_EQ(read_lines<true>(content), read_lines<false>(content));
+}
+
+TEST(FileUtilTest, AccessPatternsOnlyHint) {
+  std::string content;
+  for (std::size_t i = 0; i < 20000; ++i) {
+    content += "line " + std::to_string(i) + "\n";
+  }
+  TempFile file("access_pattern_", content);
+  ASSERT_TRUE(file.valid());
+  const char* path = file.path().c_str();
+
+  for (AccessPattern access :
+       {AccessPattern::kNormal, AccessPattern::kSequential,
+        AccessPattern::kRandom, AccessPattern::kWillNeed,
+        AccessPattern::kDontNeed}) {
+    EXPECT_EQ(read_file(path, access), content);
+    const MappedFile mapped(path, access);
+    ASSERT_TRUE(mapped.valid());
+    EXPECT_EQ(mapped.view(), content);
+
+    for (FileSourceMode mode :
+         {FileSourceMode::kCopy, FileSourceMode::kMapped}) {
+      const File source(std::string(file.path()), mode, access);
+      ASSERT_EQ(source.line_count(), 20000u);
+      source.prefetch_lines(1, 1);
+      source.prefetch_lines(500, 15000);
+      source.prefetch_lines(1, source.line_count());
+      EXPECT_EQ(source.line(15000), "line 14999");
+    }
+  }
+
+  // unaligned ranges are widened to whole pages.
+  advise_range(content.data() + 3, 5000, AccessPattern::kWillNeed);
+  advise_range(content.data(), 0, AccessPattern::kRandom);
+}
+
+TEST(FileUtilTest, LineViewsMatchReadLines) {
+  const std::string contents[] = {
+      "",
+      "\n",
+      "single",
+      "a\r\nb\n\nc\r\n",
+      "trailing\r",
+      "x\n\r\ny",
+  };
+
+  for (const std::string& content : contents) {
+    const std::vector<std::string> expected = read_lines<false>(content);
+
+    const std::vector<std::string_view> views = read_line_views(content);
+    ASSERT_EQ(views.size(), expected.size()) << content;
+
+    std::vector<std::string_view> lazy;
+    for (std::string_view line : LineViewRange(content)) {
+      lazy.push_back(line);
+    }
+    ASSERT_EQ(lazy.size(), expected.size()) << content;
+
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(views[i], expected[i]);
+      EXPECT_EQ(lazy[i], expected[i]);
+    }
+  }
+}
+
+TEST(FileUtilTest, LineIndexEncodings) {
+  constexpr std::size_t k4GiB = std::size_t{1} << 32;
+
+  std::vector<std::size_t> small = {3, 9, 10};
+  LineIndex narrow(small, 11);
+  EXPECT_EQ(narrow.encoding(), LineIndex::Encoding::kNarrow);
+
+  std::vector<std::size_t> large;
+  for (std::size_t i = 0; i < 3 * LineIndex::kBlockSize + 5; ++i) {
+    large.push_back(k4GiB - 1000 + i * 7);
+  }
+  LineIndex blocked(large, large.back() + 1);
+  EXPECT_EQ(blocked.encoding(), LineIndex::Encoding::kBlockDelta);
+  EXPECT_LT(blocked.memory_usage(), large.size() * sizeof(std::size_t));
+
+  std::vector<std::size_t> giant_lines = {10, 3 * k4GiB, 5 * k4GiB};
+  LineIndex wide(giant_lines, giant_lines.back() + 1);
+  EXPECT_EQ(wide.encoding(), LineIndex::Encoding::kWide);
+
+  for (const auto& [index, expected] :
+       {std::pair<const LineIndex*, const std::vector<std::size_t>*>{&narrow,
+                                                                     &small},
+        {&blocked, &large},
+        {&wide, &giant_lines}}) {
+    ASSERT_EQ(index->size(), expected->size());
+    for (std::size_t i = 0; i < expected->size(); ++i) {
+      EXPECT_EQ((*index)[i], (*expected)[i]);
+    }
+    for (std::size_t value : {std::size_t{0}, std::size_t{10}, k4GiB - 1,
+                              k4GiB + 500, 4 * k4GiB, 6 * k4GiB}) {
+      const auto it =
+          std::lower_bound(expected->begin(), expected->end(), value);
+      EXPECT_EQ(index->lower_bound(value),
+                static_cast<std::size_t>(it - expected->begin()));
+    }
+  }
+
+  std::vector<std::size_t> dense;
+  for (std::size_t i = 0; i < 5 * LineIndex::kBlockSize + 17; ++i) {
+    dense.push_back(i * 3 + 2);
+  }
+  LineIndex dense_index(dense, dense.back() + 1);
+  for (std::size_t value = 0; value <= dense.back() + 1; ++value) {
+    const auto it = std::lower_bound(dense.begin(), dense.end(), value);
+    ASSERT_EQ(dense_index.lower_bound(value),
+              static_cast<std::size_t>(it - dense.begin()));
+  }
+}
+
+TEST(FileUtilTest, FileMemoryUsage) {
+  std::string source = std::string(1000, 'z') + "\n" + std::string(10, 'z');
+  File file("usage.txt", std::move(source));
+  EXPECT_EQ(file.line_count(), 2);
+  EXPECT_GE(file.memory_usage(),
+            sizeof(File) + file.source().size() + 2 * sizeof(uint32_t));
+}
+
+TEST(FileUtilTest, FileLocationOf) {
+  // "é" and "→" are 2 and 3 bytes long in utf-8.
+  File file("location.txt", std::string("ab\r\n\xc3\xa9x\n\n\xe2\x86\x92y\n"));
+
+  EXPECT_EQ(file.location_of(0), (LineColumn{1, 1}));
+  EXPECT_EQ(file.location_of(1), (LineColumn{1, 2}));
+  EXPECT_EQ(file.location_of(2), (LineColumn{1, 3}));
+  EXPECT_EQ(file.location_of(3), (LineColumn{1, 4}));
+  EXPECT_EQ(file.location_of(4), (LineColumn{2, 1}));
+  EXPECT_EQ(file.location_of(6), (LineColumn{2, 2}));
+  EXPECT_EQ(file.location_of(8), (LineColumn{3, 1}));
+  EXPECT_EQ(file.location_of(12), (LineColumn{4, 2}));
+  EXPECT_EQ(file.location_of(14), (LineColumn{5, 1}));
+
+  std::vector<std::size_t> offsets;
+  for (std::size_t i = 0; i <= file.source().size(); ++i) {
+    offsets.push_back(i);
+  }
+  std::vector<LineColumn> locations = file.locations_of(offsets);
+  ASSERT_EQ(locations.size(), offsets.size());
+  for (std::size_t i = 0; i < offsets.size(); ++i) {
+    EXPECT_EQ(locations[i], file.location_of(offsets[i]));
+  }
+
+  // sparse offsets take the search path instead of the linear walk.
+  std::string long_source;
+  for (int i = 0; i < 1000; ++i) {
+    long_source += "line\n";
+  }
+  File long_file("long.txt", std::move(long_source));
+  std::vector<std::size_t> sparse = {0, 7, 2000, 2003, 4999};
+  std::vector<LineColumn> sparse_locations = long_file.locations_of(sparse);
+  EXPECT_EQ(sparse_locations[1], (LineColumn{2, 3}));
+  EXPECT_EQ(sparse_locations[2], (LineColumn{401, 1}));
+  EXPECT_EQ(sparse_locations[3], (LineColumn{401, 4}));
+  EXPECT_EQ(sparse_locations[4], (LineColumn{1000, 5}));
+}
+
 TEST(FileUtilTest, FileExtension) {
   EXPECT_EQ(file_extension("test.txt"), "txt");
   EXPECT_EQ(file_extension("archive.tar.gz"), "gz");
   EXPECT_EQ(file_extension("no_extension"), "");
 }
 
+TEST(FileUtilTest, MappedFileMatchesCopy) {
+  TempFile tmp("mapped_test_", "first\r\nsecond\nthird");
+  ASSERT_TRUE(tmp.valid());
+
+  File copied(std::string(tmp.path()), FileSourceMode::kCopy);
+  File mapped(std::string(tmp.path()), FileSourceMode::kMapped);
+  EXPECT_FALSE(copied.is_mapped());
+  EXPECT_TRUE(mapped.is_mapped());
+
+  EXPECT_EQ(mapped.source(), copied.source());
+  ASSERT_EQ(mapped.line_count(), 3);
+  ASSERT_EQ(mapped.line_count(), copied.line_count());
+  for (std::size_t i = 1; i <= mapped.line_count(); ++i) {
+    EXPECT_EQ(mapped.line(i), copied.line(i));
+  }
+  EXPECT_EQ(mapped.line(1), "first");
+  EXPECT_EQ(mapped.line(3), "third");
+
+  File moved = std::move(mapped);
+  EXPECT_TRUE(moved.is_mapped());
+  EXPECT_EQ(moved.line(2), "second");
+}
+
+TEST(FileUtilTest, FileMoveKeepsSmallSource) {
+  File original("small.txt", std::string("a\nb"));
+  File moved = std::move(original);
+  ASSERT_EQ(moved.line_count(), 2);
+  EXPECT_EQ(moved.line(1), "a");
+  EXPECT_EQ(moved.line(2), "b");
+}
+
+TEST(FileUtilTest, MappedModeFallsBackForEmptyFile) {
+  TempFile tmp("mapped_empty_test_");
+  ASSERT_TRUE(tmp.valid());
+
+  File file(std::string(tmp.path()), FileSourceMode::kMapped);
+  EXPECT_FALSE(file.is_mapped());
+  EXPECT_TRUE(file.source().empty());
+}
+
+#if IS_LINUX
+TEST(FileUtilTest, ReadFileFromPipe) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  std::thread writer([fd = fds[1]] {
+    const std::string payload(100000, 'x');
+    std::size_t written = 0;
+    while (written < payload.size()) {
+      ssize_t n =
+          write(fd, payload.data() + written, payload.size() - written);
+      if (n <= 0) {
+        break;
+      }
+      written += static_cast<std::size_t>(n);
+    }
+    close(fd);
+  });
+
+  const std::string path = "/proc/self/fd/" + std::to_string(fds[0]);
+  File file(std::string(path), FileSourceMode::kMapped);
+  writer.join();
+  close(fds[0]);
+
+  EXPECT_FALSE(file.is_mapped());
+  EXPECT_EQ(file.source().size(), 100000);
+}
+#endif  // IS_LINUX
+
 }  // namespace core
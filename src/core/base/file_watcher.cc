@@ -0,0 +1,191 @@
+#include "core/base/file_watcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/file_util.h"
+#include "core/base/logger.h"
+
+#if IS_LINUX
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+
+#if IS_LINUX
+// a finished in-place write, or a file renamed over the watched name.
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO;
+constexpr std::size_t kEventBufferSize = 64 * 1024;
+// settling ends after this many settle periods even if events keep coming,
+// e.g. from unrelated files written in a watched directory.
+constexpr int kMaxSettlePeriods = 20;
+#endif
+
+}  // namespace
+
+FileWatcher::FileWatcher() {
+#if IS_LINUX
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ < 0) {
+    glog.error_ref<"failed to create an inotify instance ({})\n">(
+        std::strerror(errno));
+    glog.flush();
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#if IS_LINUX
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+#endif
+}
+
+int FileWatcher::add(const std::string& path, uint64_t tag) {
+#if IS_LINUX
+  if (fd_ < 0) {
+    return -1;
+  }
+  std::string directory = parent_dir(path);
+  if (directory.empty()) {
+    directory = ".";
+  }
+  // the same directory always yields the same watch descriptor.
+  const int wd = inotify_add_watch(fd_, directory.c_str(), kWatchMask);
+  if (wd < 0) {
+    glog.error_ref<"failed to watch {} ({})\n">(directory,
+                                                 std::strerror(errno));
+    glog.flush();
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint64_t>& tags = watches_[wd][base_name(path)];
+  if (std::find(tags.begin(), tags.end(), tag) == tags.end()) {
+    tags.push_back(tag);
+  }
+  return 0;
+#else
+  (void)path;
+  (void)tag;
+  return -1;
+#endif
+}
+
+bool FileWatcher::read_events(std::vector<uint64_t>* changed,
+                              std::unordered_set<uint64_t>* seen) {
+#if IS_LINUX
+  auto report = [changed, seen](uint64_t tag) {
+    if (seen->insert(tag).second) {
+      changed->push_back(tag);
+    }
+  };
+
+  alignas(struct inotify_event) char buffer[kEventBufferSize];
+  bool any = false;
+  while (true) {
+    const ssize_t bytes = read(fd_, buffer, sizeof(buffer));
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0 && errno != EAGAIN) {
+      glog.error_ref<"failed to read file change events ({})\n">(
+          std::strerror(errno));
+      glog.flush();
+      return false;
+    }
+    if (bytes <= 0) {
+      // the queue is empty.
+      return any;
+    }
+    any = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (ssize_t pos = 0; pos < bytes;) {
+      const auto* event =
+          reinterpret_cast<const struct inotify_event*>(buffer + pos);
+      pos += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+      if (event->mask & IN_Q_OVERFLOW) {
+        // events were dropped; any watched file may have changed.
+        for (const auto& [wd, files] : watches_) {
+          for (const auto& [name, tags] : files) {
+            for (uint64_t tag : tags) {
+              report(tag);
+            }
+          }
+        }
+        continue;
+      }
+      if (event->len == 0) {
+        continue;
+      }
+      auto dir = watches_.find(event->wd);
+      if (dir == watches_.end()) {
+        continue;
+      }
+      auto file = dir->second.find(event->name);
+      if (file == dir->second.end()) {
+        continue;
+      }
+      for (uint64_t tag : file->second) {
+        report(tag);
+      }
+    }
+  }
+#else
+  (void)changed;
+  (void)seen;
+  return false;
+#endif
+}
+
+std::vector<uint64_t> FileWatcher::poll(std::chrono::milliseconds timeout,
+                                        std::chrono::milliseconds settle) {
+  std::vector<uint64_t> changed;
+#if IS_LINUX
+  if (fd_ < 0) {
+    return changed;
+  }
+  std::unordered_set<uint64_t> seen;
+  struct pollfd pfd = {fd_, POLLIN, 0};
+  if (!read_events(&changed, &seen)) {
+    if (timeout.count() <= 0 ||
+        ::poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0 ||
+        !read_events(&changed, &seen)) {
+      return changed;
+    }
+  }
+  // an editor saving several times, or a build rewriting a file in steps,
+  // produces a burst; wait for it to end.
+  const auto deadline =
+      std::chrono::steady_clock::now() + settle * kMaxSettlePeriods;
+  while (settle.count() > 0) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0 ||
+        ::poll(&pfd, 1, static_cast<int>(std::min(settle, left).count())) <=
+            0) {
+      break;
+    }
+    read_events(&changed, &seen);
+  }
+#else
+  (void)timeout;
+  (void)settle;
+#endif
+  return changed;
+}
+
+}  // namespace core
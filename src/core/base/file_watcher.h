@@ -0,0 +1,65 @@
+#ifndef CORE_BASE_FILE_WATCHER_H_
+#define CORE_BASE_FILE_WATCHER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+// reports files that were rewritten on disk. on linux the parent directory of
+// every watched file is registered with inotify, so saves that replace the
+// file (write to a temp name, then rename) are seen as well as in-place
+// writes. elsewhere the watcher is never valid. `add` may be called from any
+// thread, also while another one polls.
+class CORE_EXPORT FileWatcher {
+ public:
+  FileWatcher();
+
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  FileWatcher(FileWatcher&&) = delete;
+  FileWatcher& operator=(FileWatcher&&) = delete;
+
+  inline bool valid() const { return fd_ >= 0; }
+
+  // watches `path` and reports its changes as `tag`. returns 0 on success and
+  // -1 if the directory of `path` cannot be watched.
+  int add(const std::string& path, uint64_t tag);
+
+  // waits up to `timeout` for a change, then keeps collecting events until
+  // none arrived for `settle`, so a burst of writes is reported once, but for
+  // no more than 20 times `settle`. returns the tags of changed files in the
+  // order they first changed, each once. if events were lost, every watched
+  // file is reported as changed.
+  [[nodiscard]] std::vector<uint64_t> poll(
+      std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+      std::chrono::milliseconds settle = std::chrono::milliseconds(50));
+
+ private:
+  // drains every queued event into `changed`, skipping tags already in
+  // `seen`; false if there were none or reading them failed. if the kernel
+  // queue overflowed, every watched file is reported.
+  bool read_events(std::vector<uint64_t>* changed,
+                   std::unordered_set<uint64_t>* seen);
+
+  using TagsByName = std::unordered_map<std::string, std::vector<uint64_t>>;
+
+  int fd_ = -1;
+  std::mutex mutex_;
+  // watch descriptor of a directory to the tags of its files, by name.
+  std::unordered_map<int, TagsByName> watches_;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_FILE_WATCHER_H_
@@ -0,0 +1,172 @@
+#include "core/base/gzip_reader.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "core/base/logger.h"
+
+namespace core {
+
+namespace {
+
+// gzread counts in unsigned ints and returns an int.
+constexpr std::size_t kMaxReadSize = INT_MAX;
+
+}  // namespace
+
+GzipReader::GzipReader(const char* path, std::size_t buffer_size) {
+  file_ = gzopen(path, "rb");
+  if (!file_) {
+    glog.error_ref<"failed to open file: {} ({})\n">(path,
+                                                     std::strerror(errno));
+    glog.flush();
+    eof_ = true;
+    return;
+  }
+
+  buffer_size = std::max<std::size_t>(buffer_size, 64);
+  // zlib's own input buffer; larger buffers mean fewer read syscalls.
+  gzbuffer(file_, static_cast<unsigned int>(
+                      std::min<std::size_t>(buffer_size, kMaxReadSize)));
+  buffer_.resize(buffer_size);
+}
+
+GzipReader::~GzipReader() {
+  if (file_) {
+    gzclose(file_);
+  }
+}
+
+std::ptrdiff_t GzipReader::read(char* buffer, std::size_t size) {
+  const std::size_t buffered = std::min(size, end_ - begin_);
+  std::memcpy(buffer, buffer_.data() + begin_, buffered);
+  begin_ += buffered;
+
+  const std::ptrdiff_t bytes = read_stream(buffer + buffered, size - buffered);
+  if (bytes < 0) {
+    // the bytes stored so far first; the next call reports the error.
+    return buffered > 0 ? static_cast<std::ptrdiff_t>(buffered) : -1;
+  }
+  return static_cast<std::ptrdiff_t>(buffered) + bytes;
+}
+
+std::ptrdiff_t GzipReader::read_stream(char* buffer, std::size_t size) {
+  if (failed_) {
+    return -1;
+  }
+  std::size_t total_read = 0;
+  while (total_read < size && !eof_) {
+    const int bytes =
+        gzread(file_, buffer + total_read,
+               static_cast<unsigned int>(
+                   std::min(size - total_read, kMaxReadSize)));
+    if (bytes <= 0) {
+      // a truncated stream ends with 0 and Z_BUF_ERROR rather than -1.
+      int code = Z_OK;
+      const char* message = gzerror(file_, &code);
+      eof_ = true;
+      if (bytes == 0 && code == Z_OK) {
+        break;
+      }
+      glog.error_ref<"failed to decompress file ({})\n">(message);
+      glog.flush();
+      failed_ = true;
+      // what was decompressed before the error is still good.
+      return total_read > 0 ? static_cast<std::ptrdiff_t>(total_read) : -1;
+    }
+    total_read += static_cast<std::size_t>(bytes);
+  }
+  return static_cast<std::ptrdiff_t>(total_read);
+}
+
+bool GzipReader::fill() {
+  if (eof_) {
+    return false;
+  }
+
+  const std::size_t pending = end_ - begin_;
+  std::memmove(buffer_.data(), buffer_.data() + begin_, pending);
+  begin_ = 0;
+  end_ = pending;
+  if (end_ == buffer_.size()) {
+    // a line longer than the buffer.
+    buffer_.resize(buffer_.size() * 2);
+  }
+
+  const std::ptrdiff_t bytes =
+      read_stream(buffer_.data() + end_, buffer_.size() - end_);
+  if (bytes <= 0) {
+    return false;
+  }
+  end_ += static_cast<std::size_t>(bytes);
+  return true;
+}
+
+bool GzipReader::next(std::string_view* line) {
+  std::size_t search_from = begin_;
+  while (true) {
+    const char* start = buffer_.data() + begin_;
+    const char* newline = static_cast<const char*>(std::memchr(
+        buffer_.data() + search_from, '\n', end_ - search_from));
+    if (newline) {
+      std::string_view piece(start, static_cast<std::size_t>(newline - start));
+      begin_ = static_cast<std::size_t>(newline - buffer_.data()) + 1;
+
+      // crlf
+      if (!piece.empty() && piece.back() == '\r') {
+        piece.remove_suffix(1);
+      }
+      *line = piece;
+      ++line_number_;
+      return true;
+    }
+
+    const std::size_t scanned = end_ - begin_;
+    if (!fill()) {
+      break;
+    }
+    // `fill` moved the pending bytes to the front; skip what was searched.
+    search_from = begin_ + scanned;
+  }
+
+  if (begin_ == end_) {
+    return false;
+  }
+
+  // last line without a trailing newline.
+  std::string_view piece(buffer_.data() + begin_, end_ - begin_);
+  begin_ = end_;
+  if (piece.back() == '\r') {
+    piece.remove_suffix(1);
+  }
+  *line = piece;
+  ++line_number_;
+  return true;
+}
+
+std::string GzipReader::read_all() {
+  std::string content(buffer_.data() + begin_, end_ - begin_);
+  begin_ = end_;
+
+  std::size_t size = content.size();
+  while (!eof_) {
+    content.resize(std::max<std::size_t>(size * 2, buffer_.size()));
+    const std::ptrdiff_t bytes = read(content.data() + size,
+                                      content.size() - size);
+    if (bytes < 0) {
+      break;
+    }
+    size += static_cast<std::size_t>(bytes);
+  }
+  content.resize(size);
+  return content;
+}
+
+}  // namespace core
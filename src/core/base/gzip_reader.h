@@ -0,0 +1,70 @@
+#ifndef CORE_BASE_GZIP_READER_H_
+#define CORE_BASE_GZIP_READER_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "core/base/core_export.h"
+
+// zlib's opaque handle, so that users do not need zlib.h.
+struct gzFile_s;
+
+namespace core {
+
+// streams the decompressed content of a gzip file (concatenated members and
+// plain, uncompressed files included) without writing it to disk. lines are
+// split exactly like `read_lines`; `read_all` produces a source for `File`.
+class CORE_EXPORT GzipReader {
+ public:
+  static constexpr std::size_t kDefaultBufferSize = 256 * 1024;
+
+  explicit GzipReader(const char* path,
+                      std::size_t buffer_size = kDefaultBufferSize);
+
+  ~GzipReader();
+
+  GzipReader(const GzipReader&) = delete;
+  GzipReader& operator=(const GzipReader&) = delete;
+
+  GzipReader(GzipReader&&) = delete;
+  GzipReader& operator=(GzipReader&&) = delete;
+
+  inline bool valid() const { return file_ != nullptr; }
+  // true once a read failed on corrupt or truncated data.
+  inline bool failed() const { return failed_; }
+
+  // decompresses up to `size` bytes into `buffer`. returns the number of
+  // bytes stored, 0 at the end of the stream or -1 on error. bytes decoded
+  // before an error are returned first, and the error on the next call.
+  std::ptrdiff_t read(char* buffer, std::size_t size);
+
+  // stores the next line in `line` and returns true, or returns false at the
+  // end of the stream. `line` stays valid until the next call.
+  bool next(std::string_view* line);
+
+  // 1 indexed number of the line last returned by `next`.
+  inline std::size_t line_number() const { return line_number_; }
+
+  // decompresses everything that has not been consumed yet.
+  [[nodiscard]] std::string read_all();
+
+ private:
+  // moves the unconsumed bytes to the front of the buffer and appends more
+  // decompressed data. returns false at the end of the stream.
+  bool fill();
+  // reads from the gzip stream only, bypassing `buffer_`.
+  std::ptrdiff_t read_stream(char* buffer, std::size_t size);
+
+  gzFile_s* file_ = nullptr;
+  std::string buffer_;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+  bool eof_ = false;
+  bool failed_ = false;
+  std::size_t line_number_ = 0;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_GZIP_READER_H_
@@ -0,0 +1,125 @@
+#include "core/base/gzip_reader.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+namespace {
+
+std::string gzip(std::string_view content) {
+  CompressOptions options;
+  options.thread_count = 2;
+  options.block_size = 32 * 1024;
+  std::vector<std::byte> compressed;
+  EXPECT_EQ(
+      compress_buffer(
+          std::as_bytes(std::span<const char>(content.data(), content.size())),
+          &compressed, options),
+      0);
+  return std::string(reinterpret_cast<const char*>(compressed.data()),
+                     compressed.size());
+}
+
+std::vector<std::string> read_all_lines(const std::string& path,
+                                        std::size_t buffer_size) {
+  std::vector<std::string> lines;
+  GzipReader reader(path.c_str(), buffer_size);
+  std::string_view line;
+  while (reader.next(&line)) {
+    lines.emplace_back(line);
+    EXPECT_EQ(reader.line_number(), lines.size());
+  }
+  EXPECT_FALSE(reader.failed());
+  return lines;
+}
+
+}  // namespace
+
+TEST(GzipReaderTest, LinesMatchReadLines) {
+  std::string content;
+  for (std::size_t i = 0; i < 20000; ++i) {
+    content.append(i % 97, static_cast<char>('a' + i % 26));
+    content.append(i % 3 == 0 ? "\r\n" : "\n");
+  }
+  const std::string variants[] = {content, content + "unterminated\r", ""};
+
+  for (const std::string& variant : variants) {
+    TempFile tmp("gzip_reader_test_", gzip(variant));
+    ASSERT_TRUE(tmp.valid());
+    const std::vector<std::string> expected = read_lines<false>(variant);
+
+    // small buffers force lines to straddle refills.
+    for (std::size_t buffer_size : {64, 4096, 1 << 20}) {
+      EXPECT_EQ(read_all_lines(tmp.path(), buffer_size), expected)
+          << "buffer size: " << buffer_size;
+    }
+
+    GzipReader reader(tmp.path().c_str());
+    File file(std::string(tmp.path()), reader.read_all());
+    EXPECT_EQ(file.source(), variant);
+  }
+}
+
+TEST(GzipReaderTest, ReadsConcatenatedMembersAndPlainFiles) {
+  TempFile members("gzip_reader_test_", gzip("first\n") + gzip("second\n"));
+  EXPECT_EQ(read_all_lines(members.path(), 64),
+            (std::vector<std::string>{"first", "second"}));
+
+  TempFile plain("gzip_reader_test_", "not compressed\n");
+  EXPECT_EQ(GzipReader(plain.path().c_str()).read_all(), "not compressed\n");
+}
+
+TEST(GzipReaderTest, ReadMixesWithLines) {
+  TempFile tmp("gzip_reader_test_", gzip("head\nbody bytes"));
+  GzipReader reader(tmp.path().c_str());
+  std::string_view line;
+  ASSERT_TRUE(reader.next(&line));
+  EXPECT_EQ(line, "head");
+
+  char buffer[4];
+  ASSERT_EQ(reader.read(buffer, sizeof(buffer)), 4);
+  EXPECT_EQ(std::string_view(buffer, 4), "body");
+  EXPECT_EQ(reader.read_all(), " bytes");
+  EXPECT_EQ(reader.read(buffer, sizeof(buffer)), 0);
+}
+
+TEST(GzipReaderTest, ReportsCorruptAndMissingFiles) {
+  std::string truncated = gzip(std::string(100000, 'x'));
+  truncated.resize(truncated.size() / 2);
+  TempFile tmp("gzip_reader_test_", truncated);
+  GzipReader reader(tmp.path().c_str());
+  EXPECT_TRUE(reader.valid());
+  (void)reader.read_all();
+  EXPECT_TRUE(reader.failed());
+
+  // bytes decoded before the corruption are handed out before the error.
+  std::string varied;
+  for (std::size_t i = 0; varied.size() < 200000; ++i) {
+    varied += std::to_string(i * 2654435761u);
+  }
+  std::string cut = gzip(varied);
+  cut.resize(cut.size() / 2);
+  TempFile partial("gzip_reader_test_", cut);
+  GzipReader cut_reader(partial.path().c_str());
+  std::string buffer(varied.size(), '\0');
+  const std::ptrdiff_t bytes = cut_reader.read(buffer.data(), buffer.size());
+  ASSERT_GT(bytes, 0);
+  EXPECT_EQ(buffer.substr(0, static_cast<std::size_t>(bytes)),
+            varied.substr(0, static_cast<std::size_t>(bytes)));
+  EXPECT_TRUE(cut_reader.failed());
+  EXPECT_EQ(cut_reader.read(buffer.data(), buffer.size()), -1);
+
+  GzipReader missing("/nonexistent/gzip_reader_test.gz");
+  std::string_view line;
+  EXPECT_FALSE(missing.valid());
+  EXPECT_FALSE(missing.next(&line));
+}
+
+}  // namespace core
@@ -0,0 +1,513 @@
+#include "core/base/hash.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/cpu_features.h"
+#include "core/base/file_util.h"
+#include "core/base/logger.h"
+#include "core/base/mapped_file.h"
+#include "core/base/parallel.h"
+
+#if COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+#if ARCH_X64 || ARCH_X86
+#include <immintrin.h>
+#endif  // ARCH_X64 || ARCH_X86
+
+namespace core {
+
+namespace {
+
+constexpr uint64_t kSecret[4] = {
+    0xa0761d6478bd642full,
+    0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull,
+};
+
+// full 64 x 64 -> 128-bit product; low half in `a`, high half in `b`.
+inline void multiply(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  const __uint128_t product = static_cast<__uint128_t>(*a) * *b;
+  *a = static_cast<uint64_t>(product);
+  *b = static_cast<uint64_t>(product >> 64);
+#elif COMPILER_MSVC && defined(_M_X64)
+  *a = _umul128(*a, *b, b);
+#else
+  const uint64_t ha = *a >> 32, hb = *b >> 32;
+  const uint64_t la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+  const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const uint64_t t = rl + (rm0 << 32);
+  uint64_t carry = t < rl;
+  const uint64_t lo = t + (rm1 << 32);
+  carry += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b) {
+  multiply(&a, &b);
+  return a ^ b;
+}
+
+// unaligned little-endian loads; memcpy compiles to a single mov.
+inline uint64_t read64(const unsigned char* p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint64_t read32(const unsigned char* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// 1 to 3 bytes, reading the first, middle and last.
+inline uint64_t read_small(const unsigned char* p, std::size_t size) {
+  return (static_cast<uint64_t>(p[0]) << 16) |
+         (static_cast<uint64_t>(p[size >> 1]) << 8) | p[size - 1];
+}
+
+constexpr uint64_t kPrime32_1 = 0x9e3779b1ull;
+constexpr uint64_t kPrime32_2 = 0x85ebca77ull;
+constexpr uint64_t kPrime32_3 = 0xc2b2ae3dull;
+constexpr uint64_t kPrime64_1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t kPrime64_2 = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t kPrime64_3 = 0x165667b19e3779f9ull;
+constexpr uint64_t kPrime64_4 = 0x85ebca77c2b2ae63ull;
+constexpr uint64_t kPrime64_5 = 0x27d4eb2f165667c5ull;
+
+constexpr std::size_t kStripeSize = Hasher::kStripeSize;
+constexpr std::size_t kBlockSize = Hasher::kBlockSize;
+constexpr std::size_t kStripesPerBlock = kBlockSize / kStripeSize;
+
+// the long-input key: stripe i of a block uses words [i, i + 8), the scramble
+// after each block the last eight words. the final stripe and the two merges
+// read the key at other offsets.
+constexpr std::size_t kSecretWords = kStripesPerBlock + 8;
+constexpr std::size_t kScrambleOffset = kStripesPerBlock;
+constexpr std::size_t kLastStripeOffset = 7;
+constexpr std::size_t kMergeLowOffset = 11;
+constexpr std::size_t kMergeHighOffset = 3;
+
+constexpr std::array<uint64_t, kSecretWords> make_long_secret() {
+  // splitmix64 seeded from the short-input secret.
+  std::array<uint64_t, kSecretWords> secret = {};
+  uint64_t state = kSecret[0];
+  for (uint64_t& word : secret) {
+    state += 0x9e3779b97f4a7c15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    word = z ^ (z >> 31);
+  }
+  return secret;
+}
+
+constexpr std::array<uint64_t, kSecretWords> kLongSecret = make_long_secret();
+
+uint64_t hash_short(const unsigned char* p, std::size_t size, uint64_t seed) {
+  seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (size <= 16) {
+    if (size >= 4) {
+      // two overlapping pairs of 4-byte reads cover 4 to 16 bytes.
+      const std::size_t shift = (size >> 3) << 2;
+      a = (read32(p) << 32) | read32(p + shift);
+      b = (read32(p + size - 4) << 32) | read32(p + size - 4 - shift);
+    } else if (size > 0) {
+      a = read_small(p, size);
+    }
+  } else {
+    std::size_t remaining = size;
+    if (remaining > 48) {
+      uint64_t lane1 = seed;
+      uint64_t lane2 = seed;
+      do {
+        seed = mix(read64(p) ^ kSecret[1], read64(p + 8) ^ seed);
+        lane1 = mix(read64(p + 16) ^ kSecret[2], read64(p + 24) ^ lane1);
+        lane2 = mix(read64(p + 32) ^ kSecret[3], read64(p + 40) ^ lane2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (remaining > 16) {
+      seed = mix(read64(p) ^ kSecret[1], read64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    // the last 16 bytes, overlapping what was already mixed if need be.
+    a = read64(p + remaining - 16);
+    b = read64(p + remaining - 8);
+  }
+
+  a ^= kSecret[1];
+  b ^= seed;
+  multiply(&a, &b);
+  return mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+void init_accumulators(uint64_t* accumulators, uint64_t seed) {
+  static constexpr uint64_t kInit[8] = {
+      kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+      kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1,
+  };
+  for (std::size_t i = 0; i < 8; ++i) {
+    accumulators[i] = (i % 2 == 0) ? kInit[i] + seed : kInit[i] - seed;
+  }
+}
+
+// folds the high bits back in after every block, so that products of the
+// low halves keep depending on the whole input.
+void scramble(uint64_t* accumulators) {
+  const uint64_t* key = kLongSecret.data() + kScrambleOffset;
+  for (std::size_t i = 0; i < 8; ++i) {
+    uint64_t value = accumulators[i];
+    value ^= value >> 47;
+    value ^= key[i];
+    accumulators[i] = value * kPrime32_1;
+  }
+}
+
+uint64_t avalanche(uint64_t value) {
+  value ^= value >> 37;
+  value *= 0x165667919e3779f9ull;
+  return value ^ (value >> 32);
+}
+
+uint64_t merge(const uint64_t* accumulators,
+               std::size_t key_offset,
+               uint64_t start) {
+  const uint64_t* key = kLongSecret.data() + key_offset;
+  uint64_t result = start;
+  for (std::size_t i = 0; i < 8; i += 2) {
+    result += mix(accumulators[i] ^ key[i], accumulators[i + 1] ^ key[i + 1]);
+  }
+  return avalanche(result);
+}
+
+uint64_t merge_low(const uint64_t* accumulators, uint64_t size) {
+  return merge(accumulators, kMergeLowOffset, size * kPrime64_1);
+}
+
+uint64_t merge_high(const uint64_t* accumulators, uint64_t size) {
+  return merge(accumulators, kMergeHighOffset, ~(size * kPrime64_2));
+}
+
+// every full 64-byte stripe before the last byte, then the last 64 bytes,
+// which may overlap the stripes already added. `size` is above one block.
+void hash_long(const unsigned char* p,
+               std::size_t size,
+               uint64_t seed,
+               uint64_t* accumulators) {
+  const HashAccumulateFn accumulate = hash_kernels().accumulate;
+  init_accumulators(accumulators, seed);
+  const std::size_t stripes = (size - 1) / kStripeSize;
+  const std::size_t blocks = stripes / kStripesPerBlock;
+  for (std::size_t block = 0; block < blocks; ++block) {
+    accumulate(accumulators, p + block * kBlockSize, kStripesPerBlock,
+               kLongSecret.data());
+    scramble(accumulators);
+  }
+  accumulate(accumulators, p + blocks * kBlockSize,
+             stripes % kStripesPerBlock, kLongSecret.data());
+  accumulate(accumulators, p + size - kStripeSize, 1,
+             kLongSecret.data() + kLastStripeOffset);
+}
+
+Hash128 hash128_short(const unsigned char* p,
+                      std::size_t size,
+                      uint64_t seed) {
+  return Hash128{hash_short(p, size, seed),
+                 hash_short(p, size, seed + kPrime64_2)};
+}
+
+uint64_t hash_any(const unsigned char* p, std::size_t size, uint64_t seed) {
+  if (size <= kBlockSize) {
+    return hash_short(p, size, seed);
+  }
+  uint64_t accumulators[8];
+  hash_long(p, size, seed, accumulators);
+  return merge_low(accumulators, size);
+}
+
+Hash128 hash128_any(const unsigned char* p, std::size_t size, uint64_t seed) {
+  if (size <= kBlockSize) {
+    return hash128_short(p, size, seed);
+  }
+  uint64_t accumulators[8];
+  hash_long(p, size, seed, accumulators);
+  return Hash128{merge_low(accumulators, size),
+                 merge_high(accumulators, size)};
+}
+
+HashKernels select_hash_kernels() {
+#if ARCH_X64 || ARCH_X86
+  const CpuFeatures& features = cpu_features();
+  if (features.avx2) {
+    return {hash_accumulate_avx2, "avx2"};
+  }
+  if (features.sse2) {
+    return {hash_accumulate_sse2, "sse2"};
+  }
+#endif  // ARCH_X64 || ARCH_X86
+  return {hash_accumulate_scalar, "scalar"};
+}
+
+const unsigned char* bytes_of(std::string_view data) {
+  return reinterpret_cast<const unsigned char*>(data.data());
+}
+
+const unsigned char* bytes_of(std::span<const std::byte> data) {
+  return reinterpret_cast<const unsigned char*>(data.data());
+}
+
+constexpr std::size_t kTreeBlockSize = std::size_t{4} << 20;
+
+}  // namespace
+
+// each lane adds the product of the low and high halves of its keyed input
+// and the unkeyed input of its neighbour.
+void hash_accumulate_scalar(uint64_t* accumulators,
+                            const unsigned char* data,
+                            std::size_t stripes,
+                            const uint64_t* secret) {
+  for (std::size_t s = 0; s < stripes; ++s) {
+    const unsigned char* p = data + s * kStripeSize;
+    const uint64_t* key = secret + s;
+    for (std::size_t i = 0; i < 8; ++i) {
+      const uint64_t value = read64(p + 8 * i);
+      const uint64_t keyed = value ^ key[i];
+      accumulators[i ^ 1] += value;
+      accumulators[i] += (keyed & 0xffffffffull) * (keyed >> 32);
+    }
+  }
+}
+
+#if ARCH_X64 || ARCH_X86
+
+TARGET_ISA("sse2")
+void hash_accumulate_sse2(uint64_t* accumulators,
+                          const unsigned char* data,
+                          std::size_t stripes,
+                          const uint64_t* secret) {
+  auto* acc = reinterpret_cast<__m128i*>(accumulators);
+  __m128i lanes[4];
+  for (std::size_t i = 0; i < 4; ++i) {
+    lanes[i] = _mm_loadu_si128(acc + i);
+  }
+  for (std::size_t s = 0; s < stripes; ++s) {
+    const auto* p =
+        reinterpret_cast<const __m128i*>(data + s * kStripeSize);
+    const auto* key = reinterpret_cast<const __m128i*>(secret + s);
+    for (std::size_t i = 0; i < 4; ++i) {
+      const __m128i value = _mm_loadu_si128(p + i);
+      const __m128i keyed = _mm_xor_si128(value, _mm_loadu_si128(key + i));
+      const __m128i product =
+          _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+      // swap the two 64-bit words to add each into its neighbour.
+      const __m128i swapped = _mm_shuffle_epi32(value, 0x4e);
+      lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+    }
+  }
+  for (std::size_t i = 0; i < 4; ++i) {
+    _mm_storeu_si128(acc + i, lanes[i]);
+  }
+}
+
+TARGET_ISA("avx2")
+void hash_accumulate_avx2(uint64_t* accumulators,
+                          const unsigned char* data,
+                          std::size_t stripes,
+                          const uint64_t* secret) {
+  auto* acc = reinterpret_cast<__m256i*>(accumulators);
+  __m256i low = _mm256_loadu_si256(acc);
+  __m256i high = _mm256_loadu_si256(acc + 1);
+  for (std::size_t s = 0; s < stripes; ++s) {
+    const auto* p =
+        reinterpret_cast<const __m256i*>(data + s * kStripeSize);
+    const auto* key = reinterpret_cast<const __m256i*>(secret + s);
+    const __m256i value_low = _mm256_loadu_si256(p);
+    const __m256i value_high = _mm256_loadu_si256(p + 1);
+    const __m256i keyed_low =
+        _mm256_xor_si256(value_low, _mm256_loadu_si256(key));
+    const __m256i keyed_high =
+        _mm256_xor_si256(value_high, _mm256_loadu_si256(key + 1));
+    // the shuffle swaps 64-bit words within each 128-bit half, like sse2.
+    low = _mm256_add_epi64(
+        low, _mm256_add_epi64(
+                 _mm256_mul_epu32(keyed_low, _mm256_srli_epi64(keyed_low, 32)),
+                 _mm256_shuffle_epi32(value_low, 0x4e)));
+    high = _mm256_add_epi64(
+        high,
+        _mm256_add_epi64(
+            _mm256_mul_epu32(keyed_high, _mm256_srli_epi64(keyed_high, 32)),
+            _mm256_shuffle_epi32(value_high, 0x4e)));
+  }
+  _mm256_storeu_si256(acc, low);
+  _mm256_storeu_si256(acc + 1, high);
+}
+
+#endif  // ARCH_X64 || ARCH_X86
+
+const HashKernels& hash_kernels() {
+  static const HashKernels kernels = select_hash_kernels();
+  return kernels;
+}
+
+uint64_t hash_bytes(std::string_view data, uint64_t seed) {
+  return hash_any(bytes_of(data), data.size(), seed);
+}
+
+uint64_t hash_bytes(std::span<const std::byte> data, uint64_t seed) {
+  return hash_any(bytes_of(data), data.size(), seed);
+}
+
+Hash128 hash128_bytes(std::string_view data, uint64_t seed) {
+  return hash128_any(bytes_of(data), data.size(), seed);
+}
+
+Hash128 hash128_bytes(std::span<const std::byte> data, uint64_t seed) {
+  return hash128_any(bytes_of(data), data.size(), seed);
+}
+
+Hasher::Hasher(uint64_t seed) : seed_(seed) {
+  init_accumulators(accumulators_, seed_);
+}
+
+void Hasher::reset() {
+  total_size_ = 0;
+  buffered_ = 0;
+  init_accumulators(accumulators_, seed_);
+}
+
+void Hasher::update(std::string_view data) {
+  update(std::as_bytes(std::span<const char>(data.data(), data.size())));
+}
+
+void Hasher::update(std::span<const std::byte> data) {
+  const unsigned char* p = bytes_of(data);
+  std::size_t size = data.size();
+  total_size_ += size;
+
+  // a block is only consumed once more input follows it, since the last
+  // stripe of the whole input is keyed differently.
+  const HashAccumulateFn accumulate = hash_kernels().accumulate;
+  auto consume = [&](const unsigned char* block) {
+    accumulate(accumulators_, block, kStripesPerBlock, kLongSecret.data());
+    scramble(accumulators_);
+    std::memcpy(last_stripe_, block + kBlockSize - kStripeSize, kStripeSize);
+  };
+  while (size > 0) {
+    if (buffered_ == kBlockSize) {
+      consume(buffer_);
+      buffered_ = 0;
+    }
+    if (buffered_ == 0) {
+      // whole blocks straight from the input, without copying.
+      while (size > kBlockSize) {
+        consume(p);
+        p += kBlockSize;
+        size -= kBlockSize;
+      }
+    }
+    const std::size_t take = std::min(kBlockSize - buffered_, size);
+    std::memcpy(buffer_ + buffered_, p, take);
+    buffered_ += take;
+    p += take;
+    size -= take;
+  }
+}
+
+uint64_t Hasher::digest() const {
+  if (total_size_ <= kBlockSize) {
+    return hash_short(buffer_, buffered_, seed_);
+  }
+  uint64_t accumulators[8];
+  std::memcpy(accumulators, accumulators_, sizeof(accumulators));
+  finish(accumulators);
+  return merge_low(accumulators, total_size_);
+}
+
+Hash128 Hasher::digest128() const {
+  if (total_size_ <= kBlockSize) {
+    return hash128_short(buffer_, buffered_, seed_);
+  }
+  uint64_t accumulators[8];
+  std::memcpy(accumulators, accumulators_, sizeof(accumulators));
+  finish(accumulators);
+  return Hash128{merge_low(accumulators, total_size_),
+                 merge_high(accumulators, total_size_)};
+}
+
+void Hasher::finish(uint64_t* accumulators) const {
+  // the buffer holds 1 to `kBlockSize` bytes here.
+  const HashAccumulateFn accumulate = hash_kernels().accumulate;
+  accumulate(accumulators, buffer_, (buffered_ - 1) / kStripeSize,
+             kLongSecret.data());
+  unsigned char last[kStripeSize];
+  const unsigned char* last_stripe = buffer_ + buffered_ - kStripeSize;
+  if (buffered_ < kStripeSize) {
+    const std::size_t carried = kStripeSize - buffered_;
+    std::memcpy(last, last_stripe_ + kStripeSize - carried, carried);
+    std::memcpy(last + carried, buffer_, buffered_);
+    last_stripe = last;
+  }
+  accumulate(accumulators, last_stripe, 1,
+             kLongSecret.data() + kLastStripeOffset);
+}
+
+Hash128 hash128_tree(std::string_view data, std::size_t thread_count) {
+  // block i is hashed with seed i so that reordered blocks hash differently;
+  // the block hashes are then hashed with the size as seed.
+  const std::size_t blocks =
+      std::max<std::size_t>(1, (data.size() + kTreeBlockSize - 1) /
+                                   kTreeBlockSize);
+  std::vector<Hash128> block_hashes(blocks);
+  parallel_for(
+      blocks, thread_count == 0 ? default_thread_count() : thread_count,
+      [&](std::size_t i) {
+        block_hashes[i] =
+            hash128_bytes(data.substr(i * kTreeBlockSize, kTreeBlockSize), i);
+      });
+  return hash128_bytes(std::as_bytes(std::span<const Hash128>(block_hashes)),
+                       data.size());
+}
+
+bool hash_file(const char* path, Hash128* out, std::size_t thread_count) {
+  const MappedFile mapping(path);
+  std::string content;
+  std::string_view data;
+  if (mapping.valid()) {
+    data = mapping.view();
+  } else {
+    // empty or not mappable.
+    if (!file_exists(path)) {
+      glog.error_ref<"cannot hash {}: not a regular file\n">(path);
+      glog.flush();
+      return false;
+    }
+    content = read_file(path);
+    data = content;
+  }
+  *out = hash128_tree(data, thread_count);
+  return true;
+}
+
+}  // namespace core
@@ -0,0 +1,121 @@
+#ifndef CORE_BASE_HASH_H_
+#define CORE_BASE_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "build/build_flag.h"
+#include "core/base/core_export.h"
+
+namespace core {
+
+struct Hash128 {
+  uint64_t low = 0;
+  uint64_t high = 0;
+
+  bool operator==(const Hash128&) const = default;
+};
+
+// fast non-cryptographic hashes in the style of wyhash (short inputs) and
+// xxh3 (long inputs): good enough to key caches, detect changed content and
+// deduplicate, never for security. inputs up to 1 KiB go through three
+// independent multiply-mix lanes; longer ones through eight accumulators fed
+// 64-byte stripes by a simd kernel. results are stable across runs and
+// kernels but depend on the byte order of the host.
+[[nodiscard]] CORE_EXPORT uint64_t hash_bytes(std::string_view data,
+                                              uint64_t seed = 0);
+[[nodiscard]] CORE_EXPORT uint64_t hash_bytes(std::span<const std::byte> data,
+                                              uint64_t seed = 0);
+[[nodiscard]] CORE_EXPORT Hash128 hash128_bytes(std::string_view data,
+                                                uint64_t seed = 0);
+[[nodiscard]] CORE_EXPORT Hash128 hash128_bytes(
+    std::span<const std::byte> data,
+    uint64_t seed = 0);
+
+// incremental `hash_bytes` / `hash128_bytes`: feeding the input in chunks of
+// any size gives the same result as hashing it in one piece.
+class CORE_EXPORT Hasher {
+ public:
+  explicit Hasher(uint64_t seed = 0);
+
+  ~Hasher() = default;
+
+  Hasher(const Hasher&) = default;
+  Hasher& operator=(const Hasher&) = default;
+
+  void update(std::string_view data);
+  void update(std::span<const std::byte> data);
+
+  // the hash of everything so far; more input may follow.
+  [[nodiscard]] uint64_t digest() const;
+  [[nodiscard]] Hash128 digest128() const;
+
+  void reset();
+
+  static constexpr std::size_t kStripeSize = 64;
+  static constexpr std::size_t kBlockSize = 16 * kStripeSize;
+
+ private:
+  // adds the buffered tail and the final stripe to `accumulators`.
+  void finish(uint64_t* accumulators) const;
+
+  uint64_t seed_;
+  uint64_t total_size_ = 0;
+  uint64_t accumulators_[8];
+  std::size_t buffered_ = 0;
+  // the current block, and the end of the previous one for the final stripe
+  // when the current block holds less than a stripe.
+  unsigned char buffer_[kBlockSize];
+  unsigned char last_stripe_[kStripeSize];
+};
+
+// hashes `data` in 4 MiB blocks on up to `thread_count` threads (0 uses
+// `default_thread_count()`) and combines the block hashes. this tree hash
+// does not equal `hash128_bytes(data)`, but it does not depend on the thread
+// count.
+[[nodiscard]] CORE_EXPORT Hash128 hash128_tree(std::string_view data,
+                                               std::size_t thread_count = 0);
+
+// `hash128_tree` of the content of the file at `path`. returns false if the
+// file cannot be read.
+CORE_EXPORT bool hash_file(const char* path,
+                           Hash128* out,
+                           std::size_t thread_count = 0);
+
+// adds `stripes` 64-byte stripes at `data` into eight accumulators, stripe i
+// keyed with `secret + i`. the simd kernels must only be called if
+// `cpu_features()` reports support; all of them give the same result.
+using HashAccumulateFn = void (*)(uint64_t* accumulators,
+                                  const unsigned char* data,
+                                  std::size_t stripes,
+                                  const uint64_t* secret);
+
+CORE_EXPORT void hash_accumulate_scalar(uint64_t* accumulators,
+                                        const unsigned char* data,
+                                        std::size_t stripes,
+                                        const uint64_t* secret);
+
+#if ARCH_X64 || ARCH_X86
+CORE_EXPORT void hash_accumulate_sse2(uint64_t* accumulators,
+                                      const unsigned char* data,
+                                      std::size_t stripes,
+                                      const uint64_t* secret);
+CORE_EXPORT void hash_accumulate_avx2(uint64_t* accumulators,
+                                      const unsigned char* data,
+                                      std::size_t stripes,
+                                      const uint64_t* secret);
+#endif  // ARCH_X64 || ARCH_X86
+
+struct HashKernels {
+  HashAccumulateFn accumulate;
+  const char* name;
+};
+
+// the fastest kernel for the running cpu, bound once on first use.
+[[nodiscard]] CORE_EXPORT const HashKernels& hash_kernels();
+
+}  // namespace core
+
+#endif  // CORE_BASE_HASH_H_
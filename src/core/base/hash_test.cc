@@ -0,0 +1,143 @@
+#include "core/base/hash.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/cpu_features.h"
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+namespace {
+
+std::string make_input(std::size_t size) {
+  std::string input(size, '\0');
+  uint64_t state = 0x1234567;
+  for (char& c : input) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    c = static_cast<char>(state >> 56);
+  }
+  return input;
+}
+
+}  // namespace
+
+TEST(HashTest, SizesSeedsAndOverloadsAgree) {
+  const std::string input = make_input(5000);
+  const std::size_t sizes[] = {0,    1,    3,    4,    16,   17,   48,  49,
+                               1023, 1024, 1025, 1087, 1088, 2048, 2049, 5000};
+  std::vector<uint64_t> seen;
+  for (std::size_t size : sizes) {
+    const std::string_view data(input.data(), size);
+    const auto bytes = std::as_bytes(std::span<const char>(data));
+    EXPECT_EQ(hash_bytes(data), hash_bytes(bytes));
+    EXPECT_EQ(hash128_bytes(data, 7), hash128_bytes(bytes, 7));
+    EXPECT_NE(hash_bytes(data, 1), hash_bytes(data, 2)) << "size: " << size;
+    EXPECT_NE(hash128_bytes(data).low, hash128_bytes(data).high);
+    seen.push_back(hash_bytes(data));
+  }
+  // every prefix hashes differently.
+  std::sort(seen.begin(), seen.end());
+  EXPECT_EQ(std::unique(seen.begin(), seen.end()), seen.end());
+
+  // a single flipped byte in a long input changes both halves.
+  std::string flipped = input;
+  flipped[3000] ^= 1;
+  EXPECT_NE(hash128_bytes(input).low, hash128_bytes(flipped).low);
+  EXPECT_NE(hash128_bytes(input).high, hash128_bytes(flipped).high);
+}
+
+TEST(HashTest, StreamingMatchesOneShot) {
+  const std::string input = make_input(9000);
+  const std::size_t sizes[] = {0, 5, 64, 1024, 1025, 1030, 2047, 2048,
+                               2049, 3100, 9000};
+  const std::size_t chunks[] = {1, 7, 63, 64, 1000, 1024, 1025, 4096};
+  for (std::size_t size : sizes) {
+    const std::string_view data(input.data(), size);
+    for (std::size_t chunk : chunks) {
+      Hasher hasher(42);
+      for (std::size_t pos = 0; pos < size; pos += chunk) {
+        hasher.update(data.substr(pos, chunk));
+      }
+      EXPECT_EQ(hasher.digest(), hash_bytes(data, 42))
+          << "size: " << size << " chunk: " << chunk;
+      EXPECT_EQ(hasher.digest128(), hash128_bytes(data, 42))
+          << "size: " << size << " chunk: " << chunk;
+    }
+  }
+
+  Hasher hasher;
+  hasher.update(input);
+  hasher.reset();
+  hasher.update(std::string_view("abc"));
+  EXPECT_EQ(hasher.digest(), hash_bytes("abc"));
+}
+
+TEST(HashTest, KernelsMatchScalar) {
+  std::vector<HashAccumulateFn> kernels;
+#if ARCH_X64 || ARCH_X86
+  const CpuFeatures& features = cpu_features();
+  if (features.sse2) {
+    kernels.push_back(hash_accumulate_sse2);
+  }
+  if (features.avx2) {
+    kernels.push_back(hash_accumulate_avx2);
+  }
+#endif  // ARCH_X64 || ARCH_X86
+
+  const std::string input = make_input(16 * 64);
+  const auto* data = reinterpret_cast<const unsigned char*>(input.data());
+  const std::vector<uint64_t> secret = [] {
+    std::vector<uint64_t> words(24);
+    for (std::size_t i = 0; i < words.size(); ++i) {
+      words[i] = 0x9e3779b97f4a7c15ull * (i + 1);
+    }
+    return words;
+  }();
+  for (std::size_t stripes = 0; stripes <= 16; ++stripes) {
+    uint64_t expected[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    hash_accumulate_scalar(expected, data, stripes, secret.data());
+    for (HashAccumulateFn kernel : kernels) {
+      uint64_t found[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+      kernel(found, data, stripes, secret.data());
+      EXPECT_TRUE(std::equal(found, found + 8, expected))
+          << "stripes: " << stripes;
+    }
+  }
+}
+
+TEST(HashTest, FileHashIgnoresThreadCount) {
+  // just over two 4 MiB blocks.
+  const std::string content = make_input((std::size_t{8} << 20) + 100);
+  TempFile file("hash_file_", content);
+  ASSERT_TRUE(file.valid());
+
+  Hash128 serial;
+  Hash128 parallel;
+  ASSERT_TRUE(hash_file(file.path().c_str(), &serial, 1));
+  ASSERT_TRUE(hash_file(file.path().c_str(), &parallel, 4));
+  EXPECT_EQ(serial, parallel);
+
+  std::string changed = content;
+  changed[5 << 20] ^= 1;
+  TempFile other("hash_file_", changed);
+  Hash128 changed_hash;
+  ASSERT_TRUE(hash_file(other.path().c_str(), &changed_hash, 4));
+  EXPECT_NE(serial, changed_hash);
+
+  TempFile empty("hash_file_", "");
+  Hash128 empty_hash;
+  EXPECT_TRUE(hash_file(empty.path().c_str(), &empty_hash));
+
+  Hash128 missing;
+  EXPECT_FALSE(hash_file((file.path() + ".missing").c_str(), &missing));
+}
+
+}  // namespace core
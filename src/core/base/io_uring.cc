@@ -0,0 +1,313 @@
+#include "core/base/io_uring.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "build/build_flag.h"
+
+#if IS_LINUX
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#endif  // IS_LINUX
+
+namespace core {
+
+#if IS_LINUX
+
+namespace {
+
+int sys_io_uring_setup(unsigned int entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int ring_fd,
+                       unsigned int to_submit,
+                       unsigned int min_complete,
+                       unsigned int flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+inline unsigned int load_acquire(unsigned int* p) {
+  return std::atomic_ref<unsigned int>(*p).load(std::memory_order_acquire);
+}
+
+inline void store_release(unsigned int* p, unsigned int value) {
+  std::atomic_ref<unsigned int>(*p).store(value, std::memory_order_release);
+}
+
+template <typename T>
+inline T* at_offset(void* base, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+}  // namespace
+
+IoUring::IoUring(unsigned int entries) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  int fd = sys_io_uring_setup(entries, &params);
+  if (fd < 0) {
+    return;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ =
+        sq_ring_size_ > cq_ring_size_ ? sq_ring_size_ : cq_ring_size_;
+  }
+
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    close(fd);
+    return;
+  }
+
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      cq_ring_ = nullptr;
+      munmap(sq_ring_, sq_ring_size_);
+      sq_ring_ = nullptr;
+      close(fd);
+      return;
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    sqes_ = nullptr;
+    if (cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = cq_ring_ = nullptr;
+    close(fd);
+    return;
+  }
+
+  sq_head_ = at_offset<unsigned int>(sq_ring_, params.sq_off.head);
+  sq_tail_ = at_offset<unsigned int>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = at_offset<unsigned int>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = at_offset<unsigned int>(sq_ring_, params.sq_off.array);
+  cq_head_ = at_offset<unsigned int>(cq_ring_, params.cq_off.head);
+  cq_tail_ = at_offset<unsigned int>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = at_offset<unsigned int>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = at_offset<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+  local_sq_tail_ = *sq_tail_;
+  sq_entries_ = params.sq_entries;
+  ring_fd_ = fd;
+}
+
+IoUring::~IoUring() {
+  if (!valid()) {
+    return;
+  }
+  munmap(sqes_, sqes_size_);
+  if (cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  munmap(sq_ring_, sq_ring_size_);
+  close(ring_fd_);
+}
+
+void* IoUring::next_sqe() {
+  if (!valid() || local_sq_tail_ - load_acquire(sq_head_) >= sq_entries_) {
+    return nullptr;
+  }
+
+  const unsigned int index = local_sq_tail_ & *sq_mask_;
+  io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  ++local_sq_tail_;
+  return sqe;
+}
+
+bool IoUring::prepare_openat(const char* path, int flags, uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(next_sqe());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = reinterpret_cast<uint64_t>(path);
+  sqe->open_flags = static_cast<uint32_t>(flags);
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::prepare_read(int fd,
+                           void* buffer,
+                           uint32_t length,
+                           uint64_t offset,
+                           uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(next_sqe());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(buffer);
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::prepare_close(int fd, uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(next_sqe());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+  return true;
+}
+
+bool IoUring::prepare_statx(const char* path,
+                            int flags,
+                            unsigned int mask,
+                            void* statx_buffer,
+                            uint64_t user_data) {
+  auto* sqe = static_cast<io_uring_sqe*>(next_sqe());
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_STATX;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = reinterpret_cast<uint64_t>(path);
+  sqe->len = mask;
+  sqe->off = reinterpret_cast<uint64_t>(statx_buffer);
+  sqe->statx_flags = static_cast<uint32_t>(flags);
+  sqe->user_data = user_data;
+  return true;
+}
+
+int IoUring::submit(unsigned int min_complete) {
+  if (!valid()) {
+    return -EINVAL;
+  }
+
+  // entries a failed call left unconsumed are submitted again.
+  const unsigned int to_submit = local_sq_tail_ - load_acquire(sq_head_);
+  store_release(sq_tail_, local_sq_tail_);
+
+  const unsigned int flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  int submitted;
+  do {
+    submitted = sys_io_uring_enter(ring_fd_, to_submit, min_complete, flags);
+  } while (submitted < 0 && errno == EINTR);
+
+  if (submitted < 0) {
+    return -errno;
+  }
+  in_flight_ += static_cast<std::size_t>(submitted);
+  return submitted;
+}
+
+int IoUring::wait(unsigned int min_complete) {
+  if (!valid()) {
+    return -EINVAL;
+  }
+
+  int result;
+  do {
+    result = sys_io_uring_enter(ring_fd_, 0, min_complete,
+                                IORING_ENTER_GETEVENTS);
+  } while (result < 0 && errno == EINTR);
+  return result < 0 ? -errno : 0;
+}
+
+void IoUring::discard_unsubmitted() {
+  if (!valid()) {
+    return;
+  }
+  // without SQPOLL the kernel only consumes entries inside io_uring_enter, so
+  // the tail can be rewound.
+  local_sq_tail_ = load_acquire(sq_head_);
+  store_release(sq_tail_, local_sq_tail_);
+}
+
+std::size_t IoUring::reap(IoCompletion* out, std::size_t max) {
+  if (!valid()) {
+    return 0;
+  }
+
+  unsigned int head = *cq_head_;
+  const unsigned int tail = load_acquire(cq_tail_);
+  std::size_t count = 0;
+  const auto* cqes = static_cast<const io_uring_cqe*>(cqes_);
+  while (head != tail && count < max) {
+    const io_uring_cqe& cqe = cqes[head & *cq_mask_];
+    out[count++] = IoCompletion{cqe.user_data, cqe.res};
+    ++head;
+  }
+  store_release(cq_head_, head);
+  in_flight_ -= count;
+  return count;
+}
+
+#else
+
+IoUring::IoUring(unsigned int) {}
+
+IoUring::~IoUring() = default;
+
+void* IoUring::next_sqe() {
+  return nullptr;
+}
+
+bool IoUring::prepare_openat(const char*, int, uint64_t) {
+  return false;
+}
+
+bool IoUring::prepare_read(int, void*, uint32_t, uint64_t, uint64_t) {
+  return false;
+}
+
+bool IoUring::prepare_close(int, uint64_t) {
+  return false;
+}
+
+bool IoUring::prepare_statx(const char*, int, unsigned int, void*, uint64_t) {
+  return false;
+}
+
+int IoUring::submit(unsigned int) {
+  return -1;
+}
+
+int IoUring::wait(unsigned int) {
+  return -1;
+}
+
+void IoUring::discard_unsubmitted() {}
+
+std::size_t IoUring::reap(IoCompletion*, std::size_t) {
+  return 0;
+}
+
+#endif  // IS_LINUX
+
+}  // namespace core
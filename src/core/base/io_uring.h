@@ -0,0 +1,146 @@
+#ifndef CORE_BASE_IO_URING_H_
+#define CORE_BASE_IO_URING_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "core/base/core_export.h"
+#include "core/check.h"
+
+namespace core {
+
+struct IoCompletion {
+  uint64_t user_data;
+  // bytes transferred / new fd on success, -errno on failure.
+  int32_t result;
+};
+
+// minimal io_uring wrapper over the raw syscalls (no liburing dependency).
+// only linux provides io_uring; elsewhere, or when the kernel refuses to set
+// up a ring (old kernel, seccomp, ...), the object is invalid and every
+// `prepare_*` call returns false so that callers take their fallback path.
+class CORE_EXPORT IoUring {
+ public:
+  explicit IoUring(unsigned int entries);
+
+  ~IoUring();
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  IoUring(IoUring&&) = delete;
+  IoUring& operator=(IoUring&&) = delete;
+
+  inline bool valid() const { return ring_fd_ >= 0; }
+  inline unsigned int capacity() const { return sq_entries_; }
+  inline std::size_t in_flight() const { return in_flight_; }
+
+  // each returns false if the submission queue is full or the ring is invalid.
+  bool prepare_openat(const char* path, int flags, uint64_t user_data);
+  bool prepare_read(int fd,
+                    void* buffer,
+                    uint32_t length,
+                    uint64_t offset,
+                    uint64_t user_data);
+  bool prepare_close(int fd, uint64_t user_data);
+  // `statx_buffer` points to a `struct statx` that must stay alive until the
+  // completion is reaped.
+  bool prepare_statx(const char* path,
+                     int flags,
+                     unsigned int mask,
+                     void* statx_buffer,
+                     uint64_t user_data);
+
+  // submits every prepared entry and blocks until at least `min_complete`
+  // completions are available. returns the number of entries submitted, or
+  // -errno.
+  int submit(unsigned int min_complete = 0);
+
+  // blocks until at least `min_complete` completions are available without
+  // submitting anything. returns 0 or -errno.
+  int wait(unsigned int min_complete);
+
+  // drops the prepared entries that the kernel has not consumed yet.
+  void discard_unsubmitted();
+
+  // moves up to `max` available completions into `out` and returns how many
+  // were written.
+  std::size_t reap(IoCompletion* out, std::size_t max);
+
+ private:
+  void* next_sqe();
+
+  int ring_fd_ = -1;
+  unsigned int sq_entries_ = 0;
+  std::size_t in_flight_ = 0;
+
+  void* sq_ring_ = nullptr;
+  void* cq_ring_ = nullptr;
+  void* sqes_ = nullptr;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  std::size_t sqes_size_ = 0;
+
+  unsigned int* sq_head_ = nullptr;
+  unsigned int* sq_tail_ = nullptr;
+  unsigned int* sq_mask_ = nullptr;
+  unsigned int* sq_array_ = nullptr;
+  unsigned int* cq_head_ = nullptr;
+  unsigned int* cq_tail_ = nullptr;
+  unsigned int* cq_mask_ = nullptr;
+  void* cqes_ = nullptr;
+
+  // tail including entries that were prepared but not yet submitted.
+  unsigned int local_sq_tail_ = 0;
+};
+
+inline constexpr std::size_t kReapBatch = 64;
+
+// submits the prepared entries of `ring` and feeds `count` completions to
+// `fn`. returns false if a submission failed.
+template <typename F>
+bool complete_all(IoUring* ring, std::size_t count, const F& fn) {
+  if (ring->submit(static_cast<unsigned int>(count)) < 0) {
+    return false;
+  }
+
+  IoCompletion completions[kReapBatch];
+  std::size_t done = 0;
+  while (done < count) {
+    std::size_t reaped = ring->reap(completions, kReapBatch);
+    if (reaped == 0) {
+      if (ring->submit(1) < 0) {
+        return false;
+      }
+      continue;
+    }
+    for (std::size_t i = 0; i < reaped; ++i) {
+      fn(completions[i]);
+    }
+    done += reaped;
+  }
+  return true;
+}
+
+// cleans up after a failed `complete_all`: drops the entries that were never
+// submitted and feeds the completions of those still in flight to `fn`, so
+// that no buffer is freed under a pending operation.
+template <typename F>
+void drain_all(IoUring* ring, const F& fn) {
+  ring->discard_unsubmitted();
+  IoCompletion completions[kReapBatch];
+  while (ring->in_flight() > 0) {
+    const std::size_t reaped = ring->reap(completions, kReapBatch);
+    for (std::size_t i = 0; i < reaped; ++i) {
+      fn(completions[i]);
+    }
+    if (reaped == 0) {
+      // waiting without submitting only fails on a broken ring.
+      CHECK_EQ(ring->wait(1), 0);
+    }
+  }
+}
+
+}  // namespace core
+
+#endif  // CORE_BASE_IO_URING_H_
@@ -0,0 +1,132 @@
+#include "core/base/line_index.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace core {
+
+namespace {
+
+// number of entries in [0, count) below `value`, for ascending entries.
+// the loop has a fixed trip count and no data-dependent branch.
+template <typename Get>
+inline std::size_t count_below(std::size_t count,
+                               std::size_t value,
+                               const Get& get) {
+  if (count == 0) {
+    return 0;
+  }
+  std::size_t base = 0;
+  while (count > 1) {
+    const std::size_t half = count / 2;
+    base = get(base + half) < value ? base + half : base;
+    count -= half;
+  }
+  return base + (get(base) < value ? 1 : 0);
+}
+
+}  // namespace
+
+LineIndex::LineIndex(const std::vector<std::size_t>& line_ends,
+                     std::size_t source_size)
+    : size_(line_ends.size()) {
+  constexpr std::size_t kNarrowMax = std::numeric_limits<uint32_t>::max();
+
+  owned_checkpoints_.reserve((size_ + kBlockSize - 1) / kBlockSize);
+
+  // offsets never exceed the source size (the last one may equal it).
+  if (source_size <= kNarrowMax) {
+    encoding_ = Encoding::kNarrow;
+    owned_narrow_.assign(line_ends.begin(), line_ends.end());
+    for (std::size_t i = 0; i < size_; i += kBlockSize) {
+      owned_checkpoints_.push_back(line_ends[i]);
+    }
+  } else {
+    encoding_ = Encoding::kBlockDelta;
+    owned_narrow_.reserve(size_);
+    for (std::size_t i = 0; i < size_; ++i) {
+      if ((i & (kBlockSize - 1)) == 0) {
+        owned_checkpoints_.push_back(line_ends[i]);
+      }
+      const std::size_t delta = line_ends[i] - owned_checkpoints_.back();
+      if (delta > kNarrowMax) {
+        break;
+      }
+      owned_narrow_.push_back(static_cast<uint32_t>(delta));
+    }
+
+    if (owned_narrow_.size() != size_) {
+      // a block spans 4 GiB or more; fall back to full-width offsets.
+      encoding_ = Encoding::kWide;
+      std::vector<uint32_t>().swap(owned_narrow_);
+      owned_checkpoints_.clear();
+      for (std::size_t i = 0; i < size_; i += kBlockSize) {
+        owned_checkpoints_.push_back(line_ends[i]);
+      }
+      owned_wide_.assign(line_ends.begin(), line_ends.end());
+    }
+  }
+
+  narrow_ = owned_narrow_;
+  checkpoints_ = owned_checkpoints_;
+  wide_ = owned_wide_;
+}
+
+LineIndex LineIndex::borrow(Encoding encoding,
+                            std::size_t size,
+                            std::span<const uint32_t> narrow,
+                            std::span<const uint64_t> checkpoints,
+                            std::span<const uint64_t> wide) {
+  DCHECK_EQ(checkpoints.size(), (size + kBlockSize - 1) / kBlockSize);
+  DCHECK_EQ(encoding == Encoding::kWide ? wide.size() : narrow.size(), size);
+  LineIndex index;
+  index.encoding_ = encoding;
+  index.size_ = size;
+  index.narrow_ = narrow;
+  index.checkpoints_ = checkpoints;
+  index.wide_ = wide;
+  return index;
+}
+
+std::size_t LineIndex::lower_bound(std::size_t value) const {
+  const std::size_t blocks_below =
+      count_below(checkpoints_.size(), value,
+                  [this](std::size_t i) { return checkpoints_[i]; });
+  if (blocks_below == 0) {
+    return 0;
+  }
+
+  // the answer lies in the last block starting below `value`, or is the
+  // start of the next block.
+  const std::size_t first = (blocks_below - 1) * kBlockSize;
+  const std::size_t count =
+      (first + kBlockSize < size_ ? first + kBlockSize : size_) - first;
+  switch (encoding_) {
+    case Encoding::kNarrow:
+      return first + count_below(count, value, [&](std::size_t i) {
+               return static_cast<std::size_t>(narrow_[first + i]);
+             });
+    case Encoding::kBlockDelta: {
+      const std::size_t checkpoint = checkpoints_[blocks_below - 1];
+      return first + count_below(count, value, [&](std::size_t i) {
+               return checkpoint + narrow_[first + i];
+             });
+    }
+    case Encoding::kWide:
+      return first + count_below(count, value, [&](std::size_t i) {
+               return static_cast<std::size_t>(wide_[first + i]);
+             });
+  }
+  return size_;
+}
+
+std::size_t LineIndex::memory_usage() const {
+  return owned_narrow_.capacity() * sizeof(uint32_t) +
+         owned_checkpoints_.capacity() * sizeof(uint64_t) +
+         owned_wide_.capacity() * sizeof(uint64_t);
+}
+
+}  // namespace core
@@ -0,0 +1,101 @@
+#ifndef CORE_BASE_LINE_INDEX_H_
+#define CORE_BASE_LINE_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "core/base/core_export.h"
+#include "core/check.h"
+
+namespace core {
+
+// compact storage for the line end offsets of a `File`.
+//  - sources under 4 GiB store plain 32-bit offsets.
+//  - larger sources store one absolute 64-bit checkpoint per block of
+//    `kBlockSize` entries plus 32-bit deltas from that checkpoint.
+//  - if a single block spans 4 GiB or more (giant lines), 64-bit offsets.
+// every lookup is O(1). all encodings keep the first entry of each block as a
+// checkpoint, which doubles as a sampled top-level table for searches.
+// the arrays are either owned or borrowed from memory that outlives the
+// index, such as a mapped snapshot.
+class CORE_EXPORT LineIndex {
+ public:
+  enum class Encoding : uint8_t {
+    kNarrow = 0,
+    kBlockDelta = 1,
+    kWide = 2,
+  };
+
+  static constexpr std::size_t kBlockShift = 8;
+  static constexpr std::size_t kBlockSize = std::size_t{1} << kBlockShift;
+
+  LineIndex() = default;
+  LineIndex(const std::vector<std::size_t>& line_ends,
+            std::size_t source_size);
+
+  // an index over arrays laid out as `narrow_entries()` and friends return
+  // them. nothing is copied; the arrays must outlive the index.
+  [[nodiscard]] static LineIndex borrow(Encoding encoding,
+                                        std::size_t size,
+                                        std::span<const uint32_t> narrow,
+                                        std::span<const uint64_t> checkpoints,
+                                        std::span<const uint64_t> wide);
+
+  ~LineIndex() = default;
+
+  LineIndex(const LineIndex&) = delete;
+  LineIndex& operator=(const LineIndex&) = delete;
+
+  LineIndex(LineIndex&&) noexcept = default;
+  LineIndex& operator=(LineIndex&&) noexcept = default;
+
+  inline std::size_t operator[](std::size_t i) const {
+    DCHECK_LT(i, size_);
+    switch (encoding_) {
+      case Encoding::kNarrow: return narrow_[i];
+      case Encoding::kBlockDelta:
+        return checkpoints_[i >> kBlockShift] + narrow_[i];
+      case Encoding::kWide: return wide_[i];
+    }
+    return 0;
+  }
+
+  inline std::size_t size() const { return size_; }
+  inline bool empty() const { return size_ == 0; }
+
+  // index of the first entry >= `value`, or `size()` if there is none.
+  // a branchless search over the per-block checkpoints (small enough to stay
+  // in cache) narrows the range to one block, which is searched the same way.
+  [[nodiscard]] std::size_t lower_bound(std::size_t value) const;
+  inline Encoding encoding() const { return encoding_; }
+
+  // the raw arrays, for serialization.
+  inline std::span<const uint32_t> narrow_entries() const { return narrow_; }
+  inline std::span<const uint64_t> checkpoint_entries() const {
+    return checkpoints_;
+  }
+  inline std::span<const uint64_t> wide_entries() const { return wide_; }
+
+  // heap bytes held by the index; borrowed arrays are not counted.
+  [[nodiscard]] std::size_t memory_usage() const;
+
+ private:
+  // plain offsets (kNarrow) or deltas from the block checkpoint (kBlockDelta).
+  std::span<const uint32_t> narrow_;
+  // first entry of every block.
+  std::span<const uint64_t> checkpoints_;
+  std::span<const uint64_t> wide_;
+  // storage behind the spans unless borrowed. moving a vector keeps its
+  // buffer, so the spans survive moves of the index.
+  std::vector<uint32_t> owned_narrow_;
+  std::vector<uint64_t> owned_checkpoints_;
+  std::vector<uint64_t> owned_wide_;
+  std::size_t size_ = 0;
+  Encoding encoding_ = Encoding::kNarrow;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_LINE_INDEX_H_
@@ -0,0 +1,337 @@
+#include "core/base/line_index_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "core/base/file_stat.h"
+#include "core/base/file_util.h"
+#include "core/base/hash.h"
+#include "core/base/mapped_file.h"
+
+namespace core {
+
+namespace {
+
+// a header, the source path and the index arrays, each padded to 8 bytes,
+// in host byte order.
+constexpr char kSidecarMagic[8] = {'C', 'L', 'I', 'N', 'E', 'I', 'D', 'X'};
+constexpr uint32_t kSidecarVersion = 2;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr std::size_t kAlignment = 8;
+constexpr std::string_view kSidecarSuffix = ".lines";
+
+struct SidecarHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  // identity and content of the source the index was built from.
+  uint64_t device;
+  uint64_t inode;
+  uint64_t source_size;
+  int64_t mtime_ns;
+  uint64_t content_hash_low;
+  uint64_t content_hash_high;
+  // of the path and the index arrays.
+  uint64_t checksum;
+  uint64_t path_size;
+  uint64_t line_count;
+  uint64_t narrow_count;
+  uint64_t checkpoints_count;
+  uint64_t wide_count;
+  uint8_t encoding;
+  uint8_t reserved[7];
+};
+
+static_assert(sizeof(SidecarHeader) % kAlignment == 0);
+
+enum class SidecarState : uint8_t {
+  kFresh = 0,
+  kStale = 1,
+  kCorrupt = 2,
+};
+
+std::size_t align_up(std::size_t value) {
+  return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+template <typename T>
+std::string_view bytes_of(std::span<const T> values) {
+  return std::string_view(reinterpret_cast<const char*>(values.data()),
+                          values.size_bytes());
+}
+
+uint64_t checksum(std::string_view path, const LineIndex& index) {
+  Hasher hasher;
+  hasher.update(path);
+  hasher.update(bytes_of(index.narrow_entries()));
+  hasher.update(bytes_of(index.checkpoint_entries()));
+  hasher.update(bytes_of(index.wide_entries()));
+  return hasher.digest();
+}
+
+// checks the sidecar in `mapping` against the source, and borrows its index
+// into `index` if it matches. a null `content_hash` is not compared.
+SidecarState check_sidecar(const MappedFile& mapping,
+                           const std::string& path,
+                           std::string_view source,
+                           const FileStat& stat,
+                           const Hash128* content_hash,
+                           LineIndex* index) {
+  const char* const base = mapping.data();
+  const std::size_t size = mapping.size();
+  SidecarHeader header;
+  if (size < sizeof(header)) {
+    return SidecarState::kCorrupt;
+  }
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kSidecarMagic, sizeof(header.magic)) != 0 ||
+      header.version != kSidecarVersion ||
+      header.byte_order != kByteOrderMark) {
+    return SidecarState::kCorrupt;
+  }
+
+  const auto encoding = static_cast<LineIndex::Encoding>(header.encoding);
+  if (encoding != LineIndex::Encoding::kNarrow &&
+      encoding != LineIndex::Encoding::kBlockDelta &&
+      encoding != LineIndex::Encoding::kWide) {
+    return SidecarState::kCorrupt;
+  }
+  // bound every count first, so that the sizes below cannot overflow.
+  const uint64_t blocks = (header.line_count + LineIndex::kBlockSize - 1) /
+                          LineIndex::kBlockSize;
+  const bool wide = encoding == LineIndex::Encoding::kWide;
+  if (header.path_size > size || header.line_count > size ||
+      header.narrow_count > size || header.checkpoints_count > size ||
+      header.wide_count > size || header.checkpoints_count != blocks ||
+      (wide ? header.wide_count : header.narrow_count) != header.line_count) {
+    return SidecarState::kCorrupt;
+  }
+  const std::size_t path_offset = sizeof(header);
+  const std::size_t narrow_offset = path_offset + align_up(header.path_size);
+  const std::size_t checkpoints_offset =
+      narrow_offset + align_up(header.narrow_count * sizeof(uint32_t));
+  const std::size_t wide_offset =
+      checkpoints_offset + header.checkpoints_count * sizeof(uint64_t);
+  if (wide_offset + header.wide_count * sizeof(uint64_t) != size) {
+    return SidecarState::kCorrupt;
+  }
+
+  const std::string_view stored_path(base + path_offset, header.path_size);
+  LineIndex borrowed = LineIndex::borrow(
+      encoding, header.line_count,
+      std::span<const uint32_t>(
+          reinterpret_cast<const uint32_t*>(base + narrow_offset),
+          header.narrow_count),
+      std::span<const uint64_t>(
+          reinterpret_cast<const uint64_t*>(base + checkpoints_offset),
+          header.checkpoints_count),
+      std::span<const uint64_t>(
+          reinterpret_cast<const uint64_t*>(base + wide_offset),
+          header.wide_count));
+  if (checksum(stored_path, borrowed) != header.checksum) {
+    return SidecarState::kCorrupt;
+  }
+
+  // a sidecar of another path can only share the name through a collision
+  // of the path hashes; rebuild it like a stale one.
+  if (stored_path != path || header.device != stat.device ||
+      header.inode != stat.inode || header.source_size != source.size() ||
+      header.mtime_ns != stat.mtime_ns ||
+      (content_hash && (header.content_hash_low != content_hash->low ||
+                        header.content_hash_high != content_hash->high))) {
+    return SidecarState::kStale;
+  }
+  if (!borrowed.empty() && borrowed[borrowed.size() - 1] > source.size()) {
+    return SidecarState::kCorrupt;
+  }
+  *index = std::move(borrowed);
+  return SidecarState::kFresh;
+}
+
+int write_sidecar(const std::string& sidecar,
+                  const std::string& path,
+                  std::string_view source,
+                  const FileStat& stat,
+                  const Hash128& content_hash,
+                  const LineIndex& index) {
+  static constexpr char kZeros[kAlignment] = {};
+
+  SidecarHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kSidecarMagic, sizeof(header.magic));
+  header.version = kSidecarVersion;
+  header.byte_order = kByteOrderMark;
+  header.device = stat.device;
+  header.inode = stat.inode;
+  header.source_size = source.size();
+  header.mtime_ns = stat.mtime_ns;
+  header.content_hash_low = content_hash.low;
+  header.content_hash_high = content_hash.high;
+  header.checksum = checksum(path, index);
+  header.path_size = path.size();
+  header.line_count = index.size();
+  header.narrow_count = index.narrow_entries().size();
+  header.checkpoints_count = index.checkpoint_entries().size();
+  header.wide_count = index.wide_entries().size();
+  header.encoding = static_cast<uint8_t>(index.encoding());
+
+  const std::string_view narrow = bytes_of(index.narrow_entries());
+  const std::string_view pieces[] = {
+      std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)),
+      path,
+      std::string_view(kZeros, align_up(path.size()) - path.size()),
+      narrow,
+      std::string_view(kZeros, align_up(narrow.size()) - narrow.size()),
+      bytes_of(index.checkpoint_entries()),
+      bytes_of(index.wide_entries()),
+  };
+  return write_file_atomic(sidecar.c_str(), pieces, Durability::kNone);
+}
+
+}  // namespace
+
+LineIndexCache::LineIndexCache(LineIndexCacheOptions options)
+    : options_(std::move(options)),
+      directory_(options_.directory.empty()
+                     ? join_path(cache_directory(), "line_index")
+                     : options_.directory) {}
+
+std::string LineIndexCache::sidecar_path(const std::string& path) const {
+  std::string canonical = canonical_path(path);
+  return join_path(directory_,
+                   std::format("{:016x}{}",
+                               hash_bytes(canonical.empty() ? path : canonical),
+                               kSidecarSuffix));
+}
+
+LineIndex LineIndexCache::index(const std::string& path,
+                                std::string_view source,
+                                std::shared_ptr<const void>* owner) const {
+  if (source.size() < options_.min_source_size) {
+    return build_line_index(source);
+  }
+  // every spelling of a path, and every symlink to it, shares one sidecar.
+  const std::string canonical = canonical_path(path);
+  // a source that changed since it was read is not worth a sidecar.
+  const FileStat stat = stat_path(canonical.c_str());
+  if (canonical.empty() || !stat.is_regular() ||
+      stat.size != source.size()) {
+    return build_line_index(source);
+  }
+
+  std::optional<Hash128> content_hash;
+  if (options_.verify_content) {
+    content_hash = hash128_tree(source);
+  }
+  const std::string sidecar = join_path(
+      directory_,
+      std::format("{:016x}{}", hash_bytes(canonical), kSidecarSuffix));
+  auto mapping = std::make_shared<const MappedFile>(sidecar.c_str());
+  if (!mapping->valid()) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    LineIndex cached;
+    switch (check_sidecar(*mapping, canonical, source, stat,
+                          content_hash ? &*content_hash : nullptr, &cached)) {
+      case SidecarState::kFresh:
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        *owner = std::move(mapping);
+        return cached;
+      case SidecarState::kStale:
+        stale_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      case SidecarState::kCorrupt:
+        corrupt_.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+    // drop the mapping before the sidecar is replaced.
+    mapping.reset();
+  }
+
+  if (!content_hash) {
+    content_hash = hash128_tree(source);
+  }
+  LineIndex built = build_line_index(source);
+  (void)create_directories(directory_.c_str());
+  if (write_sidecar(sidecar, canonical, source, stat, *content_hash, built) ==
+      0) {
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    prune();
+  }
+  return built;
+}
+
+void LineIndexCache::prune() const {
+  const std::size_t limit = options_.max_directory_size;
+  if (limit == 0) {
+    return;
+  }
+  // one thread prunes for everyone.
+  std::unique_lock<std::mutex> lock(prune_mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  struct Sidecar {
+    int64_t mtime_ns;
+    uint64_t size;
+    std::string path;
+  };
+  std::vector<Sidecar> sidecars;
+  uint64_t total = 0;
+  for (const std::string& name : list_files(directory_)) {
+    // temp files of writes in flight end differently.
+    if (!name.ends_with(kSidecarSuffix)) {
+      continue;
+    }
+    std::string path = join_path(directory_, name);
+    const FileStat stat = stat_path(path.c_str());
+    if (!stat.is_regular()) {
+      continue;
+    }
+    total += stat.size;
+    sidecars.push_back(Sidecar{stat.mtime_ns, stat.size, std::move(path)});
+  }
+  if (total <= limit) {
+    return;
+  }
+
+  std::sort(sidecars.begin(), sidecars.end(),
+            [](const Sidecar& a, const Sidecar& b) {
+              return a.mtime_ns < b.mtime_ns;
+            });
+  for (const Sidecar& sidecar : sidecars) {
+    if (total <= limit) {
+      break;
+    }
+    // another process may have deleted or replaced it already.
+    if (remove_file(sidecar.path.c_str()) == 0) {
+      pruned_.fetch_add(1, std::memory_order_relaxed);
+    }
+    total -= sidecar.size;
+  }
+}
+
+LineIndexCacheStats LineIndexCache::stats() const {
+  LineIndexCacheStats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.stale = stale_.load(std::memory_order_relaxed);
+  stats.corrupt = corrupt_.load(std::memory_order_relaxed);
+  stats.writes = writes_.load(std::memory_order_relaxed);
+  stats.pruned = pruned_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace core
@@ -0,0 +1,97 @@
+#ifndef CORE_BASE_LINE_INDEX_CACHE_H_
+#define CORE_BASE_LINE_INDEX_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "core/base/core_export.h"
+#include "core/base/line_index.h"
+
+namespace core {
+
+struct LineIndexCacheOptions {
+  // where the sidecars go, named after a hash of the canonical source path.
+  // empty means `line_index` under `cache_directory()`.
+  std::string directory;
+  // smaller sources are cheaper to index than to verify; they skip the cache.
+  std::size_t min_source_size = std::size_t{1} << 20;
+  // also hash the source on every load to check it against the sidecar. the
+  // hash reads all of the source, like indexing it would, so a verified hit
+  // saves little. by default a hit trusts an unchanged device, inode, size
+  // and mtime, and costs no more than mapping the sidecar; it misses edits
+  // that keep all of them.
+  bool verify_content = false;
+  // bytes of sidecars to keep in `directory`. each write beyond it deletes
+  // the least recently written sidecars. 0 keeps everything.
+  std::size_t max_directory_size = std::size_t{512} << 20;
+};
+
+struct LineIndexCacheStats {
+  // indexes mapped from a sidecar that matched the source.
+  std::size_t hits = 0;
+  // sources without a sidecar.
+  std::size_t misses = 0;
+  // sidecars for an older size, mtime or content of the source.
+  std::size_t stale = 0;
+  // sidecars that were truncated, malformed or failed their checksum.
+  std::size_t corrupt = 0;
+  // sidecars written after indexing a source.
+  std::size_t writes = 0;
+  // sidecars deleted to keep the directory within its size.
+  std::size_t pruned = 0;
+};
+
+// persists line indexes in sidecar files, so that large sources that have
+// not changed are not scanned for newlines again on their next load. a
+// sidecar records the canonical path, identity (device, inode, size and
+// mtime) and content hash of its source and a checksum of the index; it is
+// only used when the path, identity and checksum match, and rewritten
+// otherwise. the content hash is only compared with `verify_content`.
+//
+// safe to share between threads. concurrent writers of one sidecar each
+// replace it atomically.
+class CORE_EXPORT LineIndexCache {
+ public:
+  explicit LineIndexCache(LineIndexCacheOptions options = {});
+
+  ~LineIndexCache() = default;
+
+  LineIndexCache(const LineIndexCache&) = delete;
+  LineIndexCache& operator=(const LineIndexCache&) = delete;
+
+  // the line index of `source`, the content of the file at `path`. either
+  // mapped from a matching sidecar, whose mapping is stored in `*owner` and
+  // must outlive the index, or built and stored in a new sidecar.
+  [[nodiscard]] LineIndex index(const std::string& path,
+                                std::string_view source,
+                                std::shared_ptr<const void>* owner) const;
+
+  [[nodiscard]] std::string sidecar_path(const std::string& path) const;
+
+  // deletes the least recently written sidecars until the directory holds at
+  // most `max_directory_size` bytes of them.
+  void prune() const;
+
+  [[nodiscard]] LineIndexCacheStats stats() const;
+
+ private:
+  const LineIndexCacheOptions options_;
+  // `options_.directory`, or its default.
+  const std::string directory_;
+
+  mutable std::atomic<std::size_t> hits_{0};
+  mutable std::atomic<std::size_t> misses_{0};
+  mutable std::atomic<std::size_t> stale_{0};
+  mutable std::atomic<std::size_t> corrupt_{0};
+  mutable std::atomic<std::size_t> writes_{0};
+  mutable std::atomic<std::size_t> pruned_{0};
+  mutable std::mutex prune_mutex_;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_LINE_INDEX_CACHE_H_
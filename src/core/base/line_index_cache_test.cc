@@ -0,0 +1,213 @@
+#include "core/base/line_index_cache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/base/file_manager.h"
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+namespace {
+
+std::string make_source(char fill) {
+  std::string source;
+  for (std::size_t i = 0; i < 3000; ++i) {
+    source.append(i % 50, fill);
+    source += "\n";
+  }
+  return source;
+}
+
+void expect_same_lines(const File& file, const std::string& source) {
+  const File expected(std::string("expected"), std::string(source));
+  ASSERT_EQ(file.line_count(), expected.line_count());
+  for (std::size_t line = 1; line <= expected.line_count(); ++line) {
+    ASSERT_EQ(file.line(line), expected.line(line)) << "line: " << line;
+  }
+}
+
+}  // namespace
+
+TEST(LineIndexCacheTest, SidecarIsReusedUntilTheSourceChanges) {
+  TempDir dir("line_index_cache_test_");
+  TempDir sidecars("line_index_cache_sidecars_");
+  ASSERT_TRUE(dir.valid());
+  ASSERT_TRUE(sidecars.valid());
+  const std::string path = join_path(dir.path(), "big.txt");
+  const std::string source = make_source('a');
+  ASSERT_EQ(write_file(path.c_str(), source), 0);
+
+  const LineIndexCache cache(LineIndexCacheOptions{sidecars.path(), 0, true});
+  const std::string sidecar = cache.sidecar_path(path);
+  {
+    const File first(std::string(path), FileSourceMode::kCopy, cache);
+    expect_same_lines(first, source);
+    EXPECT_EQ(cache.stats().misses, 1u);
+    EXPECT_EQ(cache.stats().writes, 1u);
+    EXPECT_TRUE(file_exists(sidecar.c_str()));
+  }
+  {
+    const File second(std::string(path), FileSourceMode::kMapped, cache);
+    expect_same_lines(second, source);
+    EXPECT_EQ(cache.stats().hits, 1u);
+    EXPECT_EQ(cache.stats().writes, 1u);
+  }
+
+  // same size, new mtime.
+  const std::string changed = make_source('b');
+  ASSERT_EQ(write_file(path.c_str(), changed), 0);
+  const auto mtime =
+      std::filesystem::last_write_time(path) + std::chrono::seconds(5);
+  std::filesystem::last_write_time(path, mtime);
+  {
+    const File third(std::string(path), FileSourceMode::kMapped, cache);
+    expect_same_lines(third, changed);
+    EXPECT_EQ(cache.stats().stale, 1u);
+    EXPECT_EQ(cache.stats().writes, 2u);
+  }
+
+  // same size and mtime; only the content hash tells.
+  std::string edited = changed;
+  edited.replace(0, 3, "b\n\n");
+  ASSERT_EQ(write_file(path.c_str(), edited), 0);
+  std::filesystem::last_write_time(path, mtime);
+  {
+    const File fourth(std::string(path), FileSourceMode::kCopy, cache);
+    expect_same_lines(fourth, edited);
+    EXPECT_EQ(cache.stats().stale, 2u);
+    EXPECT_EQ(cache.stats().hits, 1u);
+  }
+
+  // by default the identity is trusted, and another spelling of the path
+  // finds the same sidecar.
+  const LineIndexCache trusting(LineIndexCacheOptions{sidecars.path(), 0});
+  const std::string spelled = join_path(join_path(dir.path(), "."), "big.txt");
+  EXPECT_EQ(trusting.sidecar_path(spelled), sidecar);
+  {
+    const File fifth(std::string(spelled), FileSourceMode::kMapped, trusting);
+    expect_same_lines(fifth, edited);
+    EXPECT_EQ(trusting.stats().hits, 1u);
+    EXPECT_EQ(trusting.stats().writes, 0u);
+  }
+
+  EXPECT_EQ(remove_file(sidecar.c_str()), 0);
+  EXPECT_EQ(remove_file(path.c_str()), 0);
+}
+
+TEST(LineIndexCacheTest, CorruptSidecarIsRebuilt) {
+  TempDir dir("line_index_cache_test_");
+  TempDir sidecars("line_index_cache_sidecars_");
+  ASSERT_TRUE(dir.valid());
+  ASSERT_TRUE(sidecars.valid());
+  const std::string path = join_path(dir.path(), "big.txt");
+  const std::string source = make_source('c');
+  ASSERT_EQ(write_file(path.c_str(), source), 0);
+
+  const LineIndexCache cache(LineIndexCacheOptions{sidecars.path(), 0});
+  const std::string sidecar = cache.sidecar_path(path);
+  { const File first(std::string(path), FileSourceMode::kCopy, cache); }
+
+  // a flipped bit inside the index.
+  std::string bytes = read_file(sidecar.c_str());
+  bytes[bytes.size() - 100] ^= 0x10;
+  ASSERT_EQ(write_file(sidecar.c_str(), bytes), 0);
+  {
+    const File file(std::string(path), FileSourceMode::kCopy, cache);
+    expect_same_lines(file, source);
+    EXPECT_EQ(cache.stats().corrupt, 1u);
+  }
+
+  // truncated.
+  bytes = read_file(sidecar.c_str());
+  ASSERT_EQ(write_file(sidecar.c_str(), bytes.substr(0, bytes.size() / 2)), 0);
+  {
+    const File file(std::string(path), FileSourceMode::kMapped, cache);
+    expect_same_lines(file, source);
+    EXPECT_EQ(cache.stats().corrupt, 2u);
+  }
+
+  { const File file(std::string(path), FileSourceMode::kMapped, cache); }
+  EXPECT_EQ(cache.stats().hits, 1u);
+  EXPECT_EQ(cache.stats().writes, 3u);
+
+  EXPECT_EQ(remove_file(sidecar.c_str()), 0);
+  EXPECT_EQ(remove_file(path.c_str()), 0);
+}
+
+TEST(LineIndexCacheTest, FileManagerUsesTheCache) {
+  TempDir dir("line_index_cache_test_");
+  TempDir sidecars("line_index_cache_sidecars_");
+  ASSERT_TRUE(dir.valid());
+  ASSERT_TRUE(sidecars.valid());
+  const std::string path = join_path(dir.path(), "big.txt");
+  const std::string source = make_source('d');
+  ASSERT_EQ(write_file(path.c_str(), source), 0);
+
+  auto cache = std::make_shared<const LineIndexCache>(
+      LineIndexCacheOptions{sidecars.path(), 0});
+  FileManagerOptions options;
+  options.line_index_cache = cache;
+  {
+    FileManager manager(options);
+    expect_same_lines(*manager.file(manager.add_file(std::string(path))),
+                      source);
+  }
+  {
+    FileManager manager(options);
+    const FileId id =
+        manager.add_file(std::string(path), FileSourceMode::kMapped);
+    expect_same_lines(*manager.file(id), source);
+  }
+  EXPECT_EQ(cache->stats().writes, 1u);
+  EXPECT_EQ(cache->stats().hits, 1u);
+
+  const std::string sidecar = cache->sidecar_path(path);
+  EXPECT_EQ(sidecar.rfind(sidecars.path(), 0), 0u);
+  EXPECT_EQ(remove_file(sidecar.c_str()), 0);
+  EXPECT_EQ(remove_file(path.c_str()), 0);
+
+  // by default the sidecars live in the user's cache, not next to sources.
+  EXPECT_EQ(LineIndexCache().sidecar_path(path).rfind(cache_directory(), 0),
+            0u);
+}
+
+TEST(LineIndexCacheTest, OldestSidecarsArePruned) {
+  TempDir dir("line_index_cache_test_", TempStorage::kDisk, true);
+  TempDir sidecars("line_index_cache_sidecars_", TempStorage::kDisk, true);
+  ASSERT_TRUE(dir.valid());
+  ASSERT_TRUE(sidecars.valid());
+  std::vector<std::string> paths;
+  for (char fill : {'e', 'f', 'g'}) {
+    paths.push_back(join_path(dir.path(), std::string(1, fill) + ".txt"));
+    ASSERT_EQ(write_file(paths.back().c_str(), make_source(fill)), 0);
+  }
+
+  const LineIndexCache unbounded(LineIndexCacheOptions{sidecars.path(), 0});
+  { const File first(std::string(paths[0]), FileSourceMode::kCopy, unbounded); }
+  const std::string oldest = unbounded.sidecar_path(paths[0]);
+  ASSERT_TRUE(file_exists(oldest.c_str()));
+  const std::size_t sidecar_size = read_file(oldest.c_str()).size();
+  // mtimes can be coarser than the time between two writes.
+  std::filesystem::last_write_time(
+      oldest, std::filesystem::last_write_time(oldest) -
+                  std::chrono::seconds(10));
+
+  // room for two and a half sidecars of this size.
+  LineIndexCacheOptions options{sidecars.path(), 0};
+  options.max_directory_size = 2 * sidecar_size + sidecar_size / 2;
+  const LineIndexCache bounded(options);
+  { const File second(std::string(paths[1]), FileSourceMode::kCopy, bounded); }
+  EXPECT_EQ(bounded.stats().pruned, 0u);
+  { const File third(std::string(paths[2]), FileSourceMode::kCopy, bounded); }
+  EXPECT_EQ(bounded.stats().pruned, 1u);
+  EXPECT_FALSE(file_exists(oldest.c_str()));
+  EXPECT_TRUE(file_exists(bounded.sidecar_path(paths[1]).c_str()));
+  EXPECT_TRUE(file_exists(bounded.sidecar_path(paths[2]).c_str()));
+}
+
+}  // namespace core
@@ -0,0 +1,225 @@
+#include "core/base/line_reader.h"
+
+#include <fcntl.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+
+#include "build/build_flag.h"
+#include "core/base/byte_scan.h"
+#include "core/base/logger.h"
+
+#if IS_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+
+int open_for_reading(const char* path) {
+#if IS_WINDOWS
+  return _open(path, _O_RDONLY | _O_BINARY);
+#else
+  return open(path, O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+// fills up to `size` bytes, retrying short reads. returns -1 on error.
+std::ptrdiff_t read_fully(int fd, char* buffer, std::size_t size) {
+  std::size_t total_read = 0;
+  while (total_read < size) {
+#if IS_WINDOWS
+    int bytes = _read(fd, buffer + total_read,
+                      static_cast<unsigned int>(size - total_read));
+#else
+    ssize_t bytes = read(fd, buffer + total_read, size - total_read);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (bytes < 0) {
+      return -1;
+    }
+    if (bytes == 0) {
+      break;
+    }
+    total_read += static_cast<std::size_t>(bytes);
+  }
+  return static_cast<std::ptrdiff_t>(total_read);
+}
+
+}  // namespace
+
+LineReader::LineReader(const char* path, std::size_t chunk_size)
+    : chunk_size_(chunk_size == 0 ? kDefaultChunkSize : chunk_size) {
+  fd_ = open_for_reading(path);
+  if (fd_ < 0) {
+    glog.error_ref<"failed to open file: {} ({})\n">(path,
+                                                     std::strerror(errno));
+    glog.flush();
+    eof_ = true;
+    return;
+  }
+
+#if IS_LINUX
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  for (Chunk& chunk : chunks_) {
+    chunk.data.resize(chunk_size_);
+  }
+  newlines_.reserve(chunk_size_ / 64);
+  reader_ = std::thread(&LineReader::read_ahead, this);
+}
+
+LineReader::~LineReader() {
+  if (reader_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    chunk_free_.notify_all();
+    reader_.join();
+  }
+
+  if (fd_ >= 0) {
+#if IS_WINDOWS
+    _close(fd_);
+#else
+    close(fd_);
+#endif
+  }
+}
+
+void LineReader::read_ahead() {
+  for (std::size_t slot = 0;; slot ^= 1) {
+    Chunk& chunk = chunks_[slot];
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      chunk_free_.wait(lock, [&] { return stop_ || !chunk.full; });
+      if (stop_) {
+        return;
+      }
+    }
+
+    // the slot is free, so the consumer does not touch it while reading.
+    std::ptrdiff_t bytes = read_fully(fd_, chunk.data.data(), chunk_size_);
+    const bool error = bytes < 0;
+    if (error) {
+      glog.error_ref<"failed to read file ({})\n">(std::strerror(errno));
+      glog.flush();
+      bytes = 0;
+    }
+
+    const bool last = error || static_cast<std::size_t>(bytes) < chunk_size_;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      chunk.size = static_cast<std::size_t>(bytes);
+      chunk.last = last;
+      chunk.error = error;
+      chunk.full = true;
+    }
+    chunk_ready_.notify_one();
+
+    if (last) {
+      return;
+    }
+  }
+}
+
+void LineReader::acquire_chunk() {
+  Chunk& chunk = chunks_[next_slot_];
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    chunk_ready_.wait(lock, [&] { return chunk.full; });
+  }
+  next_slot_ ^= 1;
+  current_ = &chunk;
+
+  newlines_.clear();
+  byte_scan_kernels().find_newlines(chunk.data.data(), chunk.size, 0,
+                                    &newlines_);
+  newline_index_ = 0;
+  line_start_ = 0;
+}
+
+void LineReader::release_chunk() {
+  if (current_->last) {
+    eof_ = true;
+  }
+  if (current_->error) {
+    failed_ = true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_->full = false;
+  }
+  chunk_free_.notify_one();
+  current_ = nullptr;
+}
+
+bool LineReader::next(std::string_view* line) {
+  if (clear_carry_) {
+    carry_.clear();
+    clear_carry_ = false;
+  }
+
+  while (true) {
+    if (current_) {
+      if (newline_index_ < newlines_.size()) {
+        const std::size_t newline = newlines_[newline_index_++];
+        std::string_view piece(current_->data.data() + line_start_,
+                               newline - line_start_);
+        line_start_ = newline + 1;
+
+        if (!carry_.empty()) {
+          // the line started in an earlier chunk.
+          carry_.append(piece);
+          piece = carry_;
+          clear_carry_ = true;
+        }
+
+        // crlf
+        if (!piece.empty() && piece.back() == '\r') {
+          piece.remove_suffix(1);
+        }
+        *line = piece;
+        ++line_number_;
+        return true;
+      }
+
+      // keep the unterminated tail for the next chunk; the buffer goes back
+      // to the readahead thread.
+      carry_.append(current_->data.data() + line_start_,
+                    current_->size - line_start_);
+      release_chunk();
+    }
+
+    if (eof_) {
+      // after a failed read the tail may be cut anywhere; it is dropped.
+      if (carry_.empty() || failed_) {
+        return false;
+      }
+
+      // last line without a trailing newline.
+      std::string_view piece = carry_;
+      if (piece.back() == '\r') {
+        piece.remove_suffix(1);
+      }
+      *line = piece;
+      clear_carry_ = true;
+      ++line_number_;
+      return true;
+    }
+
+    acquire_chunk();
+  }
+}
+
+}  // namespace core
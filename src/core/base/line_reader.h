@@ -0,0 +1,86 @@
+#ifndef CORE_BASE_LINE_READER_H_
+#define CORE_BASE_LINE_READER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+// streams the lines of a file of any size with constant memory: two chunk
+// buffers (one filled by a readahead thread while the other is scanned) plus
+// a carry buffer for lines that straddle a chunk boundary. lines are split
+// exactly like `read_lines`, including crlf handling.
+class CORE_EXPORT LineReader {
+ public:
+  static constexpr std::size_t kDefaultChunkSize = 4 * 1024 * 1024;
+
+  explicit LineReader(const char* path,
+                      std::size_t chunk_size = kDefaultChunkSize);
+
+  ~LineReader();
+
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+
+  LineReader(LineReader&&) = delete;
+  LineReader& operator=(LineReader&&) = delete;
+
+  inline bool valid() const { return fd_ >= 0; }
+  // true once reading the file failed. `next` has then returned false early.
+  inline bool failed() const { return failed_; }
+
+  // stores the next line in `line` and returns true, or returns false at the
+  // end of the file or on a read error. `line` stays valid until the next
+  // call.
+  bool next(std::string_view* line);
+
+  // 1 indexed number of the line last returned by `next`.
+  inline std::size_t line_number() const { return line_number_; }
+
+ private:
+  struct Chunk {
+    std::vector<char> data;
+    std::size_t size = 0;
+    bool full = false;
+    bool last = false;
+    // the read that filled it failed; `size` is 0 then.
+    bool error = false;
+  };
+
+  void read_ahead();
+  void acquire_chunk();
+  void release_chunk();
+
+  int fd_ = -1;
+  std::size_t chunk_size_;
+
+  Chunk chunks_[2];
+  std::mutex mutex_;
+  std::condition_variable chunk_ready_;
+  std::condition_variable chunk_free_;
+  bool stop_ = false;
+  std::thread reader_;
+
+  // consumer side; only touched by the thread calling `next`.
+  Chunk* current_ = nullptr;
+  std::size_t next_slot_ = 0;
+  std::vector<std::size_t> newlines_;
+  std::size_t newline_index_ = 0;
+  std::size_t line_start_ = 0;
+  std::string carry_;
+  bool clear_carry_ = false;
+  bool eof_ = false;
+  bool failed_ = false;
+  std::size_t line_number_ = 0;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_LINE_READER_H_
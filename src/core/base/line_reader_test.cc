@@ -0,0 +1,84 @@
+#include "core/base/line_reader.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+namespace {
+
+std::vector<std::string> read_all(const std::string& path,
+                                  std::size_t chunk_size) {
+  std::vector<std::string> lines;
+  LineReader reader(path.c_str(), chunk_size);
+  std::string_view line;
+  while (reader.next(&line)) {
+    lines.emplace_back(line);
+    EXPECT_EQ(reader.line_number(), lines.size());
+  }
+  return lines;
+}
+
+}  // namespace
+
+TEST(LineReaderTest, MatchesReadLinesAcrossChunkBoundaries) {
+  std::string content;
+  for (std::size_t i = 0; i < 200; ++i) {
+    content.append(i % 23, static_cast<char>('a' + i % 26));
+    content.append(i % 3 == 0 ? "\r\n" : "\n");
+  }
+  const std::string variants[] = {content, content + "unterminated\r", ""};
+
+  for (const std::string& variant : variants) {
+    TempFile tmp("line_reader_test_", variant);
+    ASSERT_TRUE(tmp.valid());
+    const std::vector<std::string> expected = read_lines<false>(variant);
+
+    // tiny chunks force lines and crlf pairs to straddle chunk boundaries.
+    for (std::size_t chunk_size : {1, 2, 7, 64, 4096}) {
+      EXPECT_EQ(read_all(tmp.path(), chunk_size), expected)
+          << "chunk size: " << chunk_size;
+    }
+  }
+}
+
+TEST(LineReaderTest, StopsEarlyAndHandlesMissingFile) {
+  TempFile tmp("line_reader_test_", std::string(100000, 'x') + "\nlast\n");
+  {
+    LineReader reader(tmp.path().c_str(), 16);
+    std::string_view line;
+    ASSERT_TRUE(reader.next(&line));
+    EXPECT_EQ(line.size(), 100000);
+  }
+
+  LineReader missing("/nonexistent/line_reader_test");
+  std::string_view line;
+  EXPECT_FALSE(missing.valid());
+  EXPECT_FALSE(missing.next(&line));
+}
+
+#if !IS_WINDOWS
+TEST(LineReaderTest, ReportsReadErrors) {
+  // a directory opens for reading, but every read of it fails.
+  TempDir dir("line_reader_test_");
+  ASSERT_TRUE(dir.valid());
+  LineReader reader(dir.path().c_str(), 16);
+  ASSERT_TRUE(reader.valid());
+  std::string_view line;
+  EXPECT_FALSE(reader.next(&line));
+  EXPECT_TRUE(reader.failed());
+
+  TempFile tmp("line_reader_test_", "one\ntwo\n");
+  LineReader healthy(tmp.path().c_str(), 2);
+  while (healthy.next(&line)) {
+  }
+  EXPECT_FALSE(healthy.failed());
+}
+#endif
+
+}  // namespace core
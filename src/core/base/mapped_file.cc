@@ -0,0 +1,168 @@
+#include "core/base/mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "build/build_flag.h"
+#include "core/base/logger.h"
+
+#if IS_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace core {
+
+void advise_range(const void* data, std::size_t size, AccessPattern access) {
+#if IS_WINDOWS
+  // only the open flags of the file carry a hint here.
+  (void)data;
+  (void)size;
+  (void)access;
+#else
+  if (size == 0 || access == AccessPattern::kNormal) {
+    return;
+  }
+  static const uintptr_t page_size =
+      static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin =
+      reinterpret_cast<uintptr_t>(data) & ~(page_size - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(data) + size;
+  int advice = MADV_NORMAL;
+  switch (access) {
+    case AccessPattern::kNormal: return;
+    case AccessPattern::kSequential:
+    case AccessPattern::kDontNeed: advice = MADV_SEQUENTIAL; break;
+    case AccessPattern::kRandom: advice = MADV_RANDOM; break;
+    case AccessPattern::kWillNeed: advice = MADV_WILLNEED; break;
+  }
+  // only a hint; failures are harmless.
+  (void)madvise(reinterpret_cast<void*>(begin), end - begin, advice);
+#endif
+}
+
+MappedFile::MappedFile(const char* path, AccessPattern access) {
+#if IS_WINDOWS
+  DWORD flags = FILE_ATTRIBUTE_NORMAL;
+  if (access == AccessPattern::kSequential ||
+      access == AccessPattern::kDontNeed) {
+    flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+  } else if (access == AccessPattern::kRandom) {
+    flags |= FILE_FLAG_RANDOM_ACCESS;
+  }
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, flags, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  LARGE_INTEGER file_size;
+  if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &file_size) ||
+      file_size.QuadPart <= 0) {
+    CloseHandle(file);
+    return;
+  }
+
+  // the error codes are read before `CloseHandle` can overwrite them.
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const DWORD mapping_error = mapping ? 0 : GetLastError();
+  CloseHandle(file);
+  if (!mapping) {
+    glog.error_ref<"failed to map file: {} ({})\n">(path, mapping_error);
+    glog.flush();
+    return;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  const DWORD view_error = view ? 0 : GetLastError();
+  // the view keeps the mapping object alive on its own.
+  CloseHandle(mapping);
+  if (!view) {
+    glog.error_ref<"failed to map file: {} ({})\n">(path, view_error);
+    glog.flush();
+    return;
+  }
+
+  data_ = view;
+  size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+    close(fd);
+    return;
+  }
+
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int map_error = addr == MAP_FAILED ? errno : 0;
+  // the mapping holds its own reference to the file.
+  close(fd);
+  if (addr == MAP_FAILED) {
+    glog.error_ref<"failed to map file: {} ({})\n">(path,
+                                                    std::strerror(map_error));
+    glog.flush();
+    return;
+  }
+
+  data_ = addr;
+  size_ = size;
+  if (access != AccessPattern::kNormal) {
+#if defined(MADV_HUGEPAGE)
+    // fewer tlb misses across a large scan, where the file system supports
+    // huge pages for the page cache.
+    if (size >= kHugePageMappingThreshold) {
+      (void)madvise(addr, size, MADV_HUGEPAGE);
+    }
+#endif
+    advise_range(addr, size, access);
+  }
+#endif
+}
+
+MappedFile::~MappedFile() {
+  unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+void MappedFile::unmap() {
+  if (!data_) {
+    return;
+  }
+#if IS_WINDOWS
+  UnmapViewOfFile(data_);
+#else
+  munmap(data_, size_);
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace core
@@ -0,0 +1,78 @@
+#ifndef CORE_BASE_MAPPED_FILE_H_
+#define CORE_BASE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+// how a file is about to be read, passed on to the kernel as a hint
+// (`posix_fadvise` for reads, `madvise` for mappings). hints never change
+// results, only readahead and caching; unsupported ones are ignored.
+enum class AccessPattern : uint8_t {
+  // no hint.
+  kNormal = 0,
+  // front to back: larger readahead.
+  kSequential = 1,
+  // scattered lookups: no readahead.
+  kRandom = 2,
+  // all of it, soon: starts reading the whole file in the background.
+  kWillNeed = 3,
+  // front to back, once: the cached pages are dropped after a read, and a
+  // mapping lets the kernel reclaim pages behind the scan.
+  kDontNeed = 4,
+};
+
+// mappings at least this large also ask for transparent huge pages when
+// given a hint.
+constexpr std::size_t kHugePageMappingThreshold = std::size_t{32} << 20;
+
+// hints `access` for the mapped (or heap) memory [data, data + size), widened
+// to whole pages.
+CORE_EXPORT void advise_range(const void* data,
+                              std::size_t size,
+                              AccessPattern access);
+
+// read-only memory mapping of a whole regular file.
+// the mapping stays valid for the lifetime of the object and its address does
+// not change on move, so views into it can be handed out freely.
+class CORE_EXPORT MappedFile {
+ public:
+  MappedFile() = default;
+
+  // maps `path` read-only. leaves the object invalid if the path cannot be
+  // opened, is not a regular file, is empty, or cannot be mapped, so that
+  // callers can fall back to reading the file into memory. only a failed
+  // mapping of an open regular file is logged.
+  explicit MappedFile(const char* path,
+                      AccessPattern access = AccessPattern::kNormal);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  inline const char* data() const { return static_cast<const char*>(data_); }
+  inline std::size_t size() const { return size_; }
+  inline bool valid() const { return data_ != nullptr; }
+
+  inline std::string_view view() const {
+    return std::string_view(data(), size_);
+  }
+
+ private:
+  void unmap();
+
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_MAPPED_FILE_H_
@@ -0,0 +1,81 @@
+#include "core/base/parallel.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace core {
+
+ThreadPool::ThreadPool(std::size_t worker_count) {
+  workers_.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&ThreadPool::worker_loop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_ready_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool& ThreadPool::shared() {
+  // leaked, so that jobs run from static destructors still find it.
+  static ThreadPool* const pool = new ThreadPool(default_thread_count() - 1);
+  return *pool;
+}
+
+void ThreadPool::run(const std::shared_ptr<Job>& job, std::size_t helpers) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < helpers; ++i) {
+      queue_.push_back(job);
+    }
+  }
+  if (helpers == 1) {
+    work_ready_.notify_one();
+  } else {
+    work_ready_.notify_all();
+  }
+
+  work(*job);
+  for (std::size_t done = job->done.load(std::memory_order_acquire);
+       done < job->count; done = job->done.load(std::memory_order_acquire)) {
+    job->done.wait(done, std::memory_order_acquire);
+  }
+}
+
+void ThreadPool::work(Job& job) {
+  for (std::size_t i = job.next.fetch_add(1, std::memory_order_relaxed);
+       i < job.count; i = job.next.fetch_add(1, std::memory_order_relaxed)) {
+    job.call(job.fn, i);
+    if (job.done.fetch_add(1, std::memory_order_acq_rel) + 1 == job.count) {
+      job.done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::worker_loop() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    work(*job);
+  }
+}
+
+}  // namespace core
@@ -0,0 +1,127 @@
+#ifndef CORE_BASE_PARALLEL_H_
+#define CORE_BASE_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+[[nodiscard]] inline std::size_t default_thread_count() {
+  const unsigned int hardware = std::thread::hardware_concurrency();
+  return hardware == 0 ? 1 : hardware;
+}
+
+// calls `fn(i)` for every i in [0, count) on up to `thread_count` threads.
+// indices are handed out dynamically, so uneven work items balance out.
+// runs inline on the calling thread when there is nothing to parallelize.
+// the threads are started for this call and all run at once, which callers
+// whose workers wait for each other rely on; short jobs that run often are
+// better off on a `ThreadPool`.
+template <typename F>
+void parallel_for(std::size_t count, std::size_t thread_count, const F& fn) {
+  thread_count = std::min(thread_count, count);
+  if (thread_count <= 1) {
+    for (std::size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  auto worker = [&]() {
+    for (std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+         i < count; i = next.fetch_add(1, std::memory_order_relaxed)) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count - 1);
+  for (std::size_t t = 1; t < thread_count; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+// a fixed set of worker threads for `parallel_for` jobs, so callers that run
+// many short jobs do not start threads for each. jobs from several threads
+// share the workers. the calling thread works on its own job as well, so a
+// job finishes even while every worker is busy, and nested jobs cannot
+// deadlock; workers must not wait for each other, though.
+class CORE_EXPORT ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t worker_count);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  // one worker less than `default_thread_count()`, for the calling thread.
+  // created on first use and never destroyed.
+  [[nodiscard]] static ThreadPool& shared();
+
+  inline std::size_t worker_count() const { return workers_.size(); }
+
+  // like the free `parallel_for`, with the calling thread and up to
+  // `thread_count - 1` workers of the pool.
+  template <typename F>
+  void parallel_for(std::size_t count, std::size_t thread_count, const F& fn) {
+    thread_count = std::min({thread_count, count, workers_.size() + 1});
+    if (thread_count <= 1) {
+      for (std::size_t i = 0; i < count; ++i) {
+        fn(i);
+      }
+      return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->count = count;
+    job->fn = &fn;
+    job->call = [](const void* f, std::size_t i) {
+      (*static_cast<const F*>(f))(i);
+    };
+    run(job, thread_count - 1);
+  }
+
+ private:
+  // workers that pick a job up after its last index was handed out leave
+  // without touching `fn`, which may be gone by then.
+  struct Job {
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::size_t count = 0;
+    const void* fn = nullptr;
+    void (*call)(const void* fn, std::size_t i) = nullptr;
+  };
+
+  // queues `job` for `helpers` workers, works on it and waits for it.
+  void run(const std::shared_ptr<Job>& job, std::size_t helpers);
+  static void work(Job& job);
+  void worker_loop();
+
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::deque<std::shared_ptr<Job>> queue_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_PARALLEL_H_
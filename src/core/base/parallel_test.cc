@@ -0,0 +1,47 @@
+#include "core/base/parallel.h"
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace core {
+
+TEST(ThreadPoolTest, RunsEveryIndexOnce) {
+  ThreadPool pool(3);
+  EXPECT_EQ(pool.worker_count(), 3);
+  for (std::size_t count : {0, 1, 2, 1000}) {
+    std::vector<std::atomic<int>> calls(count);
+    pool.parallel_for(count, 4, [&](std::size_t i) { calls[i].fetch_add(1); });
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(calls[i].load(), 1) << "count: " << count << ", index: " << i;
+    }
+  }
+}
+
+TEST(ThreadPoolTest, NestedAndConcurrentJobsFinish) {
+  ThreadPool pool(2);
+  std::atomic<std::size_t> total{0};
+  std::vector<std::thread> callers;
+  for (int c = 0; c < 3; ++c) {
+    callers.emplace_back([&]() {
+      // the inner jobs find every worker busy with outer ones.
+      pool.parallel_for(8, 3, [&](std::size_t) {
+        pool.parallel_for(16, 3, [&](std::size_t) { total.fetch_add(1); });
+      });
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(total.load(), 3 * 8 * 16);
+}
+
+TEST(ThreadPoolTest, SharedPoolLeavesRoomForTheCaller) {
+  EXPECT_EQ(ThreadPool::shared().worker_count() + 1, default_thread_count());
+  EXPECT_EQ(&ThreadPool::shared(), &ThreadPool::shared());
+}
+
+}  // namespace core
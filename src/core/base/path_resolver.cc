@@ -0,0 +1,244 @@
+#include "core/base/path_resolver.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "build/build_flag.h"
+#include "core/base/dir_walker.h"
+#include "core/base/file_stat.h"
+#include "core/base/file_util.h"
+
+#if !IS_WINDOWS
+#include <unistd.h>
+#endif
+
+namespace core {
+
+namespace {
+
+std::string path_from_environment() {
+  const char* path_env = std::getenv("PATH");
+  return path_env ? std::string(path_env) : std::string();
+}
+
+// windows file names are case-insensitive; the index and the answers are
+// keyed by the lowercase name there.
+std::string index_key(std::string_view name) {
+  std::string key(name);
+#if IS_WINDOWS
+  std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+#endif
+  return key;
+}
+
+bool has_dir_separator(std::string_view name) {
+#if IS_WINDOWS
+  return name.find_first_of("\\/") != std::string_view::npos;
+#else
+  return name.find(DIR_SEPARATOR) != std::string_view::npos;
+#endif
+}
+
+}  // namespace
+
+PathResolver::PathResolver() : from_environment_(true) {
+  rebuild(path_from_environment());
+}
+
+PathResolver::PathResolver(std::string path_list) : from_environment_(false) {
+  rebuild(std::move(path_list));
+}
+
+std::optional<std::string> PathResolver::resolve(std::string_view name) {
+  if (name.empty() || has_dir_separator(name)) {
+    return std::nullopt;
+  }
+
+  std::string key = index_key(name);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = resolved_.find(key);
+  if (it != resolved_.end()) {
+    ++hits_;
+    return it->second;
+  }
+  ++misses_;
+
+  // (directory, candidate) pairs from the index, in search order.
+  std::vector<std::string> candidates;
+#if IS_WINDOWS
+  for (const std::string& extension : extensions_) {
+    candidates.push_back(key + extension);
+  }
+#else
+  candidates.push_back(key);
+#endif
+  std::vector<std::pair<uint32_t, uint32_t>> matches;
+  for (std::size_t c = 0; c < candidates.size(); ++c) {
+    auto entry = index_.find(candidates[c]);
+    if (entry == index_.end()) {
+      continue;
+    }
+    for (const uint32_t directory : entry->second) {
+      matches.emplace_back(directory, static_cast<uint32_t>(c));
+    }
+  }
+  std::sort(matches.begin(), matches.end());
+
+  std::optional<std::string> result;
+  for (const auto& [directory, candidate] : matches) {
+    std::string full_path =
+        join_path(directories_[directory].path, candidates[candidate]);
+    if (is_executable(full_path)) {
+      result = std::move(full_path);
+      break;
+    }
+  }
+  resolved_.emplace(std::move(key), result);
+  return result;
+}
+
+bool PathResolver::refresh() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (from_environment_) {
+    std::string path_list = path_from_environment();
+    if (path_list != path_list_) {
+      rebuild(std::move(path_list));
+      return true;
+    }
+  }
+
+  std::vector<std::string> paths;
+  paths.reserve(directories_.size());
+  for (const Directory& directory : directories_) {
+    paths.push_back(directory.path);
+  }
+  const std::vector<FileStat> stats = stat_many(paths);
+  bool changed = false;
+  for (std::size_t i = 0; i < directories_.size(); ++i) {
+    if (stats[i].mtime_ns != directories_[i].mtime_ns) {
+      list(&directories_[i]);
+      changed = true;
+    }
+  }
+  if (changed) {
+    reindex();
+  }
+  return changed;
+}
+
+PathResolverStats PathResolver::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  PathResolverStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.directories_listed = directories_listed_;
+  return stats;
+}
+
+void PathResolver::rebuild(std::string path_list) {
+  path_list_ = std::move(path_list);
+  directories_.clear();
+
+#if IS_WINDOWS
+  extensions_.clear();
+  const char* pathext = std::getenv("PATHEXT");
+  const std::string_view extensions = pathext ? pathext : ".EXE;.BAT;.CMD";
+  std::size_t ext_start = 0;
+  while (ext_start <= extensions.size()) {
+    std::size_t end = extensions.find(';', ext_start);
+    if (end == std::string_view::npos) {
+      end = extensions.size();
+    }
+    if (end > ext_start) {
+      extensions_.push_back(
+          index_key(extensions.substr(ext_start, end - ext_start)));
+    }
+    ext_start = end + 1;
+  }
+#endif
+
+  // an empty entry is the working directory; repeated entries cannot win.
+  const std::string_view list_view = path_list_;
+  std::size_t start = 0;
+  while (start <= list_view.size()) {
+    std::size_t end = list_view.find(PATH_SEPARATOR, start);
+    if (end == std::string_view::npos) {
+      end = list_view.size();
+    }
+    std::string path(list_view.substr(start, end - start));
+    if (path.empty()) {
+      path = ".";
+    }
+    const bool seen = std::any_of(
+        directories_.begin(), directories_.end(),
+        [&path](const Directory& directory) { return directory.path == path; });
+    if (!seen) {
+      directories_.push_back(Directory{std::move(path), 0, {}});
+    }
+    start = end + 1;
+  }
+
+  for (Directory& directory : directories_) {
+    list(&directory);
+  }
+  reindex();
+}
+
+void PathResolver::list(Directory* directory) {
+  ++directories_listed_;
+  // taken before listing, so that a change in between is seen by the next
+  // refresh.
+  const FileStat stat = stat_path(directory->path.c_str());
+  directory->mtime_ns = stat.mtime_ns;
+  directory->names.clear();
+  if (!stat.is_directory()) {
+    return;
+  }
+
+  WalkOptions options;
+  options.thread_count = 1;
+  options.max_depth = 0;
+  options.include_hidden = true;
+  const WalkResult entries = walk_directory(directory->path, options);
+  directory->names.reserve(entries.size());
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    // symlinks are checked when they are resolved.
+    if (entries.type(i) != EntryType::kDirectory) {
+      directory->names.emplace_back(entries.path(i));
+    }
+  }
+}
+
+void PathResolver::reindex() {
+  index_.clear();
+  resolved_.clear();
+  for (std::size_t i = 0; i < directories_.size(); ++i) {
+    for (const std::string& name : directories_[i].names) {
+      index_[index_key(name)].push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+bool PathResolver::is_executable(const std::string& path) const {
+  if (!stat_path(path.c_str()).is_regular()) {
+    return false;
+  }
+#if IS_WINDOWS
+  return true;
+#else
+  return access(path.c_str(), X_OK) == 0;
+#endif
+}
+
+}  // namespace core
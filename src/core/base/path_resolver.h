@@ -0,0 +1,90 @@
+#ifndef CORE_BASE_PATH_RESOLVER_H_
+#define CORE_BASE_PATH_RESOLVER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "core/base/core_export.h"
+
+namespace core {
+
+struct PathResolverStats {
+  // queries answered from a previous resolution.
+  std::size_t hits = 0;
+  // queries that had to check the candidates of the index.
+  std::size_t misses = 0;
+  // directories listed, on construction and on refresh.
+  std::size_t directories_listed = 0;
+};
+
+// `which` for many names: snapshots a PATH, lists each of its directories
+// once into an index of entry names, and resolves names against the index
+// instead of probing every directory. only the candidates the index knows
+// of are checked for being executable, and each answer is remembered.
+//
+// nothing is refreshed on its own; `refresh` picks up a changed PATH and
+// relists the directories whose mtime moved. safe to share between threads.
+class CORE_EXPORT PathResolver {
+ public:
+  // snapshots the PATH environment variable. `refresh` rereads it.
+  PathResolver();
+  // resolves against `path_list`, a PATH-style list of directories, which
+  // `refresh` keeps.
+  explicit PathResolver(std::string path_list);
+
+  ~PathResolver() = default;
+
+  PathResolver(const PathResolver&) = delete;
+  PathResolver& operator=(const PathResolver&) = delete;
+
+  // the full path of the first executable called `name` in search order;
+  // on windows `name` is tried with every PATHEXT extension. names with a
+  // directory separator are not looked up.
+  [[nodiscard]] std::optional<std::string> resolve(std::string_view name);
+
+  // relists the directories whose mtime changed and drops the remembered
+  // answers, or rebuilds everything if PATH changed. returns true if
+  // anything was relisted.
+  bool refresh();
+
+  [[nodiscard]] PathResolverStats stats() const;
+
+ private:
+  struct Directory {
+    std::string path;
+    int64_t mtime_ns = 0;
+    // names of the non-directory entries.
+    std::vector<std::string> names;
+  };
+
+  void rebuild(std::string path_list);
+  void list(Directory* directory);
+  void reindex();
+  bool is_executable(const std::string& path) const;
+
+  const bool from_environment_;
+  std::string path_list_;
+  // windows only: the PATHEXT extensions, lowercase.
+  std::vector<std::string> extensions_;
+
+  mutable std::mutex mutex_;
+  std::vector<Directory> directories_;
+  // entry name to the directories holding it, in search order.
+  std::unordered_map<std::string, std::vector<uint32_t>> index_;
+  // name to its resolution, including misses.
+  std::unordered_map<std::string, std::optional<std::string>> resolved_;
+
+  std::size_t hits_ = 0;
+  std::size_t misses_ = 0;
+  std::size_t directories_listed_ = 0;
+};
+
+}  // namespace core
+
+#endif  // CORE_BASE_PATH_RESOLVER_H_
@@ -0,0 +1,101 @@
+#include "core/base/path_resolver.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "build/build_flag.h"
+#include "core/base/file_util.h"
+#include "gtest/gtest.h"
+
+namespace core {
+
+#if !IS_WINDOWS
+
+namespace {
+
+void write_executable(const std::string& path) {
+  ASSERT_EQ(write_file(path.c_str(), "#!/bin/sh\n"), 0);
+  std::filesystem::permissions(path, std::filesystem::perms::owner_exec,
+                               std::filesystem::perm_options::add);
+}
+
+// moves the mtime of `dir` forward, so that a change within the clock's
+// granularity is still seen.
+void touch_directory(const std::string& dir) {
+  std::filesystem::last_write_time(
+      dir, std::filesystem::last_write_time(dir) + std::chrono::seconds(5));
+}
+
+}  // namespace
+
+TEST(PathResolverTest, ResolvesInSearchOrder) {
+  TempDir dir("path_resolver_test_");
+  ASSERT_TRUE(dir.valid());
+  const std::string first = join_path(dir.path(), "first");
+  const std::string second = join_path(dir.path(), "second");
+  ASSERT_EQ(create_directory(first.c_str()), 0);
+  ASSERT_EQ(create_directory(second.c_str()), 0);
+  write_executable(join_path(first, "tool"));
+  write_executable(join_path(second, "tool"));
+  write_executable(join_path(second, "other"));
+  // not executable, so the later directory wins.
+  ASSERT_EQ(write_file(join_path(first, "other").c_str(), "data"), 0);
+  ASSERT_EQ(create_directory(join_path(first, "subdir").c_str()), 0);
+
+  PathResolver resolver(first + PATH_SEPARATOR_STR + second +
+                        PATH_SEPARATOR_STR + join_path(dir.path(), "none"));
+  EXPECT_EQ(resolver.resolve("tool"), join_path(first, "tool"));
+  EXPECT_EQ(resolver.resolve("other"), join_path(second, "other"));
+  EXPECT_EQ(resolver.resolve("subdir"), std::nullopt);
+  EXPECT_EQ(resolver.resolve("missing"), std::nullopt);
+  EXPECT_EQ(resolver.resolve("first/tool"), std::nullopt);
+
+  EXPECT_EQ(resolver.resolve("tool"), join_path(first, "tool"));
+  EXPECT_EQ(resolver.resolve("missing"), std::nullopt);
+  EXPECT_EQ(resolver.stats().misses, 4u);
+  EXPECT_EQ(resolver.stats().hits, 2u);
+  EXPECT_EQ(resolver.stats().directories_listed, 3u);
+
+  EXPECT_EQ(remove_file(join_path(first, "tool").c_str()), 0);
+  EXPECT_EQ(remove_file(join_path(first, "other").c_str()), 0);
+  EXPECT_EQ(remove_directory(join_path(first, "subdir").c_str()), 0);
+  EXPECT_EQ(remove_file(join_path(second, "tool").c_str()), 0);
+  EXPECT_EQ(remove_file(join_path(second, "other").c_str()), 0);
+  EXPECT_EQ(remove_directory(first.c_str()), 0);
+  EXPECT_EQ(remove_directory(second.c_str()), 0);
+}
+
+TEST(PathResolverTest, RefreshRelistsChangedDirectories) {
+  TempDir dir("path_resolver_test_");
+  ASSERT_TRUE(dir.valid());
+  const std::string first = join_path(dir.path(), "first");
+  const std::string second = join_path(dir.path(), "second");
+  ASSERT_EQ(create_directory(first.c_str()), 0);
+  ASSERT_EQ(create_directory(second.c_str()), 0);
+
+  PathResolver resolver(first + PATH_SEPARATOR_STR + second);
+  EXPECT_EQ(resolver.resolve("late"), std::nullopt);
+  EXPECT_FALSE(resolver.refresh());
+  EXPECT_EQ(resolver.stats().directories_listed, 2u);
+
+  // remembered until refreshed.
+  write_executable(join_path(second, "late"));
+  touch_directory(second);
+  EXPECT_EQ(resolver.resolve("late"), std::nullopt);
+  EXPECT_TRUE(resolver.refresh());
+  EXPECT_EQ(resolver.stats().directories_listed, 3u);
+  EXPECT_EQ(resolver.resolve("late"), join_path(second, "late"));
+
+  EXPECT_EQ(remove_file(join_path(second, "late").c_str()), 0);
+  touch_directory(second);
+  EXPECT_TRUE(resolver.refresh());
+  EXPECT_EQ(resolver.resolve("late"), std::nullopt);
+
+  EXPECT_EQ(remove_directory(first.c_str()), 0);
+  EXPECT_EQ(remove_directory(second.c_str()), 0);
+}
+
+#endif  // !IS_WINDOWS
+
+}  // namespace core